@@ -2,16 +2,26 @@
 #define _FILESYNCENGINE_H
 
 #include "driver/interface/SecurityInterface.h"
+#include "driver/interface/CompressionInterface.h"
 #include "driver/interface/NetworkInterface.h"
 #include "driver/interface/FileSyncEngine/FileSenderInterface.h"
 #include "driver/interface/FileSyncEngine/FileReceiverInterface.h"
 #include "driver/interface/FileSyncEngine/FileParserInterface.h"
-#include <queue>
-#include <condition_variable>
+#include "driver/interface/FileSyncEngine/FileSyncEngineInterface.h"
+#include "driver/impl/FileSyncEngine/FileAssembler.h"
+#include "driver/impl/FileSyncEngine/TransferJournal.h"
+#include "driver/impl/FileSyncEngine/DirectoryWork.h"
+#include "driver/impl/FileSyncEngine/TransferScheduler.h"
+#include "driver/impl/FileSyncEngine/RateLimiter.h"
 #include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
 #include <utility>
 
 static const uint8_t sender_num = 4;
+// 小文件优先发送，避免排在大文件之后长时间等待
+static const TransferScheduler::Policy scheduler_policy = TransferScheduler::Policy::SmallestFirst;
 
 class FileSyncEngine
 {
@@ -20,20 +30,43 @@ public:
     void start(std::string address, std::string recv_port, std::shared_ptr<SecurityInterface> instance);
     void stop();
     void onHaveFileToSend(uint32_t id, std::string path);
-    std::optional<std::pair<uint32_t, std::string>> getPendingFile();
+    // 接收端临时目录中有可复用的块时请求分块清单
+    void onHaveFileChunksToSend(uint32_t id, std::string path);
+    void onHaveFileRangesToSend(uint32_t id, std::string path, uint64_t total_size, std::string ranges);
+    void onHaveFileDeltaToSend(uint32_t id, std::string path, uint64_t basis_size, uint32_t block_size, std::string blocks);
+    void onSetGlobalRateLimit(uint64_t bytes_per_second);
+    void onSetTransferRateLimit(uint32_t id, uint64_t bytes_per_second);
     void haveFileConnection(UnifiedSocket socket);
     void haveFileMsg(UnifiedSocket socket, std::unique_ptr<NetworkInterface::UserMsg> msg);
+    bool haveFileBinary(UnifiedSocket socket, uint32_t payload_length);
     ~FileSyncEngine();
 
 private:
     std::vector<std::shared_ptr<FileSenderInterface>> file_senders;
     std::unique_ptr<FileReceiverInterface> file_receiver;
     std::unordered_map<UnifiedSocket, std::unique_ptr<FileParserInterface>> file_parser_map;
-    std::shared_ptr<std::condition_variable> cv;
-    std::mutex mtx;
+    std::mutex parser_mutex; // 保护file_parser_map
+    std::shared_ptr<FileAssembler> file_assembler;
+    std::shared_ptr<CompressionInterface> compression;
+    // 在构造时创建，未启动时提交的任务留在队列中，启动后再发送
+    std::unique_ptr<TransferScheduler> scheduler;
+    // 限速设置在重新连接后保留
+    std::shared_ptr<RateLimiter> rate_limiter;
+    // 后台为临时目录建立块索引，启动时与每次下载完成后各扫描一次，接收线程只加载已有索引
+    std::thread index_thread;
+    std::mutex index_mutex;
+    std::condition_variable index_cv;
+    bool is_index_pending{false};
+    std::atomic<bool> is_index_stopped{false};
 
 private:
-    std::queue<std::pair<uint32_t, std::string>> pending_send_files;
+    FileParserInterface *findParser(UnifiedSocket socket);
+    void indexLoop();
+    void onDownloadProgress(uint32_t id, uint8_t progress, uint32_t speed, bool is_end);
+    void enqueueDirectory(uint32_t id, const std::string &path);
+    // with_root表示发送整个文件，同时在后台计算Merkle根，由最后完成的条带发出
+    void enqueueStripes(uint32_t id, const std::string &path, uint64_t file_size,
+                        const std::vector<TransferJournal::Range> &ranges, bool with_root = false);
     bool is_start{false};
 };
 
@@ -57,6 +57,10 @@ private:
     void syncAddFiles(std::unique_ptr<Json::Parser> parser);
     void syncDeleteFiles(std::unique_ptr<Json::Parser> parser);
     void downloadFile(std::unique_ptr<Json::Parser> parser);
+    void resumeFile(std::unique_ptr<Json::Parser> parser);
+    void deltaFile(std::unique_ptr<Json::Parser> parser);
+    void manifestSatisfied(std::unique_ptr<Json::Parser> parser);
+    void dedupFile(std::unique_ptr<Json::Parser> parser);
     void publishResponse(std::string &&event_name, JsonMessageType::ResultType type);
     void publishResponse(std::string &&event_name, JsonMessageType::ResultType type, std::string arg0);
 
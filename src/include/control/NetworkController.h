@@ -5,12 +5,17 @@
 #include "driver/interface/JsonFactoryInterface.h"
 #include "driver/interface/SecurityInterface.h"
 #include "MsgParser/Parser.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
 
 class NetworkController
 {
 public:
     void initSubscribe();
     NetworkController();
+    ~NetworkController();
 
 private:
     void onSendConnectRequest(std::string sender_device_name, std::string sender_device_ip, std::string target_device_ip);
@@ -25,6 +30,12 @@ private:
     void onSendSyncAddFiles(std::vector<std::string> files, uint8_t stride);
     void onSendSyncDeleteFile(uint32_t id);
     void onSendGetFile(uint32_t id);
+    // 接收端用已有的块拼出了整个文件，通知发送端上传完成
+    void onSendManifestSatisfied(uint32_t id);
+    // 后台为下载请求计算旧版本的块签名，计算完成后发送增量请求，失败时请求整个文件
+    void signatureLoop();
+    // 请求整个文件，临时目录中有可复用的块时改为请求分块清单
+    void sendDownloadFile(uint32_t id);
 
 private:
     std::unique_ptr<NetworkInterface> control_msg_network_driver;
@@ -32,6 +43,12 @@ private:
     std::shared_ptr<SecurityInterface> security_driver;
     std::unique_ptr<Parser> json_parser;
     std::unique_ptr<Parser> binary_parser;
+
+    std::thread signature_thread;
+    std::mutex signature_mutex;
+    std::condition_variable signature_cv;
+    std::deque<uint32_t> signature_queue;
+    bool is_signature_stopped{false};
 };
 
 #endif
\ No newline at end of file
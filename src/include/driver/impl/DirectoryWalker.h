@@ -0,0 +1,43 @@
+#ifndef DIRECTORYWALKER_H
+#define DIRECTORYWALKER_H
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+// 一次遍历得到的目录清单，文件夹大小、叶子目录与文件列表都从这里取
+struct DirectoryManifest
+{
+    struct FileEntry
+    {
+        std::string path; // 与根路径拼接得到的完整路径
+        uint64_t size;
+    };
+    std::vector<FileEntry> files;
+    std::vector<std::string> leaf_folders; // 相对根路径，根目录没有子目录时为"."
+    uint64_t total_size{0};
+    std::chrono::steady_clock::time_point scan_time;
+};
+
+// 多线程单次遍历目录树，Linux下使用getdents64与statx
+class DirectoryWalker
+{
+public:
+    // 清单在该时间内可以被其他调用者复用（如界面添加文件夹后紧接着发送）
+    inline static const std::chrono::seconds manifest_max_age{60};
+
+    // 返回缓存中未过期的清单，否则重新遍历并缓存
+    static std::shared_ptr<const DirectoryManifest> scan(const std::string &root_path);
+    // 不使用缓存，直接遍历
+    static std::shared_ptr<DirectoryManifest> walk(const std::string &root_path);
+
+private:
+    static std::mutex cache_mutex;
+    static std::map<std::string, std::shared_ptr<const DirectoryManifest>> manifest_cache;
+};
+
+#endif
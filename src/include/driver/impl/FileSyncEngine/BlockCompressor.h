@@ -0,0 +1,39 @@
+#ifndef BLOCKCOMPRESSOR_H
+#define BLOCKCOMPRESSOR_H
+
+#include "driver/interface/CompressionInterface.h"
+#include <memory>
+#include <vector>
+#include <stdint.h>
+
+// 发送端在文件块交给OuterMsgBuilder之前的压缩阶段，压缩后的帧带IS_COMPRESS标志
+// 先抽样估计熵，熵高的块（已压缩的媒体、压缩包）直接原样发送；试压缩缩小不明显时也原样发送，
+// 并在之后的若干块内不再尝试，连续失败时跳过的块数加倍
+class BlockCompressor
+{
+public:
+    inline static const size_t min_size = 4 * 1024;                 // 更小的帧不压缩
+    inline static const size_t entropy_sample_size = 4096;          // 熵估计的抽样字节数
+    inline static const double max_entropy = 7.5;                   // 每字节比特数超过该值视为不可压缩
+    inline static const size_t max_ratio_percent = 90;              // 压缩后不超过原大小的该比例才发送压缩结果
+    inline static const uint32_t max_skip_blocks = 64;
+    inline static const size_t max_frame_size = 64 * 1024 * 1024;   // 接收端解压后的帧长上限
+
+    explicit BlockCompressor(std::shared_ptr<CompressionInterface> compression);
+    // 每个文件开始时调用，上一个文件的判断不再适用
+    void reset();
+    // 返回true时out为压缩后的载荷，否则按原样发送block
+    bool compress(const std::vector<uint8_t> &block, std::vector<uint8_t> &out);
+    // 等距抽样估计每字节的香农熵
+    static double estimateEntropy(const uint8_t *data, size_t size);
+
+private:
+    void onIncompressible();
+
+private:
+    std::shared_ptr<CompressionInterface> compression;
+    uint32_t skip_blocks{0}; // 之后直接原样发送的块数
+    uint32_t skip_span{1};   // 下次判定不可压缩时跳过的块数
+};
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef BLOCKREADER_H
+#define BLOCKREADER_H
+
+#include "driver/interface/FileStreamHelper.h"
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+
+// 预读阶段：后台线程按顺序读取文件块，让磁盘读取与加密、发送重叠
+class BlockReader
+{
+public:
+    explicit BlockReader(size_t depth);
+    ~BlockReader();
+    // 开始按block_size读取文件的[offset, offset + length)，之前未取完的块被丢弃
+    // drop_behind为true时读过的部分随即从页缓存中丢弃
+    bool open(const std::wstring &wpath, uint64_t offset, uint64_t length, uint32_t block_size, bool drop_behind = false);
+    // 取下一个块，缓冲区前block_header_size字节留给块前缀；读完或读取失败返回nullptr
+    std::unique_ptr<std::vector<uint8_t>> next();
+    void close();
+
+private:
+    void readLoop();
+
+private:
+    size_t depth;
+    size_t block_depth{1}; // 当前块大小下实际预读的块数
+    uint32_t block_size{0};
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::deque<std::unique_ptr<std::vector<uint8_t>>> ready_blocks;
+    std::unique_ptr<FileStreamHelper::PositionalReader> reader;
+    std::unique_ptr<FileStreamHelper::MappedReader> mapped_reader; // 大文件优先使用映射，失败时回退到reader
+    uint64_t read_offset{0};
+    uint64_t read_end{0};
+    // 大文件在读取位置之后丢弃页缓存，drop_offset之前已丢弃；使用映射时滞后一个映射窗口，映射中的页无法丢弃
+    bool is_drop_behind{false};
+    uint64_t drop_offset{0};
+    uint64_t drop_lag{0};
+    uint64_t generation{0}; // 每次open/close递增，丢弃旧文件的在途读取
+    bool in_flight{false};
+    bool running{true};
+    std::thread read_thread;
+};
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef BLOCKSIZETUNER_H
+#define BLOCKSIZETUNER_H
+
+#include "driver/interface/FileSyncEngine/FileSyncEngineInterface.h"
+#include <chrono>
+#include <stdint.h>
+
+// 根据发送连接的实测吞吐与RTT选择块大小：快速链路增大块以摊薄每帧的Header/IV/SHA256开销，慢速或丢包时减小
+class BlockSizeTuner
+{
+public:
+    // 每帧期望占用的链路时间，块大小约为吞吐 * target_frame_time
+    inline static const std::chrono::microseconds target_frame_time{50000};
+
+    // 记录一段时间内发出的字节数
+    void onSent(uint64_t bytes, std::chrono::microseconds elapsed);
+    // 记录TCP层的RTT与累计重传数
+    void onTcpInfo(uint32_t rtt_us, uint32_t total_retrans);
+    uint32_t blockSize() const { return block_size; }
+
+private:
+    void update();
+
+private:
+    uint32_t block_size{FileSyncEngineInterface::file_block_size};
+    double throughput_bps{0}; // 吞吐的指数滑动平均
+    uint32_t min_rtt_us{0};
+    uint32_t rtt_us{0};
+    uint32_t last_retrans{0};
+    bool is_lossy{false};
+};
+
+#endif
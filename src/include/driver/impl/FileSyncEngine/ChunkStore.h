@@ -0,0 +1,53 @@
+#ifndef CHUNKSTORE_H
+#define CHUNKSTORE_H
+
+#include "driver/impl/FileSyncEngine/ContentChunker.h"
+#include "driver/interface/FileStreamHelper.h"
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// 接收端临时目录的块索引，每个文件的分块结果缓存在旁路文件中，文件大小或修改时间变化后重新分块
+class ChunkStore
+{
+public:
+    inline static const std::wstring index_suffix = L".xftchunks";
+
+    explicit ChunkStore(std::wstring dir);
+    // 加载目录中已有的块索引，exclude_path不参与索引；索引缺失或过期的文件跳过，不在调用线程上分块
+    void refresh(const std::wstring &exclude_path);
+    // 为目录中不小于dedup_min_size且索引缺失或过期的文件分块并保存索引，耗时与文件大小成正比，
+    // 由后台线程调用，stop置位后在两个文件之间返回
+    static void buildIndexes(const std::wstring &dir, const std::atomic<bool> &stop);
+    // 目录中至少有一个文件的索引有效时返回true，找到第一个即返回，只读取索引头
+    static bool hasIndexedFiles(const std::wstring &dir);
+    // 从已有文件中读出哈希为hash的块，内容与哈希不符时返回false
+    bool read(const ContentChunker::Chunk &chunk, std::vector<uint8_t> &data);
+    // 删除文件的旁路索引
+    static void removeIndex(const std::wstring &path);
+
+private:
+    struct Location
+    {
+        std::wstring path;
+        uint64_t offset;
+        uint32_t length;
+    };
+    // 依次回调目录中可作为块来源的文件（已接收完整且不小于dedup_min_size）
+    static void forEachFile(const std::wstring &dir, const std::wstring &exclude_path,
+                            const std::function<bool(const std::wstring &path, uint64_t size, int64_t mtime)> &callback);
+    // chunks为空时只检查索引是否与文件一致
+    static bool loadIndex(const std::wstring &path, uint64_t size, int64_t mtime, std::vector<ContentChunker::Chunk> *chunks);
+    static void saveIndex(const std::wstring &path, uint64_t size, int64_t mtime, const std::vector<ContentChunker::Chunk> &chunks);
+
+private:
+    std::wstring dir;
+    std::unordered_map<std::string, Location> locations; // 哈希 -> 所在文件与区间
+    std::map<std::wstring, std::unique_ptr<FileStreamHelper::PositionalReader>> readers;
+};
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef CONTENTCHUNKER_H
+#define CONTENTCHUNKER_H
+
+#include "driver/interface/FileStreamHelper.h"
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include <stdint.h>
+
+// 内容定义分块（FastCDC），块边界只由内容决定，文件中间插入或删除数据时其余块保持不变
+// 发送端按块宣告哈希，接收端用临时目录中已有的相同块拼出文件
+class ContentChunker
+{
+public:
+    struct Chunk
+    {
+        uint64_t offset;
+        uint32_t length;
+        std::string hash; // SHA256十六进制
+    };
+
+    // 按顺序读取文件并逐批分块，发送端分出一批即可发出一批，不必等整个文件分完
+    class Stream
+    {
+    public:
+        // 每段读入的数据(offset, data, size)依次交给on_read，读取一遍即可同时计算其他摘要
+        using ReadCallback = std::function<void(uint64_t offset, const uint8_t *data, size_t size)>;
+
+        // 打开时查找空洞，不短于sparse_min_hole的空洞跳过不分块
+        bool open(const std::wstring &path, ReadCallback on_read = nullptr);
+        // 向chunks追加至多max_count个块，分完后isFinished为true
+        void next(std::vector<Chunk> &chunks, size_t max_count);
+        bool isFinished() const { return is_finished; }
+        uint64_t fileSize() const { return file_size; }
+        const std::vector<std::pair<uint64_t, uint64_t>> &holes() const { return file_holes; }
+
+    private:
+        // 开始空洞之间的下一段数据，块边界从段首重新开始
+        void beginSegment(uint64_t begin);
+
+    private:
+        std::unique_ptr<FileStreamHelper::PositionalReader> reader;
+        ReadCallback on_read;
+        uint64_t file_size{0};
+        std::vector<std::pair<uint64_t, uint64_t>> file_holes;
+        size_t segment_index{0}; // 当前段之后的空洞
+        uint64_t segment_end{0};
+        // 缓冲区至少容纳一个最大块，剩余不足一个最大块时把尾部挪到开头再读
+        std::vector<uint8_t> buffer;
+        uint64_t buffer_offset{0}; // 缓冲区开头在文件中的偏移
+        size_t buffer_size{0};
+        size_t position{0};
+        bool is_eof{false};
+        bool is_finished{false};
+    };
+
+    // 对整个文件分块并计算每块哈希；不短于sparse_min_hole的空洞跳过不分块，holes不为空时返回这些空洞(offset, length)
+    static bool chunkFile(const std::wstring &path, std::vector<Chunk> &chunks,
+                          std::vector<std::pair<uint64_t, uint64_t>> *holes = nullptr);
+    // 返回data开头第一个块的长度，size不足最小块时整体作为一块
+    static size_t findCut(const uint8_t *data, size_t size);
+    static std::string hashChunk(const uint8_t *data, size_t size);
+
+    // 序列化格式 "offset length hash"
+    static std::string chunkToString(const Chunk &chunk);
+    static bool chunkFromString(const std::string &str, Chunk &chunk);
+};
+
+#endif
@@ -0,0 +1,135 @@
+#ifndef DELTASYNC_H
+#define DELTASYNC_H
+
+#include "driver/interface/FileStreamHelper.h"
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <stdint.h>
+
+typedef struct evp_md_ctx_st EVP_MD_CTX;
+
+// rsync式增量传输：接收端为已有的旧版本计算定长块签名（弱滚动校验和 + 强哈希）
+// 发送端在新版本上滑动窗口查找相同的块，只发送块拷贝指令与字面数据，接收端据此从旧版本重建新版本
+
+// 弱校验和 a = Σx，b = Σ(len - i) * x，窗口后移一个字节时O(1)更新
+class RollingChecksum
+{
+public:
+    void init(const uint8_t *data, size_t size);
+    void roll(uint8_t out, uint8_t in);
+    uint32_t value() const { return (a & 0xFFFF) | (b << 16); }
+
+private:
+    uint32_t a{0};
+    uint32_t b{0};
+    uint32_t length{0};
+};
+
+class DeltaSignature
+{
+public:
+    // 块大小取2的幂，使签名块数不超过max_blocks
+    inline static const uint32_t min_block_size = 4 * 1024;
+    inline static const uint32_t max_block_size = 1024 * 1024;
+    inline static const uint64_t max_blocks = 16384;
+    // 超过该大小的旧版本块数超出max_blocks，不计算签名，直接下载整个文件
+    inline static const uint64_t max_basis_size = max_blocks * max_block_size;
+
+    struct Block
+    {
+        uint32_t weak;
+        uint64_t strong; // SHA256前8字节，整个文件另有SHA256校验
+    };
+
+    static uint32_t blockSizeFor(uint64_t file_size);
+    static uint64_t strongChecksum(const uint8_t *data, size_t size);
+
+    // 只为完整的块计算签名，末尾不足一块的部分不参与匹配，文件超过max_basis_size时返回false
+    bool compute(const std::wstring &path);
+    // 每块序列化为24位十六进制（弱校验和8位 + 强哈希16位），依次拼接
+    std::string blocksToString() const;
+    bool blocksFromString(const std::string &str);
+
+    uint64_t basis_size{0};
+    uint32_t block_size{0};
+    std::vector<Block> blocks;
+};
+
+// 指令流格式（块索引为delta_block_index的文件块载荷，多条指令依次拼接）
+// 拷贝: uint8_t op = 0; uint32_t block_index; uint32_t block_count;
+// 字面: uint8_t op = 1; uint32_t length; uint8_t data[length];
+class DeltaEncoder
+{
+public:
+    enum Op : uint8_t
+    {
+        Copy = 0,
+        Literal = 1
+    };
+
+    DeltaEncoder(std::shared_ptr<const DeltaSignature> signature, const std::wstring &path);
+    ~DeltaEncoder();
+    bool isOpen() const { return reader.isOpen(); }
+    uint64_t fileSize() const { return file_size; }
+    // 已处理的新文件字节数
+    uint64_t consumedSize() const { return buffer_offset + position; }
+    // 生成下一批指令追加到out，至少凑满max_size字节或到达文件末尾，没有更多指令时返回false
+    bool next(std::vector<uint8_t> &out, size_t max_size);
+    // 新文件整体的SHA256十六进制，next返回false后有效
+    std::string fileHash() const { return file_hash; }
+
+private:
+    void fill(std::vector<uint8_t> &out);
+    int64_t findBlock(uint32_t weak, const uint8_t *data) const;
+    void flushLiteral(std::vector<uint8_t> &out);
+    void flushCopy(std::vector<uint8_t> &out);
+
+private:
+    std::shared_ptr<const DeltaSignature> signature;
+    std::unordered_map<uint32_t, std::vector<uint32_t>> block_table; // 弱校验和 -> 块索引
+    std::vector<uint8_t> weak_filter;                                // 弱校验和低16位的快速过滤表
+    FileStreamHelper::PositionalReader reader;
+    uint64_t file_size{0};
+    std::vector<uint8_t> buffer;
+    uint64_t buffer_offset{0}; // 缓冲区开头在文件中的偏移
+    size_t buffer_size{0};
+    size_t position{0};      // 当前窗口起点
+    size_t literal_begin{0}; // 尚未发出的字面数据起点
+    bool is_eof{false};
+    bool is_finished{false};
+    RollingChecksum rolling;
+    bool rolling_valid{false};
+    uint32_t copy_begin{0};
+    uint32_t copy_count{0};
+    EVP_MD_CTX *hash_ctx{nullptr};
+    std::string file_hash;
+};
+
+class DeltaDecoder
+{
+public:
+    DeltaDecoder(const std::wstring &basis_path, const std::wstring &output_path, uint32_t block_size);
+    ~DeltaDecoder();
+    bool isOpen() const { return !is_failed; }
+    uint64_t outputSize() const { return output_size; }
+    // 按顺序执行一批指令，出错后忽略后续指令
+    bool apply(const uint8_t *data, size_t size);
+    // 重建的文件与发送端哈希一致时返回true
+    bool finish(const std::string &expected_hash);
+
+private:
+    bool write(const uint8_t *data, size_t size);
+
+private:
+    FileStreamHelper::PositionalReader basis;
+    FileStreamHelper::PositionalWriter output;
+    uint32_t block_size;
+    uint64_t output_size{0};
+    bool is_failed{false};
+    std::vector<uint8_t> copy_buffer;
+    EVP_MD_CTX *hash_ctx{nullptr};
+};
+
+#endif
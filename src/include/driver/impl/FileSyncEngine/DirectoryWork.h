@@ -0,0 +1,42 @@
+#ifndef DIRECTORYWORK_H
+#define DIRECTORYWORK_H
+
+#include "driver/impl/DirectoryWalker.h"
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+// 一次文件夹发送的共享工作队列，文件夹拆成part_count个部分由多个发送连接并行发送
+// 每个部分按需领取目录项与叶子目录，先空闲的连接多领，大文件不会压在同一个连接上
+class DirectoryWork
+{
+public:
+    DirectoryWork(std::string root_path, uint32_t part_count);
+
+    uint32_t partCount() const { return part_count; }
+    uint64_t totalSize();
+    uint32_t totalPaths();
+    // 领取下一个目录项，max_size不为0时只领取不超过max_size的目录项，没有可领取的返回false
+    bool takeItem(DirectoryManifest::FileEntry &entry, uint64_t max_size = 0);
+    // 领取一批叶子目录，至少领取一个，不超过max_items个且总长度不超过max_bytes
+    bool takePaths(std::vector<std::string> &paths, size_t max_items, size_t max_bytes);
+    bool hasItems();
+    bool hasPaths();
+
+private:
+    // 第一次使用时遍历，多个连接只遍历一次
+    void load();
+
+private:
+    std::mutex mtx;
+    std::string root_path;
+    uint32_t part_count;
+    std::shared_ptr<const DirectoryManifest> manifest;
+    std::vector<DirectoryManifest::FileEntry> items; // 小文件在前，便于连续打包
+    size_t next_item{0};
+    size_t next_path{0};
+};
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef DISKWRITER_H
+#define DISKWRITER_H
+
+#include "driver/interface/FileStreamHelper.h"
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+
+// 接收端的异步写盘：接收线程把解密后的块放入队列即返回，由写线程落盘，磁盘慢时不拖住recv
+// 写线程每次取走队列中的全部请求，按文件与偏移排序后把首尾相接的块合并为一次pwritev
+// 队列按字节数限定容量，写满时submit阻塞，接收端随之停止处理帧和授予信用，发送端在途数据受限
+class DiskWriter
+{
+public:
+    inline static const size_t queue_capacity = 64 * 1024 * 1024;
+    // 单次合并写入的上限
+    inline static const size_t max_write_size = 16 * 1024 * 1024;
+    inline static const size_t max_write_segments = 1024; // 不超过IOV_MAX
+
+    struct Request
+    {
+        std::shared_ptr<FileStreamHelper::PositionalWriter> writer;
+        uint64_t offset{0};
+        const uint8_t *data{nullptr};
+        size_t size{0};
+        std::vector<uint8_t> buffer;     // data所指的内存，随请求一起移动，避免拷贝
+        std::function<void(bool)> done; // 在写线程中调用，参数表示是否写入成功
+    };
+
+    DiskWriter();
+    ~DiskWriter();
+    DiskWriter(const DiskWriter &) = delete;
+    DiskWriter &operator=(const DiskWriter &) = delete;
+
+    // 队列已满时阻塞，停止后直接以失败完成
+    void submit(Request request);
+    // 等待已提交的请求全部写完
+    void flush();
+    // 写完剩余请求后结束写线程
+    void stop();
+    // 当前线程是否为写线程（即正在执行完成回调）
+    bool isWriterThread() const { return std::this_thread::get_id() == thread.get_id(); }
+
+private:
+    void run();
+    bool writeRun(std::vector<Request> &batch, size_t begin, size_t end);
+
+private:
+    std::mutex queue_mutex;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+    std::condition_variable drained;
+    std::vector<Request> queue;
+    size_t queued_size{0}; // 已提交但尚未写完的字节数，包括写线程手中的批次
+    bool is_writing{false};
+    bool is_stopped{false};
+    std::thread thread;
+};
+
+#endif
@@ -0,0 +1,109 @@
+#ifndef FILEASSEMBLER_H
+#define FILEASSEMBLER_H
+
+#include "driver/interface/FileStreamHelper.h"
+#include "driver/impl/FileSyncEngine/TransferJournal.h"
+#include "driver/impl/FileSyncEngine/MerkleTree.h"
+#include "driver/impl/FileSyncEngine/DiskWriter.h"
+#include "driver/impl/FileSyncEngine/WriteBehind.h"
+#include <condition_variable>
+#include <map>
+#include <set>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <chrono>
+#include <functional>
+#include <stdint.h>
+
+// 按偏移重组从多个连接收到的同一文件的数据，所有FileParser共享
+class FileAssembler
+{
+public:
+    // 每写入该字节数保存一次续传日志
+    inline static const uint64_t checkpoint_interval = 8ULL * 1024 * 1024;
+
+    ~FileAssembler();
+    // 存在匹配的续传日志时保留已接收的内容；expects_root表示发送端会在结束时给出Merkle根，
+    // 续传日志中记录了根时同样校验；为尚未接收的区间预分配磁盘空间（稀疏文件的空洞已记为接收），空间不足时拒绝接收
+    bool open(uint32_t id, const std::wstring &path, uint64_t total_size, bool expects_root = false);
+    // 交给写线程异步写入，buffer为data所在的内存，随请求移走避免拷贝
+    void write(uint32_t id, uint64_t offset, const uint8_t *data, size_t size, std::vector<uint8_t> &&buffer);
+    // 由fill在当前线程把size字节写入文件的offset处（如直接从socket搬运），文件不存在时以nullptr调用，fill需自行丢弃数据
+    // data为写入的内容，不在内存中时为nullptr
+    bool receive(uint32_t id, uint64_t offset, size_t size,
+                 const std::function<bool(FileStreamHelper::PositionalWriter *)> &fill, const uint8_t *data = nullptr);
+    // 发送端声明结束（如空文件）时完成，带Merkle根时先校验，merkle_spans用于定位校验失败的段，重复调用无副作用
+    // 先等待该文件已提交的异步写入完成
+    void finish(uint32_t id, const std::string &merkle_root = "", const std::string &merkle_spans = "");
+    // 条带文件的根由最后发完条带的连接单独给出，可能早于其他连接上的数据收满；已收满时直接完成
+    // 根为空表示发送端无法计算，收满后不校验
+    void setMerkleRoot(uint32_t id, const std::string &merkle_root, const std::string &merkle_spans);
+    // 连接断开时保存所有未完成文件的续传日志并关闭
+    void close();
+
+    // 文件夹的各部分可能从多个连接同时到达，各连接共享进度，所有部分结束后文件夹完成
+    // 磁盘空间不足时拒绝接收并返回false
+    bool openFolder(uint32_t id, const std::wstring &dir_path, uint64_t total_size, uint32_t part_count);
+    // path所在磁盘的可用空间不少于required_size时返回true，否则记为拒绝并通知界面下载失败
+    // 同一文件的各连接都会检查，只通知一次
+    bool checkSpace(uint32_t id, const std::wstring &path, uint64_t required_size);
+    void addFolderReceived(uint32_t id, uint64_t size);
+    void finishFolderPart(uint32_t id);
+
+private:
+    struct ReceivingFile
+    {
+        std::mutex mtx;
+        std::condition_variable writes_done;
+        std::shared_ptr<FileStreamHelper::PositionalWriter> file_writer; // 队列中的写请求也持有
+        uint32_t pending_writes{0};                                      // 已提交尚未写完的请求数
+        std::unique_ptr<TransferJournal> journal;
+        std::wstring path;
+        std::unique_ptr<MerkleVerifier> verifier; // 不校验时为空
+        std::unique_ptr<WriteBehind> write_behind; // 小于drop_behind_min_size的文件为空
+        std::string merkle_root;
+        std::string merkle_spans;
+        bool is_root_known{false}; // 根已随续传日志或file_root给出
+        bool is_received{false};
+        bool is_finished{false}; // 之后落盘的重复块不再记入日志
+        uint64_t checkpoint_size{0};
+        uint64_t total_size{0};
+        uint64_t received_size{0};
+        uint64_t reported_size{0};
+        uint8_t progress_count{0};
+        std::chrono::steady_clock::time_point report_time;
+    };
+    std::shared_ptr<ReceivingFile> find(uint32_t id);
+    // 已拒绝的文件后续到达的块不再逐块报错
+    void logMissing(uint32_t id);
+    // 数据落盘后记入日志并更新进度，收满时完成文件；is_async表示来自写线程，需同时减少pending_writes
+    void onWritten(uint32_t id, ReceivingFile &file, uint64_t offset, size_t size, bool is_async);
+    // 收满后等到Merkle根已知再完成
+    void onReceived(uint32_t id);
+    // 校验失败时把不一致的段记为缺失，通过续传只重新请求这些段一次，再次失败则删除临时文件并通知下载失败
+    bool verify(uint32_t id, ReceivingFile &file);
+
+    struct ReceivingFolder
+    {
+        uint64_t total_size{0};
+        uint64_t received_size{0};
+        uint64_t reported_size{0};
+        uint32_t remaining_parts{0};
+        uint8_t progress_count{0};
+        std::chrono::steady_clock::time_point report_time;
+    };
+
+private:
+    std::mutex open_mutex;  // 串行化open与openFolder，并发的空间检查不会把其他连接刚预分配的空间算作不足
+    std::mutex files_mutex; // 保护receiving_files
+    std::map<uint32_t, std::shared_ptr<ReceivingFile>> receiving_files;
+    std::mutex folders_mutex; // 保护receiving_folders
+    std::map<uint32_t, ReceivingFolder> receiving_folders;
+    std::set<uint32_t> verify_failed_ids; // 已因校验失败重新请求过的文件，受files_mutex保护
+    std::set<uint32_t> rejected_ids;      // 因空间不足拒绝接收的文件，其后到达的块直接丢弃，受files_mutex保护
+    // 声明在最后因而最先析构，写线程结束后其他成员才销毁
+    DiskWriter disk_writer;
+};
+
+#endif
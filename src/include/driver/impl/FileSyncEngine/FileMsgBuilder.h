@@ -3,18 +3,42 @@
 
 #include "driver/interface/FileSyncEngine/FileMsgBuilderInterface.h"
 #include "driver/interface/JsonFactoryInterface.h"
-#include <fstream>
+#include "driver/interface/FileSyncEngine/FileSyncEngineInterface.h"
+#include "driver/impl/FileSyncEngine/BlockReader.h"
+#include "driver/impl/FileSyncEngine/DirectoryWork.h"
+#include "driver/impl/FileSyncEngine/ContentChunker.h"
+#include "driver/impl/FileSyncEngine/DeltaSync.h"
+#include "driver/impl/FileSyncEngine/MerkleTree.h"
+#include <future>
 
 class FileMsgBuilder : public FileMsgBuilderInterface
 {
 public:
     FileMsgBuilderInterface::FileMsgBuilderResult getStream() override;
-    FileMsgBuilder();
+    std::unique_ptr<std::vector<uint8_t>> buildStripeRoot(const std::string &merkle_root, const std::string &merkle_spans) override;
+    explicit FileMsgBuilder(size_t read_ahead_depth = FileSyncEngineInterface::read_ahead_depth);
 private:
     std::unique_ptr<std::vector<uint8_t>> buildHeader();
-    std::unique_ptr<std::vector<uint8_t>> buildEnd();
+    std::unique_ptr<std::vector<uint8_t>> buildEnd(std::map<std::string, std::string> args = {});
+    std::unique_ptr<std::vector<uint8_t>> buildStripeHeader();
     std::unique_ptr<std::vector<uint8_t>> buildBlock();
+    std::unique_ptr<std::vector<uint8_t>> buildPack();
+    std::unique_ptr<std::vector<uint8_t>> buildDirPaths();
+    std::unique_ptr<std::vector<uint8_t>> buildItemHeader(const DirectoryManifest::FileEntry &item);
+    // 分出下一批块并生成清单，第一条带空洞，分完时带Merkle根
+    std::unique_ptr<std::vector<uint8_t>> buildChunkBatch(bool is_first);
+    std::unique_ptr<std::vector<uint8_t>> buildDeltaHeader();
+    FileMsgBuilderInterface::FileMsgBuilderResult buildDeltaFrame();
+    FileMsgBuilderInterface::FileMsgBuilderResult buildNextItem(uint8_t progress);
+    FileMsgBuilderInterface::FileMsgBuilderResult finishTransfer(uint8_t progress, std::map<std::string, std::string> end_args = {});
+    // file_size为整个文件的大小，决定是否在发送位置之后丢弃页缓存
+    bool openSource(const std::wstring &wpath, uint64_t offset, uint64_t length, uint64_t file_size);
+    void closeSource();
     uint8_t calculateProgress();
+    // 在后台多线程计算Merkle根，与发送并行
+    void beginMerkleRoot(const std::wstring &wpath);
+    // 等待计算完成，把根与各段摘要加入args，计算失败时不加
+    void appendMerkleRoot(std::map<std::string, std::string> &args);
 private:
     enum class State
     {
@@ -25,6 +49,7 @@ private:
     };
     State file_state{ State::Default };
     uint64_t block_index{ 0 };
+    uint32_t block_size{ FileSyncEngineInterface::file_block_size }; // 当前文件的块大小
     std::unique_ptr<Json::JsonFactoryInterface> json_builder;
     uint64_t file_total_size{ 0 };
     uint64_t file_sended_size{ 0 };
@@ -33,9 +58,21 @@ private:
     uint64_t total_blocks{ 0 };
     bool is_folder{ false };
     bool is_end{ false };
-    uint64_t dir_file_index{ 0 };
-    std::vector<std::string> dir_items;
-    std::unique_ptr<std::ifstream> file_reader;
+    bool path_turn{ false }; // 叶子目录批次与目录项交替发送
+    // 分块清单边读边分，叶子哈希在同一遍读取中计算
+    std::unique_ptr<ContentChunker::Stream> manifest_stream;
+    std::unique_ptr<MerkleVerifier> manifest_merkle;
+    std::unique_ptr<DeltaEncoder> delta_encoder; // 增量模式下生成指令帧
+    std::future<MerkleTree::FileRoot> merkle_root;
+    std::unique_ptr<BlockReader> block_reader;
+    // 零拷贝模式下直接打开源文件，当前块的载荷位置随结果返回
+    std::unique_ptr<FileStreamHelper::PositionalReader> source_file;
+    uint64_t source_offset{ 0 };
+    uint32_t source_length{ 0 };
+    // 零拷贝模式下大文件已发送的部分丢弃页缓存，[drop_offset, drop_end)为已发送尚未丢弃的区间
+    bool is_drop_behind{ false };
+    uint64_t drop_offset{ 0 };
+    uint64_t drop_end{ 0 };
 };
 
 #endif
\ No newline at end of file
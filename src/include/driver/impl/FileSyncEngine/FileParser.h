@@ -2,37 +2,113 @@
 #define FILEPARSER_H
 
 #include "driver/interface/FileSyncEngine/FileParserInterface.h"
+#include "driver/interface/FileSyncEngine/FileSyncEngineInterface.h"
 #include "driver/interface/JsonFactoryInterface.h"
+#include "driver/interface/CompressionInterface.h"
+#include "driver/impl/FileSyncEngine/FileAssembler.h"
+#include "driver/impl/FileSyncEngine/WriteBehind.h"
+#include "driver/impl/FileSyncEngine/ChunkStore.h"
+#include "driver/impl/FileSyncEngine/DeltaSync.h"
 #include <map>
-#include <fstream>
+#include <unordered_set>
 #include <chrono>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
 
 class FileParser : public FileParserInterface
 {
 public:
-    FileParser();
+    FileParser(std::shared_ptr<FileAssembler> assembler, std::shared_ptr<CompressionInterface> compression = nullptr);
+    ~FileParser() override;
     void parse(std::unique_ptr<NetworkInterface::UserMsg> msg) override;
+    bool receiveBinary(UnifiedSocket socket, uint32_t payload_length) override;
 private:
+    void onItemReceived(uint32_t size);
+    // 当前目录项写完或中止时关闭，大文件剩余的脏页交给内核回写
+    void closeItem();
+    // 解包一帧中打包的多个小目录项并逐个写入
+    void unpackItems(const uint8_t *data, size_t size);
     void onFileHeader(std::unique_ptr<Json::Parser> content_parser);
     void onDirHeader(std::unique_ptr<Json::Parser> content_parser);
+    void onDirPaths(std::unique_ptr<Json::Parser> content_parser);
     void onDirItemHeader(std::unique_ptr<Json::Parser> content_parser);
     void onFileEnd(std::unique_ptr<Json::Parser> content_parser);
-    uint8_t calculateProgress();
+    void onFileStripe(std::unique_ptr<Json::Parser> content_parser);
+    void onFileRoot(std::unique_ptr<Json::Parser> content_parser);
+    // 事件循环上只解析清单，读出并校验已有的块、写入新文件交给拷贝线程
+    void onFileChunks(std::unique_ptr<Json::Parser> content_parser);
+    void chunkLoop();
+    // 清单第一批到达时建立临时目录的块索引，旧版本的同名文件改名后作为块来源
+    // holes为发送端宣告的空洞，建立稀疏文件并记入续传日志
+    void beginChunks(uint32_t id, uint64_t total_size, const std::vector<TransferJournal::Range> &holes);
+    // 清单结束后文件已完整则直接完成，否则请求缺失的区间
+    void finishChunks();
+    // 旧版本改名后作为拷贝来源，新版本按指令顺序写在原路径上
+    void onFileDelta(std::unique_ptr<Json::Parser> content_parser);
+    void applyDelta(const uint8_t *data, size_t size);
+    // 重建结果与发送端哈希不一致时删除并重新下载整个文件
+    void finishDelta(const std::string &expected_hash);
+    // 增量传输未收到结束就开始了其他传输时放弃重建，恢复旧版本并报告下载失败
+    void abandonDelta();
+    uint32_t parseBlockSize(Json::Parser &content_parser);
+    // 目录可能晚于其中的文件到达，写文件前确保父目录存在
+    void ensureDirectory(const std::string &relative_path);
+    void ensureParentDirectory(const std::string &relative_path);
 private:
     std::unique_ptr<Json::JsonFactoryInterface> json_parser;
     std::map < std::string, std::function<void(std::unique_ptr<Json::Parser>)>> type_parser_map;
-    std::unique_ptr<std::ofstream> file_stream;
+    std::unique_ptr<FileStreamHelper::PositionalWriter> item_writer;
+    std::unique_ptr<WriteBehind> item_write_behind; // 目录项不小于drop_behind_min_size时跟随写入回写并丢弃缓存
     std::wstring dir_path;
+    std::unordered_set<std::string> created_dirs; // 当前文件夹下已创建的相对目录
     uint32_t current_file_id;
-    uint64_t total_size{ 0 };
-    uint64_t received_size{ 0 };
+    uint32_t block_size{ FileSyncEngineInterface::file_block_size }; // 当前文件的块大小，随头部下发
     bool is_folder{ false };
-    uint8_t progress_count{ 0 };
+    bool is_rejected{ false }; // 当前文件夹因空间不足被拒绝，丢弃其后的目录项与块
     std::string file_name;
 
-    uint32_t bytes_received{ 0 };
-    std::chrono::steady_clock::time_point start_time_point;
-    std::chrono::steady_clock::time_point end_time_point;
+    // 一条分块清单，由拷贝线程按到达顺序处理
+    struct ChunkBatch
+    {
+        uint32_t id{ 0 };
+        uint64_t total_size{ 0 };
+        std::vector<TransferJournal::Range> holes;
+        std::vector<ContentChunker::Chunk> chunks;
+        bool is_last{ false };
+        std::string merkle_root;
+        std::string merkle_spans;
+    };
+    void copyChunks(const ChunkBatch &batch);
+    std::thread chunk_thread; // 收到第一条清单时启动
+    std::mutex chunk_mutex;    // 保护chunk_batches
+    std::condition_variable chunk_cv;
+    std::deque<ChunkBatch> chunk_batches;
+    std::atomic<bool> is_chunk_stopped{ false };
+
+    // 按分块清单从已有文件拼装的文件，只由拷贝线程访问
+    uint32_t chunk_file_id{ 0 };
+    std::wstring chunk_previous_path;
+    std::unique_ptr<ChunkStore> chunk_store;
+    std::unique_ptr<FileStreamHelper::PositionalWriter> chunk_writer;
+    std::unique_ptr<TransferJournal> chunk_journal;
+
+    // 按增量指令从旧版本重建的文件
+    uint32_t delta_file_id{ 0 };
+    uint64_t delta_total_size{ 0 };
+    std::wstring delta_basis_path;
+    std::wstring delta_target_path;
+    std::unique_ptr<DeltaDecoder> delta_decoder;
+    uint32_t delta_frame_count{ 0 };
+    uint64_t delta_reported_size{ 0 };
+    std::chrono::steady_clock::time_point delta_report_time;
+
+    // 单文件与条带由所有连接共享的重组器写入，文件夹进度也在其中汇总
+    std::shared_ptr<FileAssembler> file_assembler;
+    // 解压带IS_COMPRESS标志的文件块
+    std::shared_ptr<CompressionInterface> compression_instance;
 };
 
 #endif
\ No newline at end of file
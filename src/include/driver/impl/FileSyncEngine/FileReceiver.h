@@ -4,14 +4,23 @@
 #include "driver/interface/FileSyncEngine/FileReceiverInterface.h"
 #include "driver/interface/OuterMsgParserInterface.h"
 #include "driver/interface/PlatformSocket.h"
+#include "driver/impl/FileSyncEngine/FlowControl.h"
+#include "driver/impl/SocketPoller.h"
 #include <thread>
 #include <vector>
+#include <unordered_map>
 #include <mutex>
 #include <memory>
 
+// 所有数据连接由固定数量的事件循环线程服务，每个连接固定归属一个循环，同一连接的帧按顺序处理
+// 监听socket挂在第一个循环上，新连接分给当前连接最少的循环
 class FileReceiver : public FileReceiverInterface
 {
 public:
+    inline static const unsigned max_event_loops = 4;
+    // 一个连接单次可读最多读取的字节数，避免高速连接饿死同一循环上的其他连接
+    inline static const size_t max_bytes_per_wakeup = 4 * 1024 * 1024;
+
     using FileReceiverInterface::FileReceiverInterface;
 
     bool initialize() override;
@@ -25,26 +34,44 @@ public:
     }
 
 private:
+    struct Connection
+    {
+        OuterMsgParserInterface::RecvState recv_state;
+        std::shared_ptr<CreditGranter> granter;
+        size_t loop_index{0};
+    };
+
+    struct EventLoop
+    {
+        SocketPoller poller;
+        std::thread thread;
+        size_t connection_count{0}; // 受sockets_mutex保护
+    };
+
     UnifiedSocket createListenSocket(const std::string &address, const std::string &port);
     void closeReceiver();
+    void runLoop(size_t loop_index);
+    void acceptConnection();
     void removeSocket(UnifiedSocket socket);
+    // 一帧处理完毕，按连接的空闲额度授予信用
+    void onFrameConsumed(UnifiedSocket socket, uint64_t frame_size);
 
 private:
-    UnifiedSocket listen_socket;
-    sockaddr_in accept_addr;
-    std::unique_ptr<std::thread> tcp_listen_thread;
-    std::vector<UnifiedSocket> receive_sockets;
-    std::vector<std::shared_ptr<std::thread>> receive_threads;
+    UnifiedSocket listen_socket{INVALID_SOCKET_VAL};
+    std::vector<std::unique_ptr<EventLoop>> event_loops;
+    std::unordered_map<UnifiedSocket, std::shared_ptr<Connection>> connections;
     std::unique_ptr<OuterMsgParserInterface> outer_parser;
+    std::function<void(UnifiedSocket)> accept_cb;
+    std::function<void(UnifiedSocket socket, std::unique_ptr<NetworkInterface::UserMsg>)> msg_cb;
 
-    std::mutex sockets_mutex; // 保护receive_sockets
-    std::mutex threads_mutex; // 保护receive_threads
+    std::mutex sockets_mutex; // 保护connections与各循环的connection_count
 
 protected:
     using FileReceiverInterface::address;
     using FileReceiverInterface::port;
     using FileReceiverInterface::running;
     using FileReceiverInterface::security_instance;
+    using FileReceiverInterface::binary_payload_sink;
 };
 
 #endif // FILERECEIVER_H
\ No newline at end of file
@@ -4,23 +4,35 @@
 #include "driver/interface/FileSyncEngine/FileSenderInterface.h"
 #include "driver/interface/FileSyncEngine/FileMsgBuilderInterface.h"
 #include "driver/interface/PlatformSocket.h"
+#include "driver/impl/FileSyncEngine/BlockSizeTuner.h"
+#include "driver/impl/FileSyncEngine/BlockCompressor.h"
+#include "driver/impl/FileSyncEngine/FlowControl.h"
 #include <mutex>
 #include <thread>
 #include <chrono>
 #include <memory>
-#include <condition_variable>
 
 class FileSender : public FileSenderInterface
 {
 public:
     using FileSenderInterface::FileSenderInterface;
     bool initialize() override;
-    void start(std::function<std::optional<std::pair<uint32_t, std::string>>()> get_task_cb) override;
+    void start(std::function<std::optional<FileSyncEngineInterface::SendTask>()> get_task_cb) override;
     void stop() override;
     ~FileSender() override;
 
 private:
     void sendMsg(std::vector<uint8_t> &&msg, bool is_binary);
+    bool sendAll(const uint8_t *data, size_t length, int flags);
+    // Header与载荷分散在两个缓冲区，用sendmsg/WSASend一起发出
+    bool sendFrame(const OuterMsgBuilderInterface::Frame &frame);
+#ifdef __linux__
+    void sendFileRegion(std::vector<uint8_t> &&prefix, FileStreamHelper::PositionalReader &source,
+                        uint64_t offset, uint32_t length);
+#endif
+    // 用一段发送的字节数与耗时及TCP状态更新块大小
+    void sampleLink(uint64_t bytes, std::chrono::microseconds elapsed);
+    void reportStripeProgress(uint32_t id, FileSyncEngineInterface::StripeProgress &progress);
 
 private:
     sockaddr_in client_tcp_addr;
@@ -30,10 +42,11 @@ private:
     WSADATA wsa_data;
 #endif
 
-    std::mutex mtx;
-    std::condition_variable cv;
     std::thread *send_thread{nullptr};
     std::unique_ptr<FileMsgBuilderInterface> file_msg_builder;
+    BlockSizeTuner block_size_tuner;
+    std::unique_ptr<BlockCompressor> block_compressor;
+    std::unique_ptr<CreditAccount> credit_account; // 对端不支持流控时为空
 
     uint32_t bytes_sent{0};
     std::chrono::steady_clock::time_point start_time_point;
@@ -0,0 +1,60 @@
+#ifndef FLOWCONTROL_H
+#define FLOWCONTROL_H
+
+#include "driver/interface/PlatformSocket.h"
+#include <chrono>
+#include <stdint.h>
+
+// 接收端驱动的信用流控：接收端按尚未处理的字节数授予信用，发送端只在信用余额为正时发出下一帧
+// 信用以帧长（Header + 载荷）计，授予消息是接收端写回数据连接的8字节大端整数，表示累计授予的字节数，
+// 累计值使重复或合并的授予消息无副作用。余额为正即可发送整帧，超出部分从之后的授予中扣除，帧长不受窗口限制
+// 接收端，每个连接一个，由负责该连接的事件循环线程调用
+class CreditGranter
+{
+public:
+    // 允许在途（已授予但尚未处理）的字节数
+    inline static const uint64_t credit_window = 32ULL * 1024 * 1024;
+    // 空闲额度达到该值才发送授予，减少反向的小包
+    inline static const uint64_t grant_threshold = credit_window / 4;
+
+    explicit CreditGranter(UnifiedSocket socket);
+    // 连接建立后授予初始窗口
+    bool start();
+    // 一帧处理完毕后调用
+    void onConsumed(uint64_t frame_size);
+
+private:
+    bool grant();
+
+private:
+    UnifiedSocket socket;
+    uint64_t granted_size{0};
+    uint64_t consumed_size{0};
+};
+
+// 发送端，每个发送连接一个
+class CreditAccount
+{
+public:
+    // 连接后等待初始信用的时长，超时视为对端不支持流控
+    inline static const std::chrono::milliseconds handshake_timeout{1000};
+
+    explicit CreditAccount(UnifiedSocket socket);
+    // 等待初始信用，对端不支持流控时返回false
+    bool handshake();
+    // 阻塞直到余额为正后扣除frame_size，running变为false或连接出错时返回false
+    bool acquire(uint64_t frame_size, const bool &running);
+
+private:
+    // 等待最多timeout_ms读取授予消息，连接出错时返回false
+    bool readGrants(int timeout_ms);
+
+private:
+    UnifiedSocket socket;
+    uint64_t granted_size{0};
+    uint64_t sent_size{0};
+    uint8_t partial[8]{};
+    size_t partial_size{0};
+};
+
+#endif
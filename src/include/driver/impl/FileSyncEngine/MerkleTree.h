@@ -0,0 +1,85 @@
+#ifndef MERKLETREE_H
+#define MERKLETREE_H
+
+#include "driver/interface/FileStreamHelper.h"
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include <stdint.h>
+
+typedef struct evp_md_ctx_st EVP_MD_CTX;
+
+// 端到端完整性校验：文件按leaf_size切分为叶子，叶子哈希为SHA256(0x00 || 数据)，父节点为SHA256(0x01 || 左 || 右)
+// 某层节点数为奇数时最后一个直接升到上一层，空文件的根为空叶子的哈希；根以十六进制随file_end或分块清单下发
+// 叶子按span个一段（2的幂，段数不超过max_spans），各段子树根的前span_digest_size个十六进制字符随根一起下发，用于定位损坏的段
+class MerkleTree
+{
+public:
+    inline static const uint32_t leaf_size = 1024 * 1024;
+    inline static const unsigned max_threads = 8;
+    inline static const uint64_t max_spans = 1024;
+    inline static const size_t span_digest_size = 16;
+
+    using Digest = std::array<uint8_t, 32>;
+    struct FileRoot
+    {
+        std::string root; // 失败时为空
+        std::string spans;
+    };
+
+    static uint64_t leafCount(uint64_t file_size);
+    // 每段的叶子数
+    static uint64_t spanLeaves(uint64_t leaf_count);
+    static Digest hashLeaf(const uint8_t *data, size_t size);
+    static std::string rootOf(const std::vector<Digest> &leaves);
+    static std::string spansOf(const std::vector<Digest> &leaves);
+    // 多个线程各读一段连续的叶子，计算indices中各叶子的哈希写入digests对应位置
+    // 完全落在文件空洞中的叶子不读取，直接取全零叶子的哈希；stop置位时中途放弃并返回false
+    static bool hashLeaves(const std::wstring &path, uint64_t file_size, const std::vector<uint64_t> &indices,
+                           std::vector<Digest> &digests, const std::atomic<bool> *stop = nullptr);
+    // 计算整个文件的根与各段的摘要
+    static FileRoot computeFile(const std::wstring &path, const std::atomic<bool> *stop = nullptr);
+};
+
+// 接收端边写边计算叶子哈希：叶子内的数据按顺序到达时流式计算，乱序、重传或续传前已有的叶子在结束时从文件补算
+// 发送端分块时也用它在读取分块的同一遍中计算根，空洞中未读取的叶子同样在结束时补算
+// 不同连接写入不同的叶子，哈希计算不持锁
+class MerkleVerifier
+{
+public:
+    MerkleVerifier(const std::wstring &path, uint64_t total_size);
+    ~MerkleVerifier();
+    // data为nullptr时（数据直接从socket写入文件）从文件读回刚写入的范围，需在文件创建之后构造
+    void update(uint64_t offset, const uint8_t *data, size_t size);
+    // 补算未完成的叶子后返回根，失败时返回空串
+    std::string finish();
+    // finish之后调用，返回各段的摘要
+    std::string spans() const;
+    // finish之后调用，返回与发送端摘要不一致的段的字节区间(offset, length)，摘要无法对应时返回整个文件
+    std::vector<std::pair<uint64_t, uint64_t>> mismatchedRanges(const std::string &expected_spans) const;
+
+private:
+    struct Leaf
+    {
+        uint32_t streamed_size{0}; // 从叶子起点按顺序计算过的字节数
+        bool is_done{false};
+        bool is_broken{false}; // 出现乱序写入，只能从文件补算
+        EVP_MD_CTX *ctx{nullptr};
+        MerkleTree::Digest digest{};
+    };
+    uint32_t leafSize(uint64_t index) const;
+    void updateLeaf(uint64_t index, uint32_t leaf_offset, const uint8_t *data, uint32_t size);
+
+private:
+    std::wstring path;
+    uint64_t total_size;
+    FileStreamHelper::PositionalReader reader; // 读回直接写入文件的数据，定位读取可多线程共用
+    std::mutex mtx; // 保护leaves的状态
+    std::vector<Leaf> leaves;
+    std::vector<MerkleTree::Digest> digests; // finish时得到的所有叶子哈希
+};
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef RATELIMITER_H
+#define RATELIMITER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <unordered_map>
+#include <stdint.h>
+
+// 令牌桶限速：令牌按速率累积，最多积攒burst_time内的量
+// 以块为粒度放行，令牌不为负即可发送整块，不足的部分记为欠账，之后的块等待欠账还清
+class TokenBucket
+{
+public:
+    inline static const std::chrono::milliseconds burst_time{200};
+
+    // 速率为0表示不限速
+    void setRate(uint64_t bytes_per_second);
+    uint64_t rate() const { return rate_bps; }
+    // 可以发送时扣除bytes并返回0，否则返回需要等待的时长
+    std::chrono::microseconds tryConsume(uint64_t bytes);
+
+private:
+    void refill();
+
+private:
+    uint64_t rate_bps{0};
+    double tokens{0};
+    std::chrono::steady_clock::time_point last_time{std::chrono::steady_clock::now()};
+};
+
+// 发送端的全局限速与按传输id的限速，所有发送线程共用，运行中可随时调整
+class RateLimiter
+{
+public:
+    void setGlobalRate(uint64_t bytes_per_second);
+    // 速率为0时取消该传输的限速
+    void setTransferRate(uint32_t id, uint64_t bytes_per_second);
+    // 发送一块之前调用，先满足传输自身的限速再满足全局限速
+    void acquire(uint32_t id, uint64_t bytes);
+    // 唤醒所有等待中的发送线程并直接放行，之后的acquire也立即返回，直到resume，用于停止发送
+    void interrupt();
+    // 恢复限速，重新启动发送时调用
+    void resume();
+
+private:
+    // 等待bucket放行，期间被interrupt时返回false
+    bool acquireFrom(std::unique_lock<std::mutex> &lock, uint32_t id, bool is_global, uint64_t bytes);
+
+private:
+    std::mutex mtx;
+    std::condition_variable cv;
+    TokenBucket global_bucket;
+    std::unordered_map<uint32_t, TokenBucket> transfer_buckets;
+    bool is_interrupted{false};
+};
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef TRANSFERJOURNAL_H
+#define TRANSFERJOURNAL_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+// 接收端断点续传日志，记录已写入临时文件的区间，与临时文件同目录保存
+// 格式：第一行为文件总大小，已知发送端Merkle根时其后跟根的十六进制与各段摘要；其后每行一个已提交区间 "offset length"
+class TransferJournal
+{
+public:
+    struct Range
+    {
+        uint64_t offset;
+        uint64_t length;
+    };
+    inline static const std::wstring journal_suffix = L".xftjournal";
+
+    explicit TransferJournal(const std::wstring &data_path);
+    // 加载日志，expected_size为0时不校验总大小；临时文件缺失或不完整时视为无效
+    bool load(uint64_t expected_size = 0);
+    void reset(uint64_t size);
+    // 提交一个已写入的区间，返回新覆盖的字节数
+    uint64_t commit(uint64_t offset, uint64_t length);
+    bool save();
+    void remove();
+    uint64_t totalSize() const { return total_size; }
+    uint64_t committedSize() const { return committed_size; }
+    std::vector<Range> missingRanges() const;
+    // 完成时用于校验整个文件的Merkle根，未知时为空
+    void setMerkleRoot(const std::string &root) { merkle_root = root; }
+    const std::string &merkleRoot() const { return merkle_root; }
+    // 校验失败时用于定位损坏的段，未知时为空
+    void setMerkleSpans(const std::string &spans) { merkle_spans = spans; }
+    const std::string &merkleSpans() const { return merkle_spans; }
+
+    static std::string rangesToString(const std::vector<Range> &ranges);
+    static std::vector<Range> rangesFromString(const std::string &str);
+
+private:
+    std::wstring data_path;
+    std::wstring journal_path;
+    uint64_t total_size{0};
+    uint64_t committed_size{0};
+    std::string merkle_root;
+    std::string merkle_spans;
+    std::map<uint64_t, uint64_t> committed; // offset -> end，互不重叠且不相邻
+};
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef TRANSFERSCHEDULER_H
+#define TRANSFERSCHEDULER_H
+
+#include "driver/interface/FileSyncEngine/FileSyncEngineInterface.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+// 发送任务调度：每个发送连接一个双端队列，新任务放入排队字节数最少的队列
+// 连接先取自己队列的队首，空了再从排队最多的队列窃取；没有任务时在条件变量上等待，入队时立即唤醒
+class TransferScheduler
+{
+public:
+    enum class Policy
+    {
+        Fifo,         // 按入队顺序
+        SmallestFirst // 预计字节数少的优先，小文件尽快完成；排队越久越靠前，大文件不会被持续到达的小文件饿死
+    };
+
+    explicit TransferScheduler(size_t worker_count, Policy policy = Policy::SmallestFirst);
+    void submit(FileSyncEngineInterface::SendTask task);
+    // 一组任务（条带、文件夹各部分）轮流放入不同的队列，各连接可以同时开始
+    void submit(std::vector<FileSyncEngineInterface::SendTask> tasks);
+    // 阻塞直到取得任务，调度器停止后返回空
+    std::optional<FileSyncEngineInterface::SendTask> take(size_t worker);
+    // 丢弃已排队的任务并唤醒所有等待的连接；停止期间提交的任务保留到resume之后
+    void stop();
+    void resume();
+
+private:
+    struct Entry
+    {
+        FileSyncEngineInterface::SendTask task;
+        uint64_t insertion_order;
+        // 入队时已取走的总字节数加上任务大小，之后入队的任务需小于该值才能排在前面
+        uint64_t deadline;
+    };
+    struct Worker
+    {
+        std::mutex mtx;
+        std::deque<Entry> tasks;
+        uint64_t queued_size{0};
+    };
+
+    bool isBefore(const Entry &lhs, const Entry &rhs) const;
+    void push(size_t worker, FileSyncEngineInterface::SendTask task);
+    std::optional<FileSyncEngineInterface::SendTask> pop(Worker &worker, bool from_back);
+    std::optional<FileSyncEngineInterface::SendTask> steal(size_t thief);
+    size_t leastLoaded();
+    void notify(size_t count);
+
+private:
+    std::vector<std::unique_ptr<Worker>> workers;
+    Policy policy;
+    std::atomic<uint64_t> insertion_counter{0};
+    std::atomic<uint64_t> taken_size{0}; // 所有连接已取走任务的预计字节数
+    std::atomic<size_t> pending_count{0}; // 所有队列中的任务数，等待条件
+    std::mutex wait_mutex;
+    std::condition_variable wait_cv;
+    bool is_stopped{false};
+};
+
+#endif
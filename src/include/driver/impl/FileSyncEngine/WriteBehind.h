@@ -0,0 +1,30 @@
+#ifndef WRITEBEHIND_H
+#define WRITEBEHIND_H
+
+#include "driver/interface/FileStreamHelper.h"
+#include <deque>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <stdint.h>
+
+// 接收大文件时跟在写入位置之后回写并丢弃页缓存：已落盘的连续区间每满drop_behind_window发起一次异步回写，
+// 在途回写超过max_flushing段时等待最早的一段写完并从缓存中丢弃，脏页总量有界，文件结束时无需集中刷盘
+// 多个连接的条带交错写入，按区间末尾合并各自连续的部分
+class WriteBehind
+{
+public:
+    inline static const size_t max_flushing = 8;
+
+    // 记录writer的[offset, offset + size)已写入，可能阻塞到更早的区间回写完成，可在多个线程调用
+    void onWritten(FileStreamHelper::PositionalWriter &writer, uint64_t offset, uint64_t size);
+    // 文件写完时发起剩余区间的回写并丢弃已写回的缓存，不等待
+    void finish(FileStreamHelper::PositionalWriter &writer);
+
+private:
+    std::mutex mtx;
+    std::map<uint64_t, uint64_t> pending_runs;           // 尚未发起回写的连续区间，末尾 -> 起点
+    std::deque<std::pair<uint64_t, uint64_t>> flushing; // 已发起回写的区间（起点，长度），按发起顺序
+};
+
+#endif
@@ -55,6 +55,19 @@ public:
         return fs::exists(file_path);
     }
 
+    // 获取路径所在文件系统中当前用户可用的空间（字节），查询失败时返回UINT64_MAX
+    static uint64_t getAvailableSpace(const std::string &path)
+    {
+        std::error_code ec;
+        fs::space_info info = fs::space(fs::u8path(path), ec);
+        if (ec)
+        {
+            LOG_ERROR("Failed to query free space of " << path << ": " << ec.message());
+            return UINT64_MAX;
+        }
+        return info.available;
+    }
+
     // 判断是否为文件夹
     static bool isDirectory(const std::string &path)
     {
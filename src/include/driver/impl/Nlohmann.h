@@ -43,6 +43,10 @@ public:
     {
         throw std::runtime_error("Don't use UserJsonMsgBuilder to build FileMsg");
     }
+    std::string buildFileListMsg(Json::MessageType::File::Type type, std::map<std::string, std::string> args, std::vector<std::string> && /*items*/) override
+    {
+        throw std::runtime_error("Don't use UserJsonMsgBuilder to build FileMsg");
+    }
 
 private:
     Json::MessageRegistry registry;
@@ -60,6 +64,10 @@ public:
     {
         throw std::runtime_error("Don't use SyncJsonMsgBuilder to build FilecMsg");
     }
+    std::string buildFileListMsg(Json::MessageType::File::Type type, std::map<std::string, std::string> args, std::vector<std::string> && /*items*/) override
+    {
+        throw std::runtime_error("Don't use SyncJsonMsgBuilder to build FilecMsg");
+    }
 };
 
 class FileJsonMsgBuilder : public Json::JsonBuilder
@@ -79,10 +87,13 @@ public:
         throw std::runtime_error("Don't use FileJsonMsgBuilder to build SyncMsg");
     }
     std::string buildFileMsg(Json::MessageType::File::Type type, std::map<std::string, std::string> args) override;
+    std::string buildFileListMsg(Json::MessageType::File::Type type, std::map<std::string, std::string> args, std::vector<std::string> &&items) override;
 
 private:
     void buildFileHeader(json &result, Json::MessageType::File::Type type, const std::map<std::string, std::string> &args);
     void buildDirHeader(json &result, Json::MessageType::File::Type type, const std::map<std::string, std::string> &args);
     void buildDirItemHeader(json &result, Json::MessageType::File::Type type, const std::map<std::string, std::string> &args);
+    void buildFileStripe(json &result, Json::MessageType::File::Type type, const std::map<std::string, std::string> &args);
+    void buildFileDelta(json &result, Json::MessageType::File::Type type, const std::map<std::string, std::string> &args);
 };
 #endif
\ No newline at end of file
@@ -19,9 +19,16 @@ public:
         const std::vector<uint8_t>& iv,
         std::vector<uint8_t>& out_plaintext,
         std::vector<uint8_t>& sha256) override;
+    bool aeadSeal(const uint8_t* key, const uint8_t* nonce, const uint8_t* aad, size_t aad_length,
+        const uint8_t* in, size_t length, uint8_t* out, uint8_t* tag) override;
+    bool aeadOpen(const uint8_t* key, const uint8_t* nonce, const uint8_t* aad, size_t aad_length,
+        const uint8_t* in, size_t length, uint8_t* out, const uint8_t* tag) override;
     void dealTlsRequest(SOCKET_TYPE socket, std::function<void(bool, TlsInfo)> callback) override;
     bool generateAndLoadTempCertificate();
 private:
+    // 密钥之后双方各发送一个字节的帧模式位图，旧版本不发送，读不到即按旧模式处理
+    inline static const uint8_t frame_mode_aead = 0x01;
+
     SSL_CTX* client_ctx;  // 客户端上下文
     SSL_CTX* server_ctx;  // 服务器上下文
 
@@ -5,6 +5,8 @@
 #include "driver/interface/SecurityInterface.h"
 #include <vector>
 #include <memory>
+#include <atomic>
+#include <mutex>
 #include <stdint.h>
 
 class OuterMsgBuilder : public OuterMsgBuilderInterface
@@ -14,9 +16,24 @@ public:
     ~OuterMsgBuilder() = default;
     std::unique_ptr<NetworkInterface::UserMsg> buildMsg(std::string payload, NetworkInterface::Flag flag) override;
     std::unique_ptr<NetworkInterface::UserMsg> buildMsg(std::vector<uint8_t> payload, NetworkInterface::Flag flag) override;
+    std::unique_ptr<Frame> buildFrame(std::vector<uint8_t> &&payload, NetworkInterface::Flag flag) override;
+    std::vector<uint8_t> buildHeader(uint32_t payload_length, NetworkInterface::Flag flag) override;
+    void setSecurityInstance(std::shared_ptr<SecurityInterface> instance) override;
 private:
     std::unique_ptr<NetworkInterface::UserMsg> build(std::vector<uint8_t> payload, NetworkInterface::Flag flag) override;
+    std::unique_ptr<Frame> buildAead(std::vector<uint8_t> &&payload, NetworkInterface::Flag flag,
+                                     const SecurityInterface::TlsInfo &tls_info);
+    // 取下一个GCM的nonce，密钥更换后计数从0开始，计数用尽时返回false
+    bool nextNonce(const SecurityInterface::TlsInfo &tls_info, uint8_t *nonce);
+    void writeHeader(uint8_t *dst, uint8_t header_version, uint32_t payload_length, NetworkInterface::Flag flag);
     uint8_t version;
+    // GCM的nonce为 本端角色(1字节) + 构造器编号(3字节) + 帧计数(8字节)，
+    // 两端共用一个密钥，角色与编号保证同一密钥下每个构造器的nonce互不重叠，所有发送线程共用计数
+    inline static std::atomic<uint32_t> next_builder_id{0};
+    uint32_t builder_id;
+    std::mutex nonce_mutex;
+    std::shared_ptr<uint8_t[]> nonce_key; // 计数所属的密钥，持有以免地址被新密钥复用
+    uint64_t nonce_counter{0};
 };
 
 #endif //_USERSERVERMSG_H
\ No newline at end of file
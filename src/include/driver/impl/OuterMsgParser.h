@@ -12,8 +12,22 @@ public:
                       std::function<void(const NetworkInterface::RecvError error)> dre_cb,
                       std::shared_ptr<SecurityInterface> security_instance,
                       bool &running) override;
+    bool receiveAvailable(UnifiedSocket client_socket, RecvState &state,
+                          const std::function<void(std::unique_ptr<NetworkInterface::UserMsg> parsed_msg)> &callback,
+                          const std::shared_ptr<SecurityInterface> &security_instance,
+                          size_t max_bytes) override;
 
 private:
+    // 明文未压缩的文件块交给binary_payload_sink直接搬运
+    bool isSinkPayload(uint8_t flag) const;
+    // 解析完整的帧，加密的先解密再回调
+    void deliver(const uint8_t *header, std::vector<uint8_t> &&payload, uint32_t payload_length, uint8_t flag,
+                 const std::function<void(std::unique_ptr<NetworkInterface::UserMsg> parsed_msg)> &callback,
+                 const std::shared_ptr<SecurityInterface> &security_instance);
+    // AES-256-GCM帧从载荷直接解密到消息，校验失败的帧丢弃
+    void deliverAead(const uint8_t *header, const std::vector<uint8_t> &payload, uint32_t payload_length,
+                     const std::function<void(std::unique_ptr<NetworkInterface::UserMsg> parsed_msg)> &callback,
+                     const std::shared_ptr<SecurityInterface> &security_instance);
     void dealRecvError(std::function<void()> dcc_cb,
                        std::function<void(const NetworkInterface::RecvError error)> dre_cb);
     std::unique_ptr<NetworkInterface::UserMsg> parse(std::vector<uint8_t> &&msg, const uint32_t length, const uint8_t flag) override;
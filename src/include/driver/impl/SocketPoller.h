@@ -0,0 +1,42 @@
+#ifndef SOCKETPOLLER_H
+#define SOCKETPOLLER_H
+
+#include "driver/interface/PlatformSocket.h"
+#include <vector>
+#ifdef _WIN32
+#include <mutex>
+#endif
+
+// 等待一组socket可读，供单个线程服务多个连接
+// Linux使用epoll（水平触发），Windows退化为WSAPoll，每轮重新收集socket，新加入的socket最迟在poll_interval后生效
+class SocketPoller
+{
+public:
+    inline static const int poll_interval = 100; // 毫秒，无法被唤醒的平台上wait的最长阻塞时间
+
+    SocketPoller();
+    ~SocketPoller();
+    SocketPoller(const SocketPoller &) = delete;
+    SocketPoller &operator=(const SocketPoller &) = delete;
+
+    bool isValid() const;
+    // add/remove可在其他线程调用
+    bool add(UnifiedSocket socket);
+    void remove(UnifiedSocket socket);
+    // 阻塞到有socket可读（对端关闭或出错也算可读，由随后的recv判断）或被唤醒，timeout_ms为-1时不超时
+    // 返回可读socket的个数，出错返回-1
+    int wait(std::vector<UnifiedSocket> &ready, int timeout_ms);
+    // 让阻塞中的wait立即返回
+    void wakeup();
+
+private:
+#ifdef _WIN32
+    std::mutex sockets_mutex;
+    std::vector<UnifiedSocket> sockets;
+#else
+    int epoll_fd{-1};
+    int event_fd{-1}; // 用于唤醒的eventfd
+#endif
+};
+
+#endif
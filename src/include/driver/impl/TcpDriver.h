@@ -6,6 +6,7 @@
 #include "driver/interface/OuterMsgParserInterface.h"
 #include <thread>
 #include <atomic>
+#include <mutex>
 
 class TcpDriver : public NetworkInterface
 {
@@ -66,6 +67,7 @@ private:
     std::atomic<bool> listen_running{false};
     bool recv_running{false};
     std::atomic<bool> connect_status{false};
+    std::mutex send_mutex; // 多个线程发送时保证帧不交错
 };
 
 #endif //_TCPDRIVER_H
\ No newline at end of file
@@ -0,0 +1,14 @@
+#ifndef _ZLIBDRIVER_H
+#define _ZLIBDRIVER_H
+
+#include "driver/interface/CompressionInterface.h"
+
+// deflate最快档，压缩数据前是4字节的原始长度
+class ZlibDriver : public CompressionInterface
+{
+public:
+    bool compress(const uint8_t *src, size_t size, std::vector<uint8_t> &dst) override;
+    bool decompress(const uint8_t *src, size_t size, std::vector<uint8_t> &dst, size_t max_size) override;
+};
+
+#endif //_ZLIBDRIVER_H
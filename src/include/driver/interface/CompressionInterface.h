@@ -0,0 +1,19 @@
+#ifndef _COMPRESSIONINTERFACE_H
+#define _COMPRESSIONINTERFACE_H
+
+#include <vector>
+#include <cstddef>
+#include <stdint.h>
+
+// 压缩实现需可被多个发送线程同时调用
+class CompressionInterface
+{
+public:
+    virtual ~CompressionInterface() = default;
+    // 压缩结果写入dst，失败时返回false
+    virtual bool compress(const uint8_t *src, size_t size, std::vector<uint8_t> &dst) = 0;
+    // 解压结果写入dst，数据损坏或解压后超过max_size时返回false
+    virtual bool decompress(const uint8_t *src, size_t size, std::vector<uint8_t> &dst, size_t max_size) = 0;
+};
+
+#endif //_COMPRESSIONINTERFACE_H
@@ -7,13 +7,27 @@
 #include <string>
 #include <codecvt>
 #include <locale>
+#include <algorithm>
+#include <cstring>
+
+#include <stdint.h>
+#include <utility>
+#include <vector>
 
 #ifdef _WIN32
 #include <windows.h>
+#include <winioctl.h>
 #else
 #include <string>
 #include <codecvt>
 #include <locale>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
 #endif
 
 namespace FileStreamHelper
@@ -53,6 +67,678 @@ namespace FileStreamHelper
         return converter.to_bytes(wstr);
 #endif
     }
+
+    // 跨平台的定位写文件，写入不依赖文件指针，多个线程可并发写入不同偏移
+    class PositionalWriter
+    {
+    public:
+        // truncate为false时保留已有内容，用于断点续传
+        explicit PositionalWriter(const std::wstring &wpath, bool truncate = true)
+        {
+#ifdef _WIN32
+            handle = CreateFileW(wpath.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+                                 truncate ? CREATE_ALWAYS : OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+#else
+            fd = ::open(wstringToLocalPath(wpath).c_str(), O_WRONLY | O_CREAT | (truncate ? O_TRUNC : 0), 0644);
+#endif
+        }
+        ~PositionalWriter()
+        {
+#ifdef _WIN32
+            if (handle != INVALID_HANDLE_VALUE)
+            {
+                CloseHandle(handle);
+            }
+#else
+            if (fd >= 0)
+            {
+                ::close(fd);
+            }
+#endif
+        }
+        PositionalWriter(const PositionalWriter &) = delete;
+        PositionalWriter &operator=(const PositionalWriter &) = delete;
+
+        bool isOpen() const
+        {
+#ifdef _WIN32
+            return handle != INVALID_HANDLE_VALUE;
+#else
+            return fd >= 0;
+#endif
+        }
+
+        // 预先分配size字节的磁盘空间但不改变文件长度，减少大文件逐块增长造成的碎片
+        // 空间不足时返回false，文件系统不支持预分配时忽略
+        bool reserve(uint64_t size)
+        {
+            return reserve(0, size);
+        }
+
+        // 只预分配[offset, offset + size)，稀疏文件的空洞不占用空间；Windows只能从文件开头整体预分配，其余区间忽略
+        bool reserve(uint64_t offset, uint64_t size)
+        {
+            if (size == 0)
+            {
+                return true;
+            }
+#ifdef _WIN32
+            // 分配大小小于文件长度时会截断文件
+            LARGE_INTEGER current_size{};
+            if (offset != 0 || !GetFileSizeEx(handle, &current_size) || static_cast<uint64_t>(current_size.QuadPart) > size)
+            {
+                return true;
+            }
+            FILE_ALLOCATION_INFO info{};
+            info.AllocationSize.QuadPart = static_cast<LONGLONG>(size);
+            if (!SetFileInformationByHandle(handle, FileAllocationInfo, &info, sizeof(info)))
+            {
+                DWORD error = GetLastError();
+                return error != ERROR_DISK_FULL && error != ERROR_HANDLE_DISK_FULL;
+            }
+            return true;
+#elif defined(__linux__)
+            int ret = 0;
+            do
+            {
+                ret = ::fallocate(fd, FALLOC_FL_KEEP_SIZE, static_cast<off_t>(offset), static_cast<off_t>(size));
+            } while (ret != 0 && errno == EINTR);
+            return ret == 0 || errno != ENOSPC;
+#else
+            (void)offset;
+            return true;
+#endif
+        }
+
+        // 设置文件长度，延长的部分为空洞
+        bool resize(uint64_t size)
+        {
+#ifdef _WIN32
+            FILE_END_OF_FILE_INFO info{};
+            info.EndOfFile.QuadPart = static_cast<LONGLONG>(size);
+            return SetFileInformationByHandle(handle, FileEndOfFileInfo, &info, sizeof(info)) != 0;
+#else
+            int ret = 0;
+            do
+            {
+                ret = ::ftruncate(fd, static_cast<off_t>(size));
+            } while (ret != 0 && errno == EINTR);
+            return ret == 0;
+#endif
+        }
+
+        // 把[offset, offset + size)变为空洞，读取为零且不占用磁盘，不改变文件长度
+        // Windows上先把文件标记为稀疏，之后resize延长的部分同样不占用空间，因此应在resize之前调用
+        void punchHole(uint64_t offset, uint64_t size)
+        {
+            if (size == 0)
+            {
+                return;
+            }
+#ifdef _WIN32
+            DWORD bytes = 0;
+            DeviceIoControl(handle, FSCTL_SET_SPARSE, nullptr, 0, nullptr, 0, &bytes, nullptr);
+            FILE_ZERO_DATA_INFORMATION info{};
+            info.FileOffset.QuadPart = static_cast<LONGLONG>(offset);
+            info.BeyondFinalZero.QuadPart = static_cast<LONGLONG>(offset + size);
+            DeviceIoControl(handle, FSCTL_SET_ZERO_DATA, &info, sizeof(info), nullptr, 0, &bytes, nullptr);
+#elif defined(__linux__)
+            ::fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, static_cast<off_t>(offset), static_cast<off_t>(size));
+#else
+            (void)offset;
+#endif
+        }
+
+        // 发起[offset, offset + size)脏页的回写，不等待完成
+        void startWriteback(uint64_t offset, uint64_t size)
+        {
+#ifdef __linux__
+            ::sync_file_range(fd, static_cast<off_t>(offset), static_cast<off_t>(size), SYNC_FILE_RANGE_WRITE);
+#else
+            (void)offset;
+            (void)size;
+#endif
+        }
+
+        // 等待[offset, offset + size)回写完成，尚未发起回写的脏页一并写出
+        void waitWriteback(uint64_t offset, uint64_t size)
+        {
+#ifdef __linux__
+            ::sync_file_range(fd, static_cast<off_t>(offset), static_cast<off_t>(size),
+                              SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+#else
+            (void)offset;
+            (void)size;
+#endif
+        }
+
+        // 从页缓存中丢弃[offset, offset + size)，尚未写回的脏页不受影响
+        void adviseDontNeed(uint64_t offset, uint64_t size)
+        {
+#ifdef POSIX_FADV_DONTNEED
+            ::posix_fadvise(fd, static_cast<off_t>(offset), static_cast<off_t>(size), POSIX_FADV_DONTNEED);
+#else
+            (void)offset;
+            (void)size;
+#endif
+        }
+
+        bool writeAt(uint64_t offset, const uint8_t *data, size_t size)
+        {
+#ifdef _WIN32
+            while (size > 0)
+            {
+                OVERLAPPED ov{};
+                ov.Offset = static_cast<DWORD>(offset & 0xFFFFFFFF);
+                ov.OffsetHigh = static_cast<DWORD>(offset >> 32);
+                DWORD written = 0;
+                if (!WriteFile(handle, data, static_cast<DWORD>(size), &written, &ov) || written == 0)
+                {
+                    return false;
+                }
+                offset += written;
+                data += written;
+                size -= written;
+            }
+#else
+            while (size > 0)
+            {
+                ssize_t written = ::pwrite(fd, data, size, static_cast<off_t>(offset));
+                if (written < 0)
+                {
+                    if (errno == EINTR)
+                    {
+                        continue;
+                    }
+                    return false;
+                }
+                offset += written;
+                data += written;
+                size -= written;
+            }
+#endif
+            return true;
+        }
+
+#ifdef __linux__
+        // 把首尾相接的多段数据一次写入文件offset处，iov会被修改
+        bool writeAt(uint64_t offset, struct iovec *iov, int count)
+        {
+            while (count > 0)
+            {
+                ssize_t written = ::pwritev(fd, iov, count, static_cast<off_t>(offset));
+                if (written <= 0)
+                {
+                    if (written < 0 && errno == EINTR)
+                    {
+                        continue;
+                    }
+                    return false;
+                }
+                offset += written;
+                // 跳过已写完的段，部分写入的段从剩余处继续
+                while (count > 0 && static_cast<size_t>(written) >= iov->iov_len)
+                {
+                    written -= iov->iov_len;
+                    ++iov;
+                    --count;
+                }
+                if (count > 0)
+                {
+                    iov->iov_base = static_cast<uint8_t *>(iov->iov_base) + written;
+                    iov->iov_len -= written;
+                }
+            }
+            return true;
+        }
+
+        // 通过管道把socket中的size字节直接搬运到文件offset处，数据不经过用户态
+        bool spliceFrom(int socket_fd, uint64_t offset, size_t size)
+        {
+            // 每个接收线程复用一个管道
+            thread_local SplicePipe pipe;
+            if (!pipe.isOpen())
+            {
+                return false;
+            }
+            loff_t file_offset = static_cast<loff_t>(offset);
+            while (size > 0)
+            {
+                ssize_t moved = ::splice(socket_fd, nullptr, pipe.fds[1], nullptr, size,
+                                         SPLICE_F_MOVE | SPLICE_F_MORE | SPLICE_F_NONBLOCK);
+                if (moved == 0)
+                {
+                    return false; // 对端关闭
+                }
+                if (moved < 0)
+                {
+                    if (errno == EINTR)
+                    {
+                        continue;
+                    }
+                    if (errno == EAGAIN)
+                    {
+                        pollfd pfd{socket_fd, POLLIN, 0};
+                        if (::poll(&pfd, 1, 1000) < 0 && errno != EINTR)
+                        {
+                            return false;
+                        }
+                        continue;
+                    }
+                    return false;
+                }
+                size -= moved;
+                while (moved > 0)
+                {
+                    ssize_t written = ::splice(pipe.fds[0], nullptr, fd, &file_offset, moved,
+                                               SPLICE_F_MOVE | SPLICE_F_MORE);
+                    if (written <= 0)
+                    {
+                        if (written < 0 && errno == EINTR)
+                        {
+                            continue;
+                        }
+                        // 管道中残留数据，丢弃该管道
+                        pipe.reset();
+                        return false;
+                    }
+                    moved -= written;
+                }
+            }
+            return true;
+        }
+#endif
+
+    private:
+#ifdef __linux__
+        struct SplicePipe
+        {
+            int fds[2]{-1, -1};
+            SplicePipe() { open(); }
+            ~SplicePipe() { close(); }
+            bool isOpen() const { return fds[0] >= 0; }
+            void open()
+            {
+                if (::pipe2(fds, O_CLOEXEC) != 0)
+                {
+                    fds[0] = fds[1] = -1;
+                }
+            }
+            void close()
+            {
+                if (fds[0] >= 0)
+                {
+                    ::close(fds[0]);
+                    ::close(fds[1]);
+                    fds[0] = fds[1] = -1;
+                }
+            }
+            void reset()
+            {
+                close();
+                open();
+            }
+        };
+#endif
+#ifdef _WIN32
+        HANDLE handle{INVALID_HANDLE_VALUE};
+#else
+        int fd{-1};
+#endif
+    };
+
+    // 跨平台的定位读文件，配合预读提示使用
+    class PositionalReader
+    {
+    public:
+        explicit PositionalReader(const std::wstring &wpath)
+        {
+#ifdef _WIN32
+            handle = CreateFileW(wpath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                                 OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+#else
+            fd = ::open(wstringToLocalPath(wpath).c_str(), O_RDONLY);
+#endif
+        }
+        ~PositionalReader()
+        {
+#ifdef _WIN32
+            if (handle != INVALID_HANDLE_VALUE)
+            {
+                CloseHandle(handle);
+            }
+#else
+            if (fd >= 0)
+            {
+                ::close(fd);
+            }
+#endif
+        }
+        PositionalReader(const PositionalReader &) = delete;
+        PositionalReader &operator=(const PositionalReader &) = delete;
+
+        bool isOpen() const
+        {
+#ifdef _WIN32
+            return handle != INVALID_HANDLE_VALUE;
+#else
+            return fd >= 0;
+#endif
+        }
+
+        // 返回实际读取的字节数，只有到达文件末尾或出错时才少于size
+        size_t readAt(uint64_t offset, uint8_t *data, size_t size)
+        {
+            size_t total = 0;
+#ifdef _WIN32
+            while (total < size)
+            {
+                OVERLAPPED ov{};
+                ov.Offset = static_cast<DWORD>(offset & 0xFFFFFFFF);
+                ov.OffsetHigh = static_cast<DWORD>(offset >> 32);
+                DWORD read = 0;
+                if (!ReadFile(handle, data + total, static_cast<DWORD>(size - total), &read, &ov) || read == 0)
+                {
+                    break;
+                }
+                offset += read;
+                total += read;
+            }
+#else
+            while (total < size)
+            {
+                ssize_t read = ::pread(fd, data + total, size - total, static_cast<off_t>(offset));
+                if (read < 0)
+                {
+                    if (errno == EINTR)
+                    {
+                        continue;
+                    }
+                    break;
+                }
+                if (read == 0)
+                {
+                    break;
+                }
+                offset += read;
+                total += read;
+            }
+#endif
+            return total;
+        }
+
+        // 查询文件中的空洞，返回按偏移排序的(offset, length)；空洞向内对齐到alignment，对齐后短于min_length的忽略
+        // 延伸到文件末尾的空洞末端不对齐；文件系统不支持查询时返回空，整个文件按数据处理
+        std::vector<std::pair<uint64_t, uint64_t>> findHoles(uint64_t file_size, uint64_t alignment, uint64_t min_length)
+        {
+            std::vector<std::pair<uint64_t, uint64_t>> holes;
+            auto add_hole = [&](uint64_t begin, uint64_t end)
+            {
+                begin = (begin + alignment - 1) / alignment * alignment;
+                if (end < file_size)
+                {
+                    end -= end % alignment;
+                }
+                if (end > begin && end - begin >= min_length)
+                {
+                    holes.emplace_back(begin, end - begin);
+                }
+            };
+            uint64_t position = 0;
+#ifdef _WIN32
+            // 已分配的区间之外都是空洞，返回的区间较多时分批查询
+            FILE_ALLOCATED_RANGE_BUFFER ranges[64];
+            while (position < file_size)
+            {
+                FILE_ALLOCATED_RANGE_BUFFER query{};
+                query.FileOffset.QuadPart = static_cast<LONGLONG>(position);
+                query.Length.QuadPart = static_cast<LONGLONG>(file_size - position);
+                DWORD bytes = 0;
+                BOOL is_complete = DeviceIoControl(handle, FSCTL_QUERY_ALLOCATED_RANGES, &query, sizeof(query),
+                                                   ranges, sizeof(ranges), &bytes, nullptr);
+                if (!is_complete && GetLastError() != ERROR_MORE_DATA)
+                {
+                    return {};
+                }
+                DWORD count = bytes / sizeof(ranges[0]);
+                for (DWORD i = 0; i < count; ++i)
+                {
+                    uint64_t data_begin = static_cast<uint64_t>(ranges[i].FileOffset.QuadPart);
+                    add_hole(position, data_begin);
+                    position = data_begin + static_cast<uint64_t>(ranges[i].Length.QuadPart);
+                }
+                if (is_complete || count == 0)
+                {
+                    add_hole(position, file_size);
+                    break;
+                }
+            }
+#elif defined(SEEK_DATA) && defined(SEEK_HOLE)
+            while (position < file_size)
+            {
+                off_t data_begin = ::lseek(fd, static_cast<off_t>(position), SEEK_DATA);
+                if (data_begin < 0)
+                {
+                    if (errno != ENXIO)
+                    {
+                        return {};
+                    }
+                    // 之后没有数据
+                    add_hole(position, file_size);
+                    break;
+                }
+                add_hole(position, static_cast<uint64_t>(data_begin));
+                off_t hole_begin = ::lseek(fd, data_begin, SEEK_HOLE);
+                if (hole_begin < 0)
+                {
+                    return {};
+                }
+                position = static_cast<uint64_t>(hole_begin);
+            }
+#else
+            (void)add_hole;
+            (void)position;
+#endif
+            return holes;
+        }
+
+#ifndef _WIN32
+        // 供sendfile等零拷贝接口使用
+        int nativeHandle() const
+        {
+            return fd;
+        }
+#endif
+
+        // 提示内核[offset, offset + length)将被顺序读取，length为0表示到文件末尾
+        void adviseSequential(uint64_t offset, uint64_t length)
+        {
+#ifdef POSIX_FADV_SEQUENTIAL
+            ::posix_fadvise(fd, static_cast<off_t>(offset), static_cast<off_t>(length), POSIX_FADV_SEQUENTIAL);
+#else
+            (void)offset;
+            (void)length;
+#endif
+        }
+
+        // 已读完的[offset, offset + length)不再需要，从页缓存中丢弃
+        void adviseDontNeed(uint64_t offset, uint64_t length)
+        {
+#ifdef POSIX_FADV_DONTNEED
+            ::posix_fadvise(fd, static_cast<off_t>(offset), static_cast<off_t>(length), POSIX_FADV_DONTNEED);
+#else
+            (void)offset;
+            (void)length;
+#endif
+        }
+
+        // 提示内核提前把[offset, offset + length)读入页缓存
+        void adviseWillNeed(uint64_t offset, uint64_t length)
+        {
+#ifdef POSIX_FADV_WILLNEED
+            ::posix_fadvise(fd, static_cast<off_t>(offset), static_cast<off_t>(length), POSIX_FADV_WILLNEED);
+#else
+            (void)offset;
+            (void)length;
+#endif
+        }
+
+    private:
+#ifdef _WIN32
+        HANDLE handle{INVALID_HANDLE_VALUE};
+#else
+        int fd{-1};
+#endif
+    };
+
+    // 跨平台的只读内存映射，按窗口映射文件，窗口前移时解除之前的映射，地址空间占用不超过一个窗口
+    class MappedReader
+    {
+    public:
+        MappedReader(const std::wstring &wpath, uint64_t window_size) : window_size(window_size)
+        {
+#ifdef _WIN32
+            file_handle = CreateFileW(wpath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                                      OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+            LARGE_INTEGER size{};
+            if (file_handle == INVALID_HANDLE_VALUE || !GetFileSizeEx(file_handle, &size) || size.QuadPart == 0)
+            {
+                return;
+            }
+            file_size = static_cast<uint64_t>(size.QuadPart);
+            mapping_handle = CreateFileMappingW(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+#else
+            fd = ::open(wstringToLocalPath(wpath).c_str(), O_RDONLY);
+            struct stat st{};
+            if (fd >= 0 && ::fstat(fd, &st) == 0)
+            {
+                file_size = static_cast<uint64_t>(st.st_size);
+            }
+#endif
+        }
+        ~MappedReader()
+        {
+            unmap();
+#ifdef _WIN32
+            if (mapping_handle)
+            {
+                CloseHandle(mapping_handle);
+            }
+            if (file_handle != INVALID_HANDLE_VALUE)
+            {
+                CloseHandle(file_handle);
+            }
+#else
+            if (fd >= 0)
+            {
+                ::close(fd);
+            }
+#endif
+        }
+        MappedReader(const MappedReader &) = delete;
+        MappedReader &operator=(const MappedReader &) = delete;
+
+        bool isOpen() const
+        {
+#ifdef _WIN32
+            return mapping_handle != nullptr;
+#else
+            return fd >= 0 && file_size > 0;
+#endif
+        }
+
+        uint64_t size() const
+        {
+            return file_size;
+        }
+
+        // 返回[offset, offset + size)的只读视图，超出文件末尾的部分被截掉；窗口移动后之前的视图失效
+        const uint8_t *view(uint64_t offset, size_t &size)
+        {
+            if (offset >= file_size)
+            {
+                size = 0;
+                return nullptr;
+            }
+            size = static_cast<size_t>((std::min)(static_cast<uint64_t>(size), file_size - offset));
+            if (!window_data || offset < window_offset || offset + size > window_offset + window_length)
+            {
+                if (!map(offset, size))
+                {
+                    size = 0;
+                    return nullptr;
+                }
+            }
+            return window_data + (offset - window_offset);
+        }
+
+        // 与PositionalReader::readAt语义相同，从映射中拷贝
+        size_t readAt(uint64_t offset, uint8_t *data, size_t size)
+        {
+            const uint8_t *src = view(offset, size);
+            if (src)
+            {
+                memcpy(data, src, size);
+            }
+            return size;
+        }
+
+    private:
+        bool map(uint64_t offset, size_t size)
+        {
+            unmap();
+            // 按系统分配粒度对齐（Windows为64KB，同时是页大小的整数倍）
+            constexpr uint64_t granularity = 64 * 1024;
+            uint64_t begin = offset - offset % granularity;
+            uint64_t length = (std::min)((std::max)(window_size, offset + size - begin), file_size - begin);
+#ifdef _WIN32
+            void *data = MapViewOfFile(mapping_handle, FILE_MAP_READ, static_cast<DWORD>(begin >> 32),
+                                       static_cast<DWORD>(begin & 0xFFFFFFFF), static_cast<SIZE_T>(length));
+            if (!data)
+            {
+                return false;
+            }
+#else
+            void *data = ::mmap(nullptr, static_cast<size_t>(length), PROT_READ, MAP_SHARED, fd, static_cast<off_t>(begin));
+            if (data == MAP_FAILED)
+            {
+                return false;
+            }
+            ::madvise(data, static_cast<size_t>(length), MADV_SEQUENTIAL);
+#endif
+            window_data = static_cast<const uint8_t *>(data);
+            window_offset = begin;
+            window_length = length;
+            return true;
+        }
+
+        void unmap()
+        {
+            if (!window_data)
+            {
+                return;
+            }
+#ifdef _WIN32
+            UnmapViewOfFile(window_data);
+#else
+            ::munmap(const_cast<uint8_t *>(window_data), static_cast<size_t>(window_length));
+#endif
+            window_data = nullptr;
+        }
+
+    private:
+        uint64_t window_size;
+        uint64_t file_size{0};
+        const uint8_t *window_data{nullptr};
+        uint64_t window_offset{0};
+        uint64_t window_length{0};
+#ifdef _WIN32
+        HANDLE file_handle{INVALID_HANDLE_VALUE};
+        HANDLE mapping_handle{nullptr};
+#else
+        int fd{-1};
+#endif
+    };
 }
 
 #endif // FILESTREAMHELPER_H
\ No newline at end of file
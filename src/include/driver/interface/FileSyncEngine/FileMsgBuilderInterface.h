@@ -4,6 +4,10 @@
 #include <memory>
 #include <vector>
 #include <string>
+#include "driver/interface/FileStreamHelper.h"
+
+class DirectoryWork;
+class DeltaSignature;
 
 class FileMsgBuilderInterface
 {
@@ -13,13 +17,42 @@ public:
         bool is_binary;
         uint8_t progress;
         std::unique_ptr<std::vector<uint8_t>> data;
+        // 零拷贝模式下data只有块前缀，载荷为source中[source_offset, source_offset + source_length)
+        FileStreamHelper::PositionalReader *source{nullptr};
+        uint64_t source_offset{0};
+        uint32_t source_length{0};
     };
-    virtual void setFileInfo(uint32_t id, const std::string& path) { file_id = id; file_path = path; is_initialized = true; }
+    virtual void setFileInfo(uint32_t id, const std::string& path) { file_id = id; file_path = path; is_initialized = true; is_stripe = false; is_stripe_root = false; is_chunk_manifest = false; dir_work.reset(); delta_signature.reset(); }
+    // 只发送文件的[offset, offset + length)范围，需在setFileInfo之后调用；with_root表示Merkle根随后由buildStripeRoot发送
+    virtual void setStripeInfo(uint64_t offset, uint64_t length, bool with_root = false) { stripe_offset = offset; stripe_length = length; is_stripe = true; is_stripe_root = with_root; }
+    // 只发送文件的分块清单，需在setFileInfo之后调用
+    virtual void setChunkManifest() { is_chunk_manifest = true; }
+    // 本次实际发送的是分块清单，无法分块而改为发送整个文件时为false
+    virtual bool isChunkManifest() const { return is_chunk_manifest; }
+    // 文件夹只发送从共享工作队列领取到的部分，需在setFileInfo之后调用
+    virtual void setDirectoryWork(std::shared_ptr<DirectoryWork> work) { dir_work = std::move(work); }
+    // 只发送相对接收端旧版本的差异，需在setFileInfo之后调用
+    virtual void setDeltaSignature(std::shared_ptr<const DeltaSignature> signature) { delta_signature = std::move(signature); }
+    // 文件块不读入内存，由发送端直接从文件发出载荷
+    virtual void setZeroCopy(bool enable) { zero_copy = enable; }
+    // 之后开始的文件使用的块大小，需为2的幂
+    virtual void setBlockSize(uint32_t size) { preferred_block_size = size; }
     virtual FileMsgBuilderResult getStream() = 0;
+    // 整个文件拆成条带时，最后完成的条带之后发送的file_root消息
+    virtual std::unique_ptr<std::vector<uint8_t>> buildStripeRoot(const std::string& merkle_root, const std::string& merkle_spans) = 0;
 protected:
     uint32_t file_id;
     std::string file_path;
     bool is_initialized{ false };
+    bool is_stripe{ false };
+    bool is_stripe_root{ false };
+    bool is_chunk_manifest{ false };
+    uint64_t stripe_offset{ 0 };
+    uint64_t stripe_length{ 0 };
+    std::shared_ptr<DirectoryWork> dir_work;
+    std::shared_ptr<const DeltaSignature> delta_signature;
+    bool zero_copy{ false };
+    uint32_t preferred_block_size{ 128 * 1024 };
 };
 
 #endif
\ No newline at end of file
@@ -4,11 +4,15 @@
 #include <vector>
 #include <stdint.h>
 #include "driver/interface/NetworkInterface.h"
+#include "driver/interface/PlatformSocket.h"
 
 class FileParserInterface
 {
 public:
+    virtual ~FileParserInterface() = default;
     virtual void parse(std::unique_ptr<NetworkInterface::UserMsg> msg) = 0;
+    // 直接从socket读取一个明文文件块的payload_length字节并落盘，返回false表示连接不可用
+    virtual bool receiveBinary(UnifiedSocket socket, uint32_t payload_length) = 0;
 };
 
 #endif
\ No newline at end of file
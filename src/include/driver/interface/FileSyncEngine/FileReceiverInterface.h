@@ -16,12 +16,15 @@ public:
     virtual void start(std::function<void(UnifiedSocket)> accept_cb,
                        std::function<void(UnifiedSocket socket, std::unique_ptr<NetworkInterface::UserMsg>)> msg_cb) = 0;
     virtual void stop() = 0;
+    // 在start之前设置，明文文件块将交给该回调直接从socket读取
+    virtual void setBinaryPayloadSink(std::function<bool(UnifiedSocket socket, uint32_t payload_length)> sink) { binary_payload_sink = std::move(sink); }
 
 protected:
     std::shared_ptr<SecurityInterface> security_instance;
     std::string address;
     std::string port;
     bool running{false};
+    std::function<bool(UnifiedSocket socket, uint32_t payload_length)> binary_payload_sink;
 };
 
 #endif
\ No newline at end of file
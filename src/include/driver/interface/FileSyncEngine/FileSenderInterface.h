@@ -3,8 +3,10 @@
 
 #include <string>
 #include "driver/interface/SecurityInterface.h"
+#include "driver/interface/CompressionInterface.h"
 #include "driver/impl/OuterMsgBuilder.h"
-#include <condition_variable>
+#include "driver/impl/FileSyncEngine/RateLimiter.h"
+#include "driver/interface/FileSyncEngine/FileSyncEngineInterface.h"
 #include <utility>
 #include <functional>
 #include <optional>
@@ -17,20 +19,22 @@ public:
     }
     virtual ~FileSenderInterface() = default;
     virtual bool initialize() = 0;
-    virtual void start(std::function<std::optional<std::pair<uint32_t, std::string>>()> get_task_cb) = 0;
+    virtual void start(std::function<std::optional<FileSyncEngineInterface::SendTask>()> get_task_cb) = 0;
     virtual void stop() = 0;
-    virtual void setCondition(std::shared_ptr<std::condition_variable> queue_cv) { cv = queue_cv; }
-    virtual void setCheckQueue(std::function<bool()> check_cb) { check_queue_cb = check_cb; }
+    // 设置后内存中的文件块先压缩再发送，零拷贝发送的块不经过压缩，需在initialize之前调用
+    virtual void setCompression(std::shared_ptr<CompressionInterface> instance) { compression_instance = instance; }
+    // 设置后每个块发送前先向限速器申请
+    virtual void setRateLimiter(std::shared_ptr<RateLimiter> limiter) { rate_limiter = limiter; }
 protected:
     static OuterMsgBuilderInterface& getOuterMsgBuilder() {
         static OuterMsgBuilder instance;
         return instance;
     }
     std::shared_ptr<SecurityInterface> security_instance;
+    std::shared_ptr<CompressionInterface> compression_instance;
+    std::shared_ptr<RateLimiter> rate_limiter;
     std::string address;
     std::string port;
-    std::shared_ptr<std::condition_variable> cv;
-    std::function<bool()> check_queue_cb;
     bool running{ false };
 };
 
@@ -8,17 +8,97 @@
     "id": "file_123456",
     "total_size": 10485760,
     "total_blocks": 100,
-    "block_size": 104857
+    "block_size": 104857,
+    "merkle_leaf_size": "1048576"
   }
 }
 
-文件夹结构头部
+文件传输结束（带整个文件的Merkle根，接收端校验后才改回正式文件名；大文件的根随最后一条file_chunks发送）
+merkle_spans为各段子树根的前缀依次拼接，校验失败时接收端据此只重新请求不一致的段
+{
+  "type": "file_end",
+  "content": {
+    "merkle_root": "3b1f5e...",
+    "merkle_spans": "9f86d081884c7d65..."
+  }
+}
+
+文件夹结构头部（文件夹拆成part_count个部分由多个连接并行发送，每个部分以该头部开始、file_end结束）
 {
   "type": "dir_header",
   "content": {
     "id": "folder_789012",
-    "leaf_paths": "[\"/project/src/main/java\",\"/project/src/test/java\"]",
-    "total_paths": "4"
+    "total_paths": "4",
+    "total_size": "10485760",
+    "part_count": "4"
+  }
+}
+
+文件夹叶子目录（分多条发送，与目录项交替，接收端边收边建目录）
+{
+  "type": "dir_paths",
+  "content": {
+    "id": "folder_789012",
+    "paths": ["/project/src/main/java", "/project/src/test/java"]
+  }
+}
+
+文件条带头部（大文件拆分为多个条带，由所有发送连接并行发送；整个文件拆成条带时带merkle_leaf_size，根随后单独发送）
+{
+  "type": "file_stripe",
+  "content": {
+    "id": "file_123456",
+    "total_size": 10485760,
+    "offset": 0,
+    "size": 16777216,
+    "block_size": 1048576,
+    "merkle_leaf_size": "1048576"
+  }
+}
+
+条带文件的Merkle根（由最后发完条带的连接发送，与其他连接上的数据先后不定；计算失败时根为空，接收端不再等待）
+{
+  "type": "file_root",
+  "content": {
+    "id": "file_123456",
+    "merkle_root": "3b1f5e...",
+    "merkle_spans": "9f86d081884c7d65..."
+  }
+}
+
+文件分块清单（接收端临时目录中有可复用的块时以dedup_file请求，大文件边分块边发送块的哈希，
+接收端用已有的块拼出文件，再按续传请求缺失的区间）
+第一条带源文件的空洞 "offset-length,..."，空洞不分块，接收端直接留空并记为已接收
+接收端已有全部块时通过控制连接回复manifest_satisfied，发送端据此完成上传
+{
+  "type": "file_chunks",
+  "content": {
+    "id": "file_123456",
+    "total_size": "10485760",
+    "holes": "2097152-4194304",
+    "is_last": "1",
+    "merkle_root": "3b1f5e...",
+    "merkle_spans": "9f86d081884c7d65...",
+    "chunks": ["0 1048576 9f86d0...", "1048576 786432 60303a..."]
+  }
+}
+
+增量传输头部（接收端已有旧版本时按其块签名发送，随后是块索引为delta_block_index的指令帧）
+{
+  "type": "file_delta",
+  "content": {
+    "id": "file_123456",
+    "total_size": "10485760",
+    "block_size": "16384"
+  }
+}
+
+增量传输结束（带新文件的SHA256，接收端校验重建结果；其他传输的结束不带id，增量传输中收到说明其已被打断）
+{
+  "type": "file_end",
+  "content": {
+    "id": "file_123456",
+    "sha256": "9f86d0..."
   }
 }
 
@@ -42,16 +122,112 @@ struct FileBlock {
     uint8_t* data;        // 可变长度数据
 };
 
+小文件包（块索引为pack_block_index的文件块，一帧携带多个小目录项）
+uint32_t item_count;
+item_count个 { uint32_t path_size; uint32_t data_size; char path[path_size]; }
+各目录项内容按顺序拼接
+
 文件接收流程:
 accept连接-回调，有新连接-分配消息处理器上下文-接收消息-解析消息到结构体-回调-获取消息处理器上下文-处理*/
 
 #include <stdint.h>
+#include <cstring>
+#include <optional>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <string>
+#include <utility>
+#include <future>
+#include "driver/impl/FileSyncEngine/MerkleTree.h"
+
+class DirectoryWork;
+class DeltaSignature;
 
 class FileSyncEngineInterface
 {
 public:
+  // 每个文件块携带的数据长度，块索引 * 块大小 即为块在文件中的偏移
+  // 块大小由发送端按链路测量结果在[min_block_size, max_block_size]内为每次传输选择，随头部下发，file_block_size为初始值
   inline static const uint32_t file_block_size = 128 * 1024;
+  inline static const uint32_t min_block_size = 64 * 1024;
+  inline static const uint32_t max_block_size = 4 * 1024 * 1024;
+  // 文件块前缀长度（id + index + data_size）
+  inline static const uint32_t block_header_size = sizeof(uint32_t) * 3;
+  // 有多个发送连接时，不小于stripe_threshold的单文件与分块清单之后缺失的区间拆分为条带，分发到所有发送连接
+  inline static const uint64_t stripe_threshold = 64ULL * 1024 * 1024;
+  inline static const uint64_t stripe_size = 16ULL * 1024 * 1024; // 需为max_block_size的整数倍
+  // 发送端预读线程最多提前准备的文件块数，预读的总字节数不超过read_ahead_max_bytes
+  inline static const size_t read_ahead_depth = 8;
+  inline static const uint64_t read_ahead_max_bytes = 16ULL * 1024 * 1024;
+  // 不超过pack_item_max_size的目录项打包发送，每包内容不超过pack_max_size
+  inline static const uint64_t pack_item_max_size = 64 * 1024;
+  inline static const uint64_t pack_max_size = 1024 * 1024;
+  inline static const uint32_t pack_max_items = 4096;
+  inline static const uint32_t pack_block_index = 0xFFFFFFFF; // 块索引为该值表示小文件包
+  // 不小于该大小的文件通过内存映射读取，每次最多映射mmap_window_size
+  inline static const uint64_t mmap_min_size = 4ULL * 1024 * 1024;
+  inline static const uint64_t mmap_window_size = 32ULL * 1024 * 1024;
+  // 不小于drop_behind_min_size的文件在读写位置之后每drop_behind_window字节丢弃一次页缓存，
+  // 大文件传输不挤出其他程序的缓存，接收端同时提前回写脏页，避免结束时集中刷盘
+  inline static const uint64_t drop_behind_min_size = 64ULL * 1024 * 1024;
+  inline static const uint64_t drop_behind_window = 8ULL * 1024 * 1024;
+  // 每条dir_paths消息最多携带的目录数与路径总字节数
+  inline static const size_t dir_paths_max_items = 1024;
+  inline static const size_t dir_paths_max_bytes = 64 * 1024;
+  // 接收端请求分块清单时，不小于dedup_min_size的单文件先发送分块清单，块长在[chunk_min_size, chunk_max_size]内，平均chunk_avg_size（需为2的幂）
+  inline static const uint64_t dedup_min_size = 16ULL * 1024 * 1024;
+  inline static const uint32_t chunk_min_size = 256 * 1024;
+  inline static const uint32_t chunk_avg_size = 1024 * 1024;
+  inline static const uint32_t chunk_max_size = 4 * 1024 * 1024;
+  inline static const size_t chunk_batch_size = 2048; // 每条file_chunks消息携带的块数
+  // 分块清单同时宣告源文件的空洞，空洞按min_block_size对齐，不短于sparse_min_hole，接收端直接留空，不再传输
+  inline static const uint64_t sparse_min_hole = 1024 * 1024;
+  // 接收端已有不小于delta_min_size的旧版本时请求增量传输
+  inline static const uint64_t delta_min_size = 1024 * 1024;
+  inline static const uint32_t delta_block_index = 0xFFFFFFFE; // 块索引为该值表示增量指令帧
 public:
+  // 同一文件所有条带（或同一文件夹所有部分）共享的发送进度
+  struct StripeProgress {
+    uint64_t total_size{ 0 };
+    std::atomic<uint64_t> sent_size{ 0 };
+    std::atomic<uint32_t> remaining{ 0 };
+    // 多个发送线程汇总计算速度
+    std::mutex report_mutex;
+    uint64_t reported_size{ 0 };
+    std::chrono::steady_clock::time_point report_time{ std::chrono::steady_clock::now() };
+    // 整个文件拆成条带时在后台与发送并行计算的Merkle根，由最后完成的条带发出
+    std::atomic<bool> is_cancelled{ false };
+    std::shared_future<MerkleTree::FileRoot> merkle_root;
+
+    // 条带未发完就被丢弃（如停止传输）时提前结束计算，merkle_root析构时不必等读完整个文件
+    ~StripeProgress() { is_cancelled = true; }
+  };
+
+  struct SendTask {
+    uint32_t id{ 0 };
+    std::string path;
+    // 条带任务只发送[offset, offset + length)范围
+    bool is_stripe{ false };
+    // 只发送分块清单，数据随后按接收端的续传请求发送
+    bool is_chunk_manifest{ false };
+    uint64_t offset{ 0 };
+    uint64_t length{ 0 };
+    // 文件夹任务只发送从共享工作队列领取到的目录项
+    std::shared_ptr<DirectoryWork> dir_work;
+    // 增量任务按接收端旧版本的块签名只发送差异
+    std::shared_ptr<const DeltaSignature> delta_signature;
+    // 条带与文件夹部分任务汇总进度，最后完成的任务发布完成事件
+    std::shared_ptr<StripeProgress> stripe_progress;
+    // 调度用：预计发送的字节数
+    uint64_t size{ 0 };
+
+    SendTask() = default;
+    // 其余字段保持默认值，按需在构造后逐项赋值
+    SendTask(uint32_t id, std::string path) : id(id), path(std::move(path)) {}
+  };
+
   struct FileBlock {
     uint32_t id;           // 与头部id对应
     uint32_t index;        // 块索引 (0-based)
@@ -59,6 +235,37 @@ public:
     uint8_t* data;        // 可变长度数据
   };
 
+  // 写入块前缀，dst至少有block_header_size字节
+  static void writeBlockHeader(uint8_t* dst, const FileBlock& block)
+  {
+    memcpy(dst, &block.id, sizeof(block.id));
+    memcpy(dst + sizeof(uint32_t), &block.index, sizeof(block.index));
+    memcpy(dst + sizeof(uint32_t) * 2, &block.data_size, sizeof(block.data_size));
+  }
+
+  // 解析收到的文件块，data指向msg内部，长度不符时返回空
+  static std::optional<FileBlock> parseBlock(uint8_t* msg, size_t length)
+  {
+    if (length < block_header_size)
+    {
+      return std::nullopt;
+    }
+    FileBlock block;
+    memcpy(&block.id, msg, sizeof(block.id));
+    memcpy(&block.index, msg + sizeof(uint32_t), sizeof(block.index));
+    memcpy(&block.data_size, msg + sizeof(uint32_t) * 2, sizeof(block.data_size));
+    if (block.data_size != length - block_header_size)
+    {
+      return std::nullopt;
+    }
+    block.data = msg + block_header_size;
+    return block;
+  }
+
+  static uint64_t blockOffset(uint32_t index, uint32_t block_size)
+  {
+    return static_cast<uint64_t>(index) * block_size;
+  }
 };
 
 #endif
\ No newline at end of file
@@ -47,7 +47,12 @@ namespace Json
                 FileHeader,
                 DirectoryHeader,
                 DirectoryItemHeader,
-                FileEnd
+                FileEnd,
+                FileStripe,
+                DirectoryPaths,
+                FileChunks,
+                FileDelta,
+                FileRoot
             };
 
             constexpr const char* toString(Type type)
@@ -58,6 +63,11 @@ namespace Json
                 case DirectoryHeader: return "dir_header";
                 case DirectoryItemHeader: return "dir_item_header";
                 case FileEnd: return "file_end";
+                case FileStripe: return "file_stripe";
+                case DirectoryPaths: return "dir_paths";
+                case FileChunks: return "file_chunks";
+                case FileDelta: return "file_delta";
+                case FileRoot: return "file_root";
                 default: return "unknown";
                 }
             }
@@ -70,7 +80,11 @@ namespace Json
                 AddFiles,
                 RemoveFile,
                 DownloadFile,
-                FileExpired
+                FileExpired,
+                ResumeFile,
+                DeltaFile,
+                ManifestSatisfied,
+                DedupFile
             };
 
             constexpr const char* toString(Type type)
@@ -81,6 +95,10 @@ namespace Json
                 case RemoveFile: return "remove_files";
                 case DownloadFile: return "download_file";
                 case FileExpired: return "file_expired";
+                case ResumeFile: return "resume_file";
+                case DeltaFile: return "delta_file";
+                case ManifestSatisfied: return "manifest_satisfied";
+                case DedupFile: return "dedup_file";
                 default: return "unknown";
                 }
             }
@@ -152,6 +170,8 @@ namespace Json
         virtual std::string buildUserMsg(MessageType::User::Type type, std::map<std::string, std::string>&& args) = 0;
         virtual std::string buildSyncMsg(MessageType::Sync::Type type, std::vector<std::string>&& args, uint8_t stride) = 0;
         virtual std::string buildFileMsg(MessageType::File::Type type, std::map<std::string, std::string> args) = 0;
+        // 携带字符串列表的文件消息，列表直接写入json，不经过字符串中转
+        virtual std::string buildFileListMsg(MessageType::File::Type type, std::map<std::string, std::string> args, std::vector<std::string>&& items) = 0;
         virtual ~JsonBuilder() = default;
     };
     class JsonFactoryInterface
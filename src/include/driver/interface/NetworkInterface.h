@@ -58,11 +58,14 @@ public:
     };
     static const uint16_t magic = 0xABCD;
     static const uint8_t version = 0x01;
+    // 加密帧的载荷为AES-256-GCM格式（nonce + tag + 密文，Header作为附加认证数据），其余帧与version相同
+    static const uint8_t aead_version = 0x02;
 
     enum class Flag : uint8_t
     {
         IS_BINARY = 1 << 0,
-        IS_ENCRYPT = 1 << 1
+        IS_ENCRYPT = 1 << 1,
+        IS_COMPRESS = 1 << 2 // 载荷（解密后）为压缩数据
     };
 
     friend Flag operator|(Flag lhs, Flag rhs)
@@ -10,10 +10,22 @@
 
 class OuterMsgBuilderInterface
 {
+public:
+    // 分散存放的帧：head为Header及加密前缀，payload为（加密后的）载荷，依次发送即为完整的帧
+    struct Frame
+    {
+        std::vector<uint8_t> head;
+        std::vector<uint8_t> payload;
+    };
+
 public:
     virtual ~OuterMsgBuilderInterface() {};
     virtual std::unique_ptr<NetworkInterface::UserMsg> buildMsg(std::string payload, NetworkInterface::Flag flag) = 0;
     virtual std::unique_ptr<NetworkInterface::UserMsg> buildMsg(std::vector<uint8_t> payload, NetworkInterface::Flag flag) = 0;
+    // 载荷原地加密后移入帧，不再拷贝，供writev一类的分散发送使用；失败时返回空
+    virtual std::unique_ptr<Frame> buildFrame(std::vector<uint8_t> &&payload, NetworkInterface::Flag flag) = 0;
+    // 只构造8字节Header，载荷由调用方自行发送（如sendfile）
+    virtual std::vector<uint8_t> buildHeader(uint32_t payload_length, NetworkInterface::Flag flag) = 0;
     virtual void setSecurityInstance(std::shared_ptr<SecurityInterface> instance) { security_instance = instance; }
 private:
     virtual std::unique_ptr<NetworkInterface::UserMsg> build(std::vector<uint8_t> payload, NetworkInterface::Flag flag) = 0;
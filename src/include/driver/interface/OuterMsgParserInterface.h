@@ -11,12 +11,32 @@
 class OuterMsgParserInterface
 {
 public:
+    // 事件驱动接收时单个连接尚未拼完的帧
+    struct RecvState
+    {
+        uint8_t header[8]{};
+        uint32_t header_received{0};
+        std::vector<uint8_t> payload;
+        uint32_t payload_received{0};
+    };
+
     virtual void delegateRecv(UnifiedSocket client_socket,
                               std::function<void(std::unique_ptr<NetworkInterface::UserMsg> parsed_msg)> callback,
                               std::function<void()> dcc_cb,
                               std::function<void(const NetworkInterface::RecvError error)> dre_cb,
                               std::shared_ptr<SecurityInterface> security_instance,
                               bool &running) = 0;
+    // 非阻塞socket可读时调用，读取已到达的数据并回调其中完整的帧，读空或本次读取超过max_bytes后返回，
+    // 不完整的帧留在state中等下次可读；返回false表示连接已关闭或出错
+    virtual bool receiveAvailable(UnifiedSocket client_socket, RecvState &state,
+                                  const std::function<void(std::unique_ptr<NetworkInterface::UserMsg> parsed_msg)> &callback,
+                                  const std::shared_ptr<SecurityInterface> &security_instance,
+                                  size_t max_bytes) = 0;
+    // 未加密的二进制消息读完Header后交给该回调，由其直接从socket读取payload_length字节，返回false表示连接不可用
+    virtual void setBinaryPayloadSink(std::function<bool(UnifiedSocket socket, uint32_t payload_length)> sink) { binary_payload_sink = std::move(sink); }
+
+protected:
+    std::function<bool(UnifiedSocket socket, uint32_t payload_length)> binary_payload_sink;
 
 private:
     virtual std::unique_ptr<NetworkInterface::UserMsg> parse(std::vector<uint8_t> &&msg, const uint32_t length, const uint8_t flag) = 0;
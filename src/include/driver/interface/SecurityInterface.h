@@ -13,7 +13,14 @@ public:
     struct TlsInfo
     {
         std::shared_ptr<uint8_t[]> key;
+        // 交换密钥时协商，双方都支持时加密帧使用AES-256-GCM，否则沿用AES-256-CBC + SHA256
+        bool is_aead{false};
+        // 本端在密钥交换中是否为服务端，两端用同一密钥加密时据此区分GCM的nonce
+        bool is_server{false};
     };
+    // AES-256-GCM帧的载荷为 nonce + tag + 密文
+    inline static const size_t aead_nonce_size = 12;
+    inline static const size_t aead_tag_size = 16;
 
 public:
     virtual ~SecurityInterface() = default;
@@ -25,6 +32,12 @@ public:
                                   const std::vector<uint8_t> &iv,
                                   std::vector<uint8_t> &out_plaintext,
                                   std::vector<uint8_t> &sha256) = 0;
+    // AES-256-GCM单遍加密length字节到out（可与in相同），aad只认证不加密
+    virtual bool aeadSeal(const uint8_t *key, const uint8_t *nonce, const uint8_t *aad, size_t aad_length,
+                          const uint8_t *in, size_t length, uint8_t *out, uint8_t *tag) = 0;
+    // 解密并校验tag，失败时out中的内容不可用
+    virtual bool aeadOpen(const uint8_t *key, const uint8_t *nonce, const uint8_t *aad, size_t aad_length,
+                          const uint8_t *in, size_t length, uint8_t *out, const uint8_t *tag) = 0;
     virtual void dealTlsRequest(UnifiedSocket socket, std::function<void(bool, TlsInfo)> callback) = 0;
     const TlsInfo getTlsInfo() { return tls_info; }
     void setTlsInfo(const TlsInfo &info) { tls_info = info; }
@@ -5,7 +5,7 @@
 #include <QtCore/QList>
 #include <QtGui/QIcon>
 #include <QtCore/QDir>
-#include <QtCore/QDirIterator>
+#include "driver/impl/DirectoryWalker.h"
 #include <qDebug>
 #include "model/FileIconManager.h"
 #include "control/GlobalStatusManager.h"
@@ -63,8 +63,15 @@ public:
   Q_INVOKABLE void downloadFile(int index);
   Q_INVOKABLE void cleanTmpFiles();
   Q_INVOKABLE bool isTransferring();
+  // 上传限速，单位字节每秒，0表示不限速
+  Q_INVOKABLE void setUploadRateLimit(qint64 bytes_per_second);
+  Q_INVOKABLE void setFileUploadRateLimit(int index, qint64 bytes_per_second);
   void addRemoteFiles(std::vector<std::vector<std::string>> files);
   void haveDownLoadRequest(std::vector<std::string> file_ids);
+  // 对端临时目录中有可复用的块，大文件改为发送分块清单
+  void haveDedupRequest(std::vector<std::string> file_ids);
+  void haveResumeRequest(std::string file_id, std::string total_size, std::string ranges);
+  void haveDeltaRequest(std::string file_id, std::string basis_size, std::string block_size, std::string blocks);
 public slots:
   void onConnectionClosed();
 
@@ -76,6 +83,7 @@ private:
   void removeFileById(std::vector<std::string> id);
   void onUploadFileProgress(uint32_t id, uint8_t progress, uint32_t speed, bool is_end);
   void onDownLoadProgress(uint32_t id, uint8_t progress, uint32_t speed, bool is_end);
+  void onDownLoadFailed(uint32_t id);
   std::pair<int, FileInfo &> findFileInfoById(uint32_t id);
 
 private:
@@ -135,22 +143,10 @@ public:
     return file.size();
   }
 
-  // TODO
-  // 改为生产消费模型 ，防止大文件卡死
+  // 多线程遍历，结果会缓存一段时间，随后发送该文件夹时无需再次遍历
   static quint64 getFolderSize(const QString &folderPath)
   {
-    quint64 totalSize = 0;
-
-    // 递归遍历所有文件和目录
-    QDirIterator it(folderPath, QDir::Files | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
-
-    while (it.hasNext())
-    {
-      it.next();
-      totalSize += it.fileInfo().size();
-    }
-
-    return totalSize;
+    return DirectoryWalker::scan(folderPath.toStdString())->total_size;
   }
 
   static QString formatFileSize(quint64 bytes)
@@ -57,14 +57,34 @@ void initRegisterEvents()
     EventBusManager::instance().registerEvent("/file/close_FileSyncCore");
     // 发送获取文件请求
     EventBusManager::instance().registerEvent("/file/send_get_file");
+    // 通知对端分块清单中的块已全部复用，上传完成
+    EventBusManager::instance().registerEvent("/file/send_manifest_satisfied");
     // 收到下载请求
     EventBusManager::instance().registerEvent("/file/have_download_request");
     // 向发送队列添加任务
     EventBusManager::instance().registerEvent("/file/have_file_to_send");
+    // 收到分块清单请求
+    EventBusManager::instance().registerEvent("/file/have_dedup_request");
+    // 向发送队列添加分块清单任务
+    EventBusManager::instance().registerEvent("/file/have_file_chunks_to_send");
+    // 收到断点续传请求
+    EventBusManager::instance().registerEvent("/file/have_resume_request");
+    // 向发送队列添加续传区间
+    EventBusManager::instance().registerEvent("/file/have_file_ranges_to_send");
+    // 收到增量传输请求
+    EventBusManager::instance().registerEvent("/file/have_delta_request");
+    // 向发送队列添加增量任务
+    EventBusManager::instance().registerEvent("/file/have_file_delta_to_send");
+    // 设置上传总限速，参数为字节每秒，0表示不限速
+    EventBusManager::instance().registerEvent("/file/set_global_rate_limit");
+    // 设置单个文件的上传限速
+    EventBusManager::instance().registerEvent("/file/set_transfer_rate_limit");
     // 上传进度更新
     EventBusManager::instance().registerEvent("/file/upload_progress");
     // 下载进度更新
     EventBusManager::instance().registerEvent("/file/download_progress");
+    // 下载失败（如磁盘空间不足）
+    EventBusManager::instance().registerEvent("/file/download_failed");
 }
 
 int main(int argc, char *argv[])
@@ -4,10 +4,18 @@
 #include "driver/impl/FileSyncEngine/FileSender.h"
 #include "driver/impl/FileSyncEngine/FileReceiver.h"
 #include "driver/impl/FileSyncEngine/FileParser.h"
+#include "driver/impl/FileSyncEngine/DeltaSync.h"
+#include "driver/impl/FileSyncEngine/ChunkStore.h"
+#include "control/GlobalStatusManager.h"
 #include "control/EventBusManager.h"
+#include "driver/impl/FileUtility.h"
+#include "driver/impl/ZlibDriver.h"
 #include <iostream>
+#include <future>
+#include <algorithm>
 
-FileSyncEngine::FileSyncEngine()
+FileSyncEngine::FileSyncEngine() : scheduler(std::make_unique<TransferScheduler>(sender_num, scheduler_policy)),
+                                   rate_limiter(std::make_shared<RateLimiter>())
 {
     EventBusManager::instance().subscribe("/file/initialize_FileSyncCore", std::bind(
                                                                                &FileSyncEngine::start,
@@ -23,38 +31,265 @@ FileSyncEngine::FileSyncEngine()
                                                                          this,
                                                                          std::placeholders::_1,
                                                                          std::placeholders::_2));
+    EventBusManager::instance().subscribe("/file/have_file_chunks_to_send", std::bind(
+                                                                                &FileSyncEngine::onHaveFileChunksToSend,
+                                                                                this,
+                                                                                std::placeholders::_1,
+                                                                                std::placeholders::_2));
+    EventBusManager::instance().subscribe("/file/have_file_ranges_to_send", std::bind(
+                                                                                &FileSyncEngine::onHaveFileRangesToSend,
+                                                                                this,
+                                                                                std::placeholders::_1,
+                                                                                std::placeholders::_2,
+                                                                                std::placeholders::_3,
+                                                                                std::placeholders::_4));
+    EventBusManager::instance().subscribe("/file/have_file_delta_to_send", std::bind(
+                                                                               &FileSyncEngine::onHaveFileDeltaToSend,
+                                                                               this,
+                                                                               std::placeholders::_1,
+                                                                               std::placeholders::_2,
+                                                                               std::placeholders::_3,
+                                                                               std::placeholders::_4,
+                                                                               std::placeholders::_5));
+    EventBusManager::instance().subscribe("/file/set_global_rate_limit", std::bind(
+                                                                             &FileSyncEngine::onSetGlobalRateLimit,
+                                                                             this,
+                                                                             std::placeholders::_1));
+    EventBusManager::instance().subscribe("/file/set_transfer_rate_limit", std::bind(
+                                                                               &FileSyncEngine::onSetTransferRateLimit,
+                                                                               this,
+                                                                               std::placeholders::_1,
+                                                                               std::placeholders::_2));
+    EventBusManager::instance().subscribe("/file/download_progress", std::bind(
+                                                                         &FileSyncEngine::onDownloadProgress,
+                                                                         this,
+                                                                         std::placeholders::_1,
+                                                                         std::placeholders::_2,
+                                                                         std::placeholders::_3,
+                                                                         std::placeholders::_4));
+}
+
+void FileSyncEngine::onDownloadProgress(uint32_t id, uint8_t progress, uint32_t speed, bool is_end)
+{
+    if (!is_end)
+    {
+        return;
+    }
+    // 新收到的文件可能是之后分块清单的块来源
+    {
+        std::lock_guard<std::mutex> lock(index_mutex);
+        is_index_pending = true;
+    }
+    index_cv.notify_one();
+}
+
+void FileSyncEngine::indexLoop()
+{
+    std::wstring tmp_dir = FileSystemUtils::utf8ToWide(GlobalStatusManager::absolute_tmp_dir);
+    while (!is_index_stopped)
+    {
+        ChunkStore::buildIndexes(tmp_dir, is_index_stopped);
+        std::unique_lock<std::mutex> lock(index_mutex);
+        index_cv.wait(lock, [this]()
+                      { return is_index_pending || is_index_stopped; });
+        is_index_pending = false;
+    }
+}
+
+void FileSyncEngine::onSetGlobalRateLimit(uint64_t bytes_per_second)
+{
+    LOG_INFO("Upload rate limit: " << bytes_per_second << " B/s");
+    rate_limiter->setGlobalRate(bytes_per_second);
+}
+
+void FileSyncEngine::onSetTransferRateLimit(uint32_t id, uint64_t bytes_per_second)
+{
+    rate_limiter->setTransferRate(id, bytes_per_second);
 }
 
 void FileSyncEngine::onHaveFileToSend(uint32_t id, std::string path)
 {
-    std::lock_guard<std::mutex> lock(mtx);
-    pending_send_files.push({id, std::move(path)});
-    cv->notify_one();
+    if (file_senders.size() > 1 && FileSystemUtils::isDirectory(path))
+    {
+        enqueueDirectory(id, path);
+        return;
+    }
+
+    uint64_t file_size = FileSystemUtils::isDirectory(path) ? 0 : FileSystemUtils::getFileSize(path);
+    if (file_senders.size() > 1 && file_size >= FileSyncEngineInterface::stripe_threshold)
+    {
+        // 大文件拆分为条带由所有连接并行发送
+        enqueueStripes(id, path, file_size, {{0, file_size}}, true);
+        return;
+    }
+
+    FileSyncEngineInterface::SendTask task{id, std::move(path)};
+    task.size = file_size;
+    scheduler->submit(std::move(task));
+}
+
+void FileSyncEngine::onHaveFileChunksToSend(uint32_t id, std::string path)
+{
+    uint64_t file_size = FileSystemUtils::isDirectory(path) ? 0 : FileSystemUtils::getFileSize(path);
+    if (file_size < FileSyncEngineInterface::dedup_min_size)
+    {
+        onHaveFileToSend(id, std::move(path));
+        return;
+    }
+    // 大文件先发送分块清单，接收端复用临时目录中已有的块后按续传请求缺失的区间
+    FileSyncEngineInterface::SendTask task{id, std::move(path)};
+    task.is_chunk_manifest = true;
+    task.size = file_size;
+    scheduler->submit(std::move(task));
+}
+
+void FileSyncEngine::onHaveFileRangesToSend(uint32_t id, std::string path, uint64_t total_size, std::string ranges)
+{
+    auto missing_ranges = TransferJournal::rangesFromString(ranges);
+    uint64_t file_size = FileSystemUtils::getFileSize(path);
+    // 源文件大小已变化时续传无意义，重新发送整个文件
+    if (FileSystemUtils::isDirectory(path) || file_size != total_size || missing_ranges.empty())
+    {
+        onHaveFileToSend(id, std::move(path));
+        return;
+    }
+    enqueueStripes(id, path, file_size, missing_ranges);
 }
 
-std::optional<std::pair<uint32_t, std::string>> FileSyncEngine::getPendingFile()
+void FileSyncEngine::onHaveFileDeltaToSend(uint32_t id, std::string path, uint64_t basis_size, uint32_t block_size, std::string blocks)
 {
-    std::lock_guard<std::mutex> lock(mtx);
-    if (pending_send_files.empty())
+    auto signature = std::make_shared<DeltaSignature>();
+    signature->basis_size = basis_size;
+    signature->block_size = block_size;
+    // 签名无效时发送整个文件
+    if (FileSystemUtils::isDirectory(path) || !signature->blocksFromString(blocks))
     {
-        return std::nullopt;
+        onHaveFileToSend(id, std::move(path));
+        return;
     }
-    auto file = pending_send_files.front();
-    pending_send_files.pop();
-    return file;
+    FileSyncEngineInterface::SendTask task{id, std::move(path)};
+    // 实际发送量未知，按新文件大小排序
+    task.size = FileSystemUtils::getFileSize(task.path);
+    task.delta_signature = std::move(signature);
+    scheduler->submit(std::move(task));
+}
+
+void FileSyncEngine::enqueueStripes(uint32_t id, const std::string &path, uint64_t file_size,
+                                    const std::vector<TransferJournal::Range> &ranges, bool with_root)
+{
+    // 每个区间拆分为连续的条带，空闲的发送连接依次领取
+    std::vector<FileSyncEngineInterface::SendTask> tasks;
+    auto progress = std::make_shared<FileSyncEngineInterface::StripeProgress>();
+    progress->total_size = file_size;
+    progress->sent_size = file_size;
+
+    // 块索引要求条带起点按块对齐，按最小块大小对齐后发送端可自行选择块大小
+    // 对齐后相邻区间可能重叠，先合并再拆分，避免重复发送和重复计入进度
+    std::vector<TransferJournal::Range> aligned;
+    for (const auto &range : ranges)
+    {
+        uint64_t begin = range.offset - range.offset % FileSyncEngineInterface::min_block_size;
+        uint64_t end = (std::min)(range.offset + range.length, file_size);
+        if (begin < end)
+        {
+            aligned.push_back({begin, end - begin});
+        }
+    }
+    std::sort(aligned.begin(), aligned.end(),
+              [](const TransferJournal::Range &a, const TransferJournal::Range &b)
+              { return a.offset < b.offset; });
+    std::vector<TransferJournal::Range> merged;
+    for (const auto &range : aligned)
+    {
+        if (!merged.empty() && range.offset <= merged.back().offset + merged.back().length)
+        {
+            uint64_t end = (std::max)(merged.back().offset + merged.back().length, range.offset + range.length);
+            merged.back().length = end - merged.back().offset;
+        }
+        else
+        {
+            merged.push_back(range);
+        }
+    }
+
+    for (const auto &range : merged)
+    {
+        uint64_t begin = range.offset;
+        uint64_t end = range.offset + range.length;
+        progress->sent_size -= range.length;
+        for (uint64_t offset = begin; offset < end; offset += FileSyncEngineInterface::stripe_size)
+        {
+            FileSyncEngineInterface::SendTask task{id, path};
+            task.is_stripe = true;
+            task.offset = offset;
+            task.length = (std::min)(FileSyncEngineInterface::stripe_size, end - offset);
+            task.size = task.length;
+            task.stripe_progress = progress;
+            tasks.push_back(std::move(task));
+        }
+    }
+    if (tasks.empty())
+    {
+        onHaveFileToSend(id, path);
+        return;
+    }
+    progress->remaining = static_cast<uint32_t>(tasks.size());
+    if (with_root)
+    {
+        // 多线程读取计算，与条带发送并行
+        progress->merkle_root = std::async(std::launch::async, &MerkleTree::computeFile,
+                                           FileSystemUtils::utf8ToWide(path), &progress->is_cancelled)
+                                    .share();
+    }
+    scheduler->submit(std::move(tasks));
+}
+
+void FileSyncEngine::enqueueDirectory(uint32_t id, const std::string &path)
+{
+    // 每个发送连接一个部分，各部分从共享队列领取目录项
+    // 文件夹大小取自遍历清单，界面添加文件夹时通常已经遍历过
+    uint32_t part_count = static_cast<uint32_t>(file_senders.size());
+    auto work = std::make_shared<DirectoryWork>(path, part_count);
+    auto progress = std::make_shared<FileSyncEngineInterface::StripeProgress>();
+    progress->total_size = work->totalSize();
+    progress->remaining = part_count;
+
+    std::vector<FileSyncEngineInterface::SendTask> tasks;
+    for (uint32_t i = 0; i < part_count; ++i)
+    {
+        FileSyncEngineInterface::SendTask task{id, path};
+        task.dir_work = work;
+        task.stripe_progress = progress;
+        task.size = progress->total_size / part_count;
+        tasks.push_back(std::move(task));
+    }
+    scheduler->submit(std::move(tasks));
 }
 
 void FileSyncEngine::haveFileConnection(UnifiedSocket socket)
 {
+    std::lock_guard<std::mutex> lock(parser_mutex);
     if (file_parser_map.find(socket) == file_parser_map.end())
     {
-        file_parser_map[socket] = std::make_unique<FileParser>();
+        file_parser_map[socket] = std::make_unique<FileParser>(file_assembler, compression);
     }
 }
 
+FileParserInterface *FileSyncEngine::findParser(UnifiedSocket socket)
+{
+    // 各事件循环线程同时查找，监听所在的循环可能同时插入
+    std::lock_guard<std::mutex> lock(parser_mutex);
+    return file_parser_map[socket].get();
+}
+
 void FileSyncEngine::haveFileMsg(UnifiedSocket socket, std::unique_ptr<NetworkInterface::UserMsg> msg)
 {
-    file_parser_map[socket]->parse(std::move(msg));
+    findParser(socket)->parse(std::move(msg));
+}
+
+bool FileSyncEngine::haveFileBinary(UnifiedSocket socket, uint32_t payload_length)
+{
+    return findParser(socket)->receiveBinary(socket, payload_length);
 }
 
 void FileSyncEngine::start(std::string address, std::string recv_port,
@@ -62,37 +297,60 @@ void FileSyncEngine::start(std::string address, std::string recv_port,
 {
     LOG_INFO("FileSyncCore start");
 
+    // 上次stop时限速器被置为直接放行，调度器停止期间收到的任务在连接建立后开始发送
+    rate_limiter->resume();
+
+    is_index_stopped = false;
+    is_index_pending = false;
+    index_thread = std::thread(&FileSyncEngine::indexLoop, this);
+
     // 初始化receiver
     file_receiver = std::make_unique<FileReceiver>("0.0.0.0", recv_port, instance);
-    cv = std::make_shared<std::condition_variable>();
+    file_assembler = std::make_shared<FileAssembler>();
+    // 收发两端共用的压缩实现，发送端逐块判断是否值得压缩
+    compression = std::make_shared<ZlibDriver>();
 
+#ifdef __linux__
+    if (!instance)
+    {
+        // 明文通道下文件块直接从socket写入文件
+        file_receiver->setBinaryPayloadSink(std::bind(&FileSyncEngine::haveFileBinary, this, std::placeholders::_1, std::placeholders::_2));
+    }
+#endif
     if (file_receiver->initialize())
     {
         file_receiver->start(std::bind(&FileSyncEngine::haveFileConnection, this, std::placeholders::_1),
                              std::bind(&FileSyncEngine::haveFileMsg, this, std::placeholders::_1, std::placeholders::_2));
     }
 
-    // 初始化sender
-    std::vector<std::shared_ptr<FileSender>> initialized_senders;
+    // 初始化sender，各连接并行建立并等待初始信用，对端不支持流控时总共只等待一次超时
+    std::vector<std::shared_ptr<FileSender>> senders;
+    std::vector<std::future<bool>> initialize_results;
     for (int i = 0; i < sender_num; ++i)
     {
         auto sender = std::make_shared<FileSender>(address, recv_port, instance);
-        if (sender->initialize())
+        sender->setCompression(compression);
+        sender->setRateLimiter(rate_limiter);
+        initialize_results.push_back(std::async(std::launch::async, [sender]()
+                                                { return sender->initialize(); }));
+        senders.push_back(std::move(sender));
+    }
+    std::vector<std::shared_ptr<FileSender>> initialized_senders;
+    for (size_t i = 0; i < senders.size(); ++i)
+    {
+        if (initialize_results[i].get())
         {
-            sender->setCondition(this->cv);
-            sender->setCheckQueue([this]() -> bool
-                                  {
-                std::lock_guard<std::mutex> lock(mtx);
-                bool is_empty = pending_send_files.empty();
-                return !is_empty; });
-            initialized_senders.push_back(sender);
+            initialized_senders.push_back(senders[i]);
         }
     }
 
-    for (auto &sender : initialized_senders)
+    // 每个发送连接对应调度器中的一个队列，未能建立的连接的队列由其他连接窃取
+    scheduler->resume();
+    for (size_t i = 0; i < initialized_senders.size(); ++i)
     {
-        sender->start(std::bind(&FileSyncEngine::getPendingFile, this));
-        file_senders.push_back(sender);
+        initialized_senders[i]->start([this, i]()
+                                      { return scheduler->take(i); });
+        file_senders.push_back(initialized_senders[i]);
     }
     is_start = true;
 }
@@ -108,12 +366,27 @@ void FileSyncEngine::stop()
     {
         i->stop();
     }
-    cv->notify_all();
+    // 唤醒等待任务与等待限速的发送线程
+    scheduler->stop();
+    rate_limiter->interrupt();
     file_receiver->stop();
+    // 保存未完成文件的续传日志
+    file_assembler->close();
+    {
+        std::lock_guard<std::mutex> lock(index_mutex);
+        is_index_stopped = true;
+    }
+    index_cv.notify_one();
+    if (index_thread.joinable())
+    {
+        index_thread.join();
+    }
     // 销毁资源
     file_senders.clear();
     file_receiver.release();
-    cv.reset();
+    file_parser_map.clear();
+    file_assembler.reset();
+    compression.reset();
 }
 
 FileSyncEngine::~FileSyncEngine()
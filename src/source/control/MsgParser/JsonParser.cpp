@@ -14,6 +14,10 @@ JsonParser::JsonParser() : json_driver(std::make_unique<NlohmannJson>())
     type_funcfion_map[Json::MessageType::Sync::toString(Json::MessageType::Sync::AddFiles)] = std::bind(&JsonParser::syncAddFiles, this, std::placeholders::_1);
     type_funcfion_map[Json::MessageType::Sync::toString(Json::MessageType::Sync::RemoveFile)] = std::bind(&JsonParser::syncDeleteFiles, this, std::placeholders::_1);
     type_funcfion_map[Json::MessageType::Sync::toString(Json::MessageType::Sync::DownloadFile)] = std::bind(&JsonParser::downloadFile, this, std::placeholders::_1);
+    type_funcfion_map[Json::MessageType::Sync::toString(Json::MessageType::Sync::ResumeFile)] = std::bind(&JsonParser::resumeFile, this, std::placeholders::_1);
+    type_funcfion_map[Json::MessageType::Sync::toString(Json::MessageType::Sync::DeltaFile)] = std::bind(&JsonParser::deltaFile, this, std::placeholders::_1);
+    type_funcfion_map[Json::MessageType::Sync::toString(Json::MessageType::Sync::ManifestSatisfied)] = std::bind(&JsonParser::manifestSatisfied, this, std::placeholders::_1);
+    type_funcfion_map[Json::MessageType::Sync::toString(Json::MessageType::Sync::DedupFile)] = std::bind(&JsonParser::dedupFile, this, std::placeholders::_1);
 }
 
 void JsonParser::parse(std::unique_ptr<NetworkInterface::UserMsg> data)
@@ -144,4 +148,61 @@ void JsonParser::downloadFile(std::unique_ptr<Json::Parser> parser)
         files.insert(files.end(), tmp.begin(), tmp.end());
     }
     EventBusManager::instance().publish("/file/have_download_request", files);
-}
\ No newline at end of file
+}
+
+void JsonParser::dedupFile(std::unique_ptr<Json::Parser> parser)
+{
+    // 对端临时目录中有可复用的块，大文件先发送分块清单
+    std::vector<std::string> files;
+    auto file_ids = parser->getArray("files");
+    for (const auto &id : file_ids)
+    {
+        auto tmp = id->getArrayItems();
+        files.insert(files.end(), tmp.begin(), tmp.end());
+    }
+    EventBusManager::instance().publish("/file/have_dedup_request", files);
+}
+
+void JsonParser::resumeFile(std::unique_ptr<Json::Parser> parser)
+{
+    // 每组为 [id, total_size, ranges]
+    auto groups = parser->getArray("files");
+    for (auto &group : groups)
+    {
+        auto items = group->getArrayItems();
+        if (items.size() != 3)
+        {
+            continue;
+        }
+        EventBusManager::instance().publish("/file/have_resume_request", items[0], items[1], items[2]);
+    }
+}
+
+void JsonParser::deltaFile(std::unique_ptr<Json::Parser> parser)
+{
+    // 每组为 [id, basis_size, block_size, blocks]
+    auto groups = parser->getArray("files");
+    for (auto &group : groups)
+    {
+        auto items = group->getArrayItems();
+        if (items.size() != 4)
+        {
+            continue;
+        }
+        EventBusManager::instance().publish("/file/have_delta_request", items[0], items[1], items[2], items[3]);
+    }
+}
+
+void JsonParser::manifestSatisfied(std::unique_ptr<Json::Parser> parser)
+{
+    // 对端用已有的块拼出了整个文件，分块清单之后不会再有数据，上传到此完成
+    auto file_ids = parser->getArray("files");
+    for (const auto &id : file_ids)
+    {
+        for (const auto &item : id->getArrayItems())
+        {
+            EventBusManager::instance().publish("/file/upload_progress", static_cast<uint32_t>(std::stoul(item)),
+                                                static_cast<uint8_t>(100), static_cast<uint32_t>(0), true);
+        }
+    }
+}
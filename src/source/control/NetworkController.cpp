@@ -6,6 +6,10 @@
 #include "control/MsgParser/JsonParser.h"
 #include "control/MsgParser/BinaryParser.h"
 #include "control/GlobalStatusManager.h"
+#include "driver/impl/FileSyncEngine/TransferJournal.h"
+#include "driver/impl/FileSyncEngine/DeltaSync.h"
+#include "driver/impl/FileSyncEngine/ChunkStore.h"
+#include "driver/interface/FileSyncEngine/FileSyncEngineInterface.h"
 #include "common/DebugOutputer.h"
 
 void NetworkController::initSubscribe()
@@ -50,6 +54,10 @@ void NetworkController::initSubscribe()
                                           std::bind(&NetworkController::onSendGetFile,
                                                     this,
                                                     std::placeholders::_1));
+    EventBusManager::instance().subscribe("/file/send_manifest_satisfied",
+                                          std::bind(&NetworkController::onSendManifestSatisfied,
+                                                    this,
+                                                    std::placeholders::_1));
     // 设置错误处理回调函数
     control_msg_network_driver->setDealConnectErrorCb(std::bind(
         &NetworkController::onConnectError,
@@ -69,6 +77,7 @@ NetworkController::NetworkController() : control_msg_network_driver(std::make_un
                                          security_driver(std::make_shared<OpensslDriver>()),
                                          json_parser(std::make_unique<JsonParser>())
 {
+    signature_thread = std::thread(&NetworkController::signatureLoop, this);
     initSubscribe();
     // 设置安全实例驱动才会按照加密协议进行通信
     control_msg_network_driver->setSecurityInstance(security_driver);
@@ -82,6 +91,19 @@ NetworkController::NetworkController() : control_msg_network_driver(std::make_un
             return true; });
 }
 
+NetworkController::~NetworkController()
+{
+    {
+        std::lock_guard<std::mutex> lock(signature_mutex);
+        is_signature_stopped = true;
+    }
+    signature_cv.notify_one();
+    if (signature_thread.joinable())
+    {
+        signature_thread.join();
+    }
+}
+
 void NetworkController::onSendConnectRequest(std::string sender_device_name, std::string sender_device_ip, std::string target_device_ip)
 {
     control_msg_network_driver->initTlsSocket(target_device_ip, "7777");
@@ -247,8 +269,90 @@ void NetworkController::onSendSyncDeleteFile(uint32_t id)
 }
 
 void NetworkController::onSendGetFile(uint32_t id)
+{
+    auto sync_builder = json_builder->getBuilder(Json::BuilderType::Sync);
+
+    // 临时目录中有上次中断的续传日志时只请求缺失的区间
+    std::string tmp_path = GlobalStatusManager::absolute_tmp_dir + GlobalStatusManager::getInstance().getFileName(id);
+    TransferJournal journal(FileSystemUtils::utf8ToWide(tmp_path));
+    if (journal.load())
+    {
+        auto missing_ranges = journal.missingRanges();
+        if (!missing_ranges.empty())
+        {
+            control_msg_network_driver->sendMsg(
+                sync_builder->buildSyncMsg(Json::MessageType::Sync::ResumeFile,
+                                           {std::to_string(id), std::to_string(journal.totalSize()),
+                                            TransferJournal::rangesToString(missing_ranges)},
+                                           3));
+            return;
+        }
+    }
+
+    // 临时目录中已有之前下载的版本时附上块签名，对端只发送差异；签名需要读完旧版本，交给后台线程计算
+    if (FileSystemUtils::fileIsExist(tmp_path) && !FileSystemUtils::isDirectory(tmp_path))
+    {
+        uint64_t basis_size = FileSystemUtils::getFileSize(tmp_path);
+        if (basis_size >= FileSyncEngineInterface::delta_min_size && basis_size <= DeltaSignature::max_basis_size)
+        {
+            {
+                std::lock_guard<std::mutex> lock(signature_mutex);
+                signature_queue.push_back(id);
+            }
+            signature_cv.notify_one();
+            return;
+        }
+    }
+
+    sendDownloadFile(id);
+}
+
+void NetworkController::onSendManifestSatisfied(uint32_t id)
 {
     auto sync_builder = json_builder->getBuilder(Json::BuilderType::Sync);
     control_msg_network_driver->sendMsg(
-        sync_builder->buildSyncMsg(Json::MessageType::Sync::DownloadFile, {std::to_string(id)}, 1));
+        sync_builder->buildSyncMsg(Json::MessageType::Sync::ManifestSatisfied, {std::to_string(id)}, 1));
+}
+
+void NetworkController::sendDownloadFile(uint32_t id)
+{
+    // 临时目录中有已建索引的文件时才请求分块清单，否则对端直接发送数据，不必先读一遍文件
+    auto type = ChunkStore::hasIndexedFiles(FileSystemUtils::utf8ToWide(GlobalStatusManager::absolute_tmp_dir))
+                    ? Json::MessageType::Sync::DedupFile
+                    : Json::MessageType::Sync::DownloadFile;
+    auto sync_builder = json_builder->getBuilder(Json::BuilderType::Sync);
+    control_msg_network_driver->sendMsg(sync_builder->buildSyncMsg(type, {std::to_string(id)}, 1));
+}
+
+void NetworkController::signatureLoop()
+{
+    while (true)
+    {
+        uint32_t id = 0;
+        {
+            std::unique_lock<std::mutex> lock(signature_mutex);
+            signature_cv.wait(lock, [this]()
+                              { return is_signature_stopped || !signature_queue.empty(); });
+            if (is_signature_stopped)
+            {
+                return;
+            }
+            id = signature_queue.front();
+            signature_queue.pop_front();
+        }
+
+        std::string tmp_path = GlobalStatusManager::absolute_tmp_dir + GlobalStatusManager::getInstance().getFileName(id);
+        DeltaSignature signature;
+        if (!signature.compute(FileSystemUtils::utf8ToWide(tmp_path)))
+        {
+            sendDownloadFile(id);
+            continue;
+        }
+        auto sync_builder = json_builder->getBuilder(Json::BuilderType::Sync);
+        control_msg_network_driver->sendMsg(
+            sync_builder->buildSyncMsg(Json::MessageType::Sync::DeltaFile,
+                                       {std::to_string(id), std::to_string(signature.basis_size),
+                                        std::to_string(signature.block_size), signature.blocksToString()},
+                                       4));
+    }
 }
\ No newline at end of file
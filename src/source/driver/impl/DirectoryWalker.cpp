@@ -0,0 +1,318 @@
+#include "driver/impl/DirectoryWalker.h"
+#include "driver/impl/FileUtility.h"
+#include "common/DebugOutputer.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <thread>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+std::mutex DirectoryWalker::cache_mutex;
+std::map<std::string, std::shared_ptr<const DirectoryManifest>> DirectoryWalker::manifest_cache;
+
+namespace
+{
+    // 各线程独立收集结果，结束后合并，避免在热路径上加锁
+    struct WalkResult
+    {
+        std::vector<DirectoryManifest::FileEntry> files;
+        std::vector<std::string> leaf_folders;
+        uint64_t total_size{0};
+    };
+
+    // 待遍历的目录队列，所有线程空闲且队列为空时遍历结束
+    class WalkQueue
+    {
+    public:
+        void push(std::string dir)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                dirs.push_back(std::move(dir));
+            }
+            cv.notify_one();
+        }
+
+        bool pop(std::string &dir)
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            --active;
+            if (dirs.empty() && active == 0)
+            {
+                cv.notify_all();
+            }
+            cv.wait(lock, [this]
+                    { return !dirs.empty() || active == 0; });
+            if (dirs.empty())
+            {
+                return false;
+            }
+            dir = std::move(dirs.front());
+            dirs.pop_front();
+            ++active;
+            return true;
+        }
+
+        void setWorkers(int count)
+        {
+            active = count;
+        }
+
+    private:
+        std::mutex mtx;
+        std::condition_variable cv;
+        std::deque<std::string> dirs;
+        int active{0};
+    };
+
+    std::string joinPath(const std::string &dir, const char *name)
+    {
+        return (fs::path(dir) / fs::u8path(name)).make_preferred().u8string();
+    }
+
+#ifdef __linux__
+    struct LinuxDirent64
+    {
+        uint64_t d_ino;
+        int64_t d_off;
+        unsigned short d_reclen;
+        unsigned char d_type;
+        char d_name[];
+    };
+
+    // 按名称取文件类型与大小，符号链接指向普通文件时按普通文件处理，指向目录时不跟随
+    bool statEntry(int dir_fd, const char *name, bool &is_dir, bool &is_file, uint64_t &size)
+    {
+#ifdef STATX_SIZE
+        struct statx stx;
+        if (statx(dir_fd, name, AT_SYMLINK_NOFOLLOW | AT_STATX_DONT_SYNC, STATX_TYPE | STATX_SIZE, &stx) != 0)
+        {
+            return false;
+        }
+        if (S_ISLNK(stx.stx_mode))
+        {
+            if (statx(dir_fd, name, AT_STATX_DONT_SYNC, STATX_TYPE | STATX_SIZE, &stx) != 0)
+            {
+                return false;
+            }
+            is_dir = false;
+        }
+        else
+        {
+            is_dir = S_ISDIR(stx.stx_mode);
+        }
+        is_file = S_ISREG(stx.stx_mode);
+        size = stx.stx_size;
+#else
+        struct stat st;
+        if (fstatat(dir_fd, name, &st, AT_SYMLINK_NOFOLLOW) != 0)
+        {
+            return false;
+        }
+        if (S_ISLNK(st.st_mode))
+        {
+            if (fstatat(dir_fd, name, &st, 0) != 0)
+            {
+                return false;
+            }
+            is_dir = false;
+        }
+        else
+        {
+            is_dir = S_ISDIR(st.st_mode);
+        }
+        is_file = S_ISREG(st.st_mode);
+        size = static_cast<uint64_t>(st.st_size);
+#endif
+        return true;
+    }
+
+    void listDirectory(const std::string &dir, WalkQueue &queue, WalkResult &result, const fs::path &root)
+    {
+        int dir_fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (dir_fd < 0)
+        {
+            LOG_ERROR("访问路径错误: " << dir);
+            return;
+        }
+        bool has_subdirectories = false;
+        alignas(LinuxDirent64) char buffer[64 * 1024];
+        while (true)
+        {
+            long bytes = syscall(SYS_getdents64, dir_fd, buffer, sizeof(buffer));
+            if (bytes <= 0)
+            {
+                break;
+            }
+            for (long offset = 0; offset < bytes;)
+            {
+                auto *entry = reinterpret_cast<LinuxDirent64 *>(buffer + offset);
+                offset += entry->d_reclen;
+                const char *name = entry->d_name;
+                if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')))
+                {
+                    continue;
+                }
+                // 目录不需要stat，只有文件需要大小
+                if (entry->d_type == DT_DIR)
+                {
+                    has_subdirectories = true;
+                    queue.push(joinPath(dir, name));
+                    continue;
+                }
+                bool is_dir = false;
+                bool is_file = false;
+                uint64_t size = 0;
+                if (!statEntry(dir_fd, name, is_dir, is_file, size))
+                {
+                    continue;
+                }
+                if (is_dir)
+                {
+                    has_subdirectories = true;
+                    queue.push(joinPath(dir, name));
+                }
+                else if (is_file)
+                {
+                    result.files.push_back({joinPath(dir, name), size});
+                    result.total_size += size;
+                }
+            }
+        }
+        ::close(dir_fd);
+        if (!has_subdirectories)
+        {
+            result.leaf_folders.push_back(fs::path(dir).lexically_relative(root).make_preferred().u8string());
+        }
+    }
+#else
+    void listDirectory(const std::string &dir, WalkQueue &queue, WalkResult &result, const fs::path &root)
+    {
+        std::error_code ec;
+        bool has_subdirectories = false;
+        fs::directory_iterator it(fs::u8path(dir), fs::directory_options::skip_permission_denied, ec);
+        if (ec)
+        {
+            LOG_ERROR("访问路径错误: " << dir << " - " << ec.message());
+            return;
+        }
+        for (; it != fs::directory_iterator(); it.increment(ec))
+        {
+            if (ec)
+            {
+                LOG_ERROR("访问目录项出错: " << ec.message());
+                break;
+            }
+            const auto &entry = *it;
+            if (entry.is_directory(ec) && !entry.is_symlink(ec))
+            {
+                has_subdirectories = true;
+                queue.push(entry.path().u8string());
+            }
+            else if (entry.is_regular_file(ec))
+            {
+                uint64_t size = entry.file_size(ec);
+                if (!ec)
+                {
+                    result.files.push_back({fs::path(entry.path()).make_preferred().u8string(), size});
+                    result.total_size += size;
+                }
+            }
+        }
+        if (!has_subdirectories)
+        {
+            result.leaf_folders.push_back(fs::u8path(dir).lexically_relative(root).make_preferred().u8string());
+        }
+    }
+#endif
+}
+
+std::shared_ptr<DirectoryManifest> DirectoryWalker::walk(const std::string &root_path)
+{
+    auto manifest = std::make_shared<DirectoryManifest>();
+    manifest->scan_time = std::chrono::steady_clock::now();
+    if (!FileSystemUtils::isDirectory(root_path))
+    {
+        LOG_ERROR("路径不存在: " << root_path);
+        return manifest;
+    }
+
+    // 去掉结尾的分隔符，保证相对路径计算正确
+    std::string root_dir = root_path;
+    while (root_dir.size() > 1 && (root_dir.back() == '/' || root_dir.back() == '\\'))
+    {
+        root_dir.pop_back();
+    }
+    fs::path root = fs::u8path(root_dir);
+    int worker_count = static_cast<int>((std::max)(2u, (std::min)(8u, std::thread::hardware_concurrency())));
+    WalkQueue queue;
+    queue.setWorkers(worker_count);
+    queue.push(root_dir);
+    std::vector<WalkResult> results(worker_count);
+    std::vector<std::thread> workers;
+    for (int i = 0; i < worker_count; ++i)
+    {
+        workers.emplace_back([&queue, &results, &root, i]()
+                             {
+            std::string dir;
+            while (queue.pop(dir))
+            {
+                listDirectory(dir, queue, results[i], root);
+            } });
+    }
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+
+    for (auto &result : results)
+    {
+        manifest->total_size += result.total_size;
+        manifest->files.insert(manifest->files.end(),
+                               std::make_move_iterator(result.files.begin()), std::make_move_iterator(result.files.end()));
+        manifest->leaf_folders.insert(manifest->leaf_folders.end(),
+                                      std::make_move_iterator(result.leaf_folders.begin()), std::make_move_iterator(result.leaf_folders.end()));
+    }
+    // 并行遍历的顺序不确定，排序后同一目录的文件相邻
+    std::sort(manifest->files.begin(), manifest->files.end(), [](const auto &a, const auto &b)
+              { return a.path < b.path; });
+    std::sort(manifest->leaf_folders.begin(), manifest->leaf_folders.end());
+    return manifest;
+}
+
+std::shared_ptr<const DirectoryManifest> DirectoryWalker::scan(const std::string &root_path)
+{
+    auto now = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        // 顺便清理过期的清单
+        for (auto it = manifest_cache.begin(); it != manifest_cache.end();)
+        {
+            if (now - it->second->scan_time > manifest_max_age)
+            {
+                it = manifest_cache.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+        auto it = manifest_cache.find(root_path);
+        if (it != manifest_cache.end())
+        {
+            return it->second;
+        }
+    }
+    std::shared_ptr<const DirectoryManifest> manifest = walk(root_path);
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    manifest_cache[root_path] = manifest;
+    return manifest;
+}
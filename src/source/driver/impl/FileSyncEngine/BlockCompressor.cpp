@@ -0,0 +1,67 @@
+#include "driver/impl/FileSyncEngine/BlockCompressor.h"
+
+#include <algorithm>
+#include <cmath>
+
+BlockCompressor::BlockCompressor(std::shared_ptr<CompressionInterface> compression) : compression(std::move(compression))
+{
+}
+
+void BlockCompressor::reset()
+{
+    skip_blocks = 0;
+    skip_span = 1;
+}
+
+double BlockCompressor::estimateEntropy(const uint8_t *data, size_t size)
+{
+    uint32_t counts[256] = {0};
+    size_t samples = (std::min)(size, entropy_sample_size);
+    size_t step = size / samples;
+    for (size_t i = 0; i < samples; ++i)
+    {
+        ++counts[data[i * step]];
+    }
+    double entropy = 0;
+    for (uint32_t count : counts)
+    {
+        if (count > 0)
+        {
+            double p = static_cast<double>(count) / samples;
+            entropy -= p * std::log2(p);
+        }
+    }
+    return entropy;
+}
+
+void BlockCompressor::onIncompressible()
+{
+    skip_blocks = skip_span;
+    skip_span = (std::min)(skip_span * 2, max_skip_blocks);
+}
+
+bool BlockCompressor::compress(const std::vector<uint8_t> &block, std::vector<uint8_t> &out)
+{
+    if (!compression || block.size() < min_size)
+    {
+        return false;
+    }
+    if (skip_blocks > 0)
+    {
+        --skip_blocks;
+        return false;
+    }
+    if (estimateEntropy(block.data(), block.size()) > max_entropy)
+    {
+        onIncompressible();
+        return false;
+    }
+    if (!compression->compress(block.data(), block.size(), out) ||
+        out.size() * 100 > block.size() * max_ratio_percent)
+    {
+        onIncompressible();
+        return false;
+    }
+    skip_span = 1;
+    return true;
+}
@@ -0,0 +1,155 @@
+#include "driver/impl/FileSyncEngine/BlockReader.h"
+#include "driver/interface/FileSyncEngine/FileSyncEngineInterface.h"
+
+#include <algorithm>
+
+BlockReader::BlockReader(size_t depth) : depth((std::max)(depth, static_cast<size_t>(1)))
+{
+    read_thread = std::thread(&BlockReader::readLoop, this);
+}
+
+BlockReader::~BlockReader()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        running = false;
+    }
+    cv.notify_all();
+    if (read_thread.joinable())
+    {
+        read_thread.join();
+    }
+}
+
+bool BlockReader::open(const std::wstring &wpath, uint64_t offset, uint64_t length, uint32_t new_block_size, bool drop_behind)
+{
+    close();
+    std::unique_ptr<FileStreamHelper::MappedReader> new_mapped_reader;
+    if (length >= FileSyncEngineInterface::mmap_min_size)
+    {
+        new_mapped_reader = std::make_unique<FileStreamHelper::MappedReader>(wpath, FileSyncEngineInterface::mmap_window_size);
+        if (!new_mapped_reader->isOpen())
+        {
+            new_mapped_reader.reset();
+        }
+    }
+    auto new_reader = std::make_unique<FileStreamHelper::PositionalReader>(wpath);
+    if (!new_reader->isOpen())
+    {
+        return false;
+    }
+    // 块较大时减少预读块数，限制缓冲区占用
+    size_t new_block_depth = (std::max)(static_cast<size_t>(1),
+                                        (std::min)(depth, static_cast<size_t>(FileSyncEngineInterface::read_ahead_max_bytes / new_block_size)));
+    // 整个范围顺序读取，先预取第一个窗口
+    new_reader->adviseSequential(offset, length);
+    new_reader->adviseWillNeed(offset, (std::min)(length, static_cast<uint64_t>(new_block_depth) * new_block_size));
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        block_size = new_block_size;
+        block_depth = new_block_depth;
+        reader = std::move(new_reader);
+        mapped_reader = std::move(new_mapped_reader);
+        read_offset = offset;
+        read_end = offset + length;
+        is_drop_behind = drop_behind;
+        drop_offset = offset;
+        drop_lag = mapped_reader ? FileSyncEngineInterface::mmap_window_size : 0;
+    }
+    cv.notify_all();
+    return true;
+}
+
+std::unique_ptr<std::vector<uint8_t>> BlockReader::next()
+{
+    std::unique_lock<std::mutex> lock(mtx);
+    cv.wait(lock, [this]
+            { return !ready_blocks.empty() || read_offset >= read_end || !running; });
+    if (ready_blocks.empty())
+    {
+        return nullptr;
+    }
+    auto block = std::move(ready_blocks.front());
+    ready_blocks.pop_front();
+    cv.notify_all();
+    return block;
+}
+
+void BlockReader::close()
+{
+    std::unique_lock<std::mutex> lock(mtx);
+    ++generation;
+    // 等待在途读取结束后再关闭文件
+    cv.wait(lock, [this]
+            { return !in_flight; });
+    // 解除映射后剩余已读的部分才能丢弃
+    mapped_reader.reset();
+    if (is_drop_behind && reader && read_offset > drop_offset)
+    {
+        reader->adviseDontNeed(drop_offset, read_offset - drop_offset);
+    }
+    is_drop_behind = false;
+    reader.reset();
+    ready_blocks.clear();
+    read_offset = 0;
+    read_end = 0;
+}
+
+void BlockReader::readLoop()
+{
+    constexpr uint32_t HEADER_SIZE = FileSyncEngineInterface::block_header_size;
+    std::unique_lock<std::mutex> lock(mtx);
+    while (true)
+    {
+        cv.wait(lock, [this]
+                { return !running || (reader && read_offset < read_end && ready_blocks.size() < block_depth); });
+        if (!running)
+        {
+            break;
+        }
+        uint64_t offset = read_offset;
+        uint64_t size = (std::min)(read_end - offset, static_cast<uint64_t>(block_size));
+        uint64_t prefetch_offset = offset + block_depth * block_size;
+        uint64_t current_generation = generation;
+        auto *current_reader = reader.get();
+        auto *current_mapped_reader = mapped_reader.get();
+        // offset之前的数据已经拷入块缓冲区
+        uint64_t drop_begin = drop_offset;
+        uint64_t drop_end = drop_offset;
+        if (is_drop_behind && offset >= drop_offset + drop_lag + FileSyncEngineInterface::drop_behind_window)
+        {
+            drop_end = offset - drop_lag;
+            drop_offset = drop_end;
+        }
+        in_flight = true;
+        lock.unlock();
+
+        auto block = std::make_unique<std::vector<uint8_t>>(HEADER_SIZE + size);
+        // 映射读取省去read系统调用，数据从页缓存直接拷入块缓冲区
+        size_t bytes_read = current_mapped_reader ? current_mapped_reader->readAt(offset, block->data() + HEADER_SIZE, size)
+                                                  : current_reader->readAt(offset, block->data() + HEADER_SIZE, size);
+        // 窗口前移一个块，保持depth个块的预取
+        current_reader->adviseWillNeed(prefetch_offset, size);
+        if (drop_end > drop_begin)
+        {
+            current_reader->adviseDontNeed(drop_begin, drop_end - drop_begin);
+        }
+
+        lock.lock();
+        in_flight = false;
+        if (current_generation == generation)
+        {
+            if (bytes_read > 0)
+            {
+                block->resize(HEADER_SIZE + bytes_read);
+                ready_blocks.push_back(std::move(block));
+                read_offset += bytes_read;
+            }
+            if (bytes_read < size) // 文件末尾或读取失败，不再继续
+            {
+                read_end = read_offset;
+            }
+        }
+        cv.notify_all();
+    }
+}
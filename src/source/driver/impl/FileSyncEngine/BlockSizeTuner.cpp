@@ -0,0 +1,49 @@
+#include "driver/impl/FileSyncEngine/BlockSizeTuner.h"
+
+#include <algorithm>
+
+void BlockSizeTuner::onSent(uint64_t bytes, std::chrono::microseconds elapsed)
+{
+    if (elapsed.count() <= 0 || bytes == 0)
+    {
+        return;
+    }
+    double sample = static_cast<double>(bytes) * 1000000.0 / static_cast<double>(elapsed.count());
+    throughput_bps = throughput_bps == 0 ? sample : throughput_bps * 0.75 + sample * 0.25;
+    update();
+}
+
+void BlockSizeTuner::onTcpInfo(uint32_t rtt, uint32_t total_retrans)
+{
+    if (rtt > 0)
+    {
+        rtt_us = rtt;
+        min_rtt_us = min_rtt_us == 0 ? rtt : (std::min)(min_rtt_us, rtt);
+    }
+    // 两次采样之间出现重传视为有丢包
+    is_lossy = total_retrans > last_retrans;
+    last_retrans = total_retrans;
+}
+
+void BlockSizeTuner::update()
+{
+    uint32_t next_size = block_size;
+    // 丢包或RTT明显高于基线（排队拥塞）时减半，减小单帧重传与排队的代价
+    if (is_lossy || (min_rtt_us > 0 && rtt_us > min_rtt_us * 2 + 1000))
+    {
+        next_size = block_size / 2;
+    }
+    else
+    {
+        double target = throughput_bps * static_cast<double>(target_frame_time.count()) / 1000000.0;
+        // 取不超过目标的2的幂，每次最多翻倍，避免震荡
+        uint32_t pow2_size = FileSyncEngineInterface::min_block_size;
+        while (pow2_size < FileSyncEngineInterface::max_block_size && pow2_size * 2.0 <= target)
+        {
+            pow2_size *= 2;
+        }
+        next_size = (std::min)(pow2_size, block_size * 2);
+    }
+    block_size = (std::max)(FileSyncEngineInterface::min_block_size, (std::min)(FileSyncEngineInterface::max_block_size, next_size));
+    is_lossy = false;
+}
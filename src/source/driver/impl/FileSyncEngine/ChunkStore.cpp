@@ -0,0 +1,176 @@
+#include "driver/impl/FileSyncEngine/ChunkStore.h"
+#include "driver/impl/FileSyncEngine/TransferJournal.h"
+#include "driver/interface/FileSyncEngine/FileSyncEngineInterface.h"
+#include "driver/impl/FileUtility.h"
+#include "common/DebugOutputer.h"
+
+#include <sstream>
+
+ChunkStore::ChunkStore(std::wstring dir) : dir(std::move(dir))
+{
+}
+
+static bool hasSuffix(const std::wstring &str, const std::wstring &suffix)
+{
+    return str.size() >= suffix.size() && str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+void ChunkStore::refresh(const std::wstring &exclude_path)
+{
+    locations.clear();
+    readers.clear();
+
+    size_t skipped = 0;
+    forEachFile(dir, exclude_path, [&](const std::wstring &path, uint64_t size, int64_t mtime)
+                {
+        std::vector<ContentChunker::Chunk> chunks;
+        if (!loadIndex(path, size, mtime, &chunks))
+        {
+            ++skipped;
+            return true;
+        }
+        for (const auto &chunk : chunks)
+        {
+            locations.emplace(chunk.hash, Location{path, chunk.offset, chunk.length});
+        }
+        return true; });
+    if (skipped > 0)
+    {
+        LOG_INFO(skipped << " files in tmp dir are not indexed yet");
+    }
+}
+
+void ChunkStore::buildIndexes(const std::wstring &dir, const std::atomic<bool> &stop)
+{
+    forEachFile(dir, std::wstring(), [&](const std::wstring &path, uint64_t size, int64_t mtime)
+                {
+        if (stop)
+        {
+            return false;
+        }
+        if (loadIndex(path, size, mtime, nullptr))
+        {
+            return true;
+        }
+        std::vector<ContentChunker::Chunk> chunks;
+        if (ContentChunker::chunkFile(path, chunks))
+        {
+            saveIndex(path, size, mtime, chunks);
+        }
+        return true; });
+}
+
+bool ChunkStore::hasIndexedFiles(const std::wstring &dir)
+{
+    bool is_found = false;
+    forEachFile(dir, std::wstring(), [&](const std::wstring &path, uint64_t size, int64_t mtime)
+                {
+        is_found = loadIndex(path, size, mtime, nullptr);
+        return !is_found; });
+    return is_found;
+}
+
+void ChunkStore::forEachFile(const std::wstring &dir, const std::wstring &exclude_path,
+                             const std::function<bool(const std::wstring &path, uint64_t size, int64_t mtime)> &callback)
+{
+    std::error_code ec;
+    fs::path root = fs::u8path(FileStreamHelper::wstringToLocalPath(dir));
+    fs::path exclude = fs::u8path(FileStreamHelper::wstringToLocalPath(exclude_path));
+    for (const auto &entry : fs::directory_iterator(root, fs::directory_options::skip_permission_denied, ec))
+    {
+        std::wstring path = FileSystemUtils::utf8ToWide(entry.path().u8string());
+        std::error_code entry_ec;
+        if (!entry.is_regular_file(entry_ec) || hasSuffix(path, index_suffix) ||
+            hasSuffix(path, TransferJournal::journal_suffix) ||
+            (!exclude_path.empty() && entry.path().lexically_normal() == exclude.lexically_normal()))
+        {
+            continue;
+        }
+        uint64_t size = entry.file_size(entry_ec);
+        if (entry_ec || size < FileSyncEngineInterface::dedup_min_size)
+        {
+            continue;
+        }
+        // 接收中的文件内容不完整
+        if (fs::exists(fs::u8path(FileStreamHelper::wstringToLocalPath(path + TransferJournal::journal_suffix)), entry_ec))
+        {
+            continue;
+        }
+        int64_t mtime = static_cast<int64_t>(entry.last_write_time(entry_ec).time_since_epoch().count());
+        if (!callback(path, size, mtime))
+        {
+            return;
+        }
+    }
+    if (ec)
+    {
+        LOG_ERROR("访问临时目录错误: " << ec.message());
+    }
+}
+
+bool ChunkStore::read(const ContentChunker::Chunk &chunk, std::vector<uint8_t> &data)
+{
+    auto it = locations.find(chunk.hash);
+    if (it == locations.end() || it->second.length != chunk.length)
+    {
+        return false;
+    }
+    auto &reader = readers[it->second.path];
+    if (!reader)
+    {
+        reader = std::make_unique<FileStreamHelper::PositionalReader>(it->second.path);
+    }
+    data.resize(chunk.length);
+    if (!reader->isOpen() || reader->readAt(it->second.offset, data.data(), data.size()) != data.size())
+    {
+        return false;
+    }
+    // 索引建立后文件可能被改动，以实际内容为准
+    return ContentChunker::hashChunk(data.data(), data.size()) == chunk.hash;
+}
+
+bool ChunkStore::loadIndex(const std::wstring &path, uint64_t size, int64_t mtime, std::vector<ContentChunker::Chunk> *chunks)
+{
+    auto reader = FileStreamHelper::createInputFileStream(path + index_suffix);
+    if (!reader || !reader->is_open())
+    {
+        return false;
+    }
+    uint64_t index_size = 0;
+    int64_t index_mtime = 0;
+    if (!(*reader >> index_size >> index_mtime) || index_size != size || index_mtime != mtime)
+    {
+        return false;
+    }
+    ContentChunker::Chunk chunk;
+    while (chunks && *reader >> chunk.offset >> chunk.length >> chunk.hash)
+    {
+        chunks->push_back(chunk);
+    }
+    return true;
+}
+
+void ChunkStore::saveIndex(const std::wstring &path, uint64_t size, int64_t mtime, const std::vector<ContentChunker::Chunk> &chunks)
+{
+    std::ostringstream oss;
+    oss << size << " " << mtime << "\n";
+    for (const auto &chunk : chunks)
+    {
+        oss << ContentChunker::chunkToString(chunk) << "\n";
+    }
+    std::string content = oss.str();
+
+    auto writer = FileStreamHelper::createOutputFileStream(path + index_suffix);
+    if (!writer || !writer->is_open())
+    {
+        LOG_ERROR("Failed to save chunk index: " << FileStreamHelper::wstringToLocalPath(path + index_suffix));
+        return;
+    }
+    writer->write(content.data(), content.size());
+}
+
+void ChunkStore::removeIndex(const std::wstring &path)
+{
+    std::error_code ec;
+    fs::remove(fs::u8path(FileStreamHelper::wstringToLocalPath(path + index_suffix)), ec);
+}
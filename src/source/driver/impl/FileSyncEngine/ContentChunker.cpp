@@ -0,0 +1,198 @@
+#include "driver/impl/FileSyncEngine/ContentChunker.h"
+#include "driver/interface/FileSyncEngine/FileSyncEngineInterface.h"
+#include "driver/interface/FileStreamHelper.h"
+#include "driver/impl/FileUtility.h"
+#include "common/DebugOutputer.h"
+
+#include <openssl/sha.h>
+#include <array>
+#include <cstring>
+#include <sstream>
+
+namespace
+{
+    // Gear表由固定种子生成，收发两端的块边界一致
+    std::array<uint64_t, 256> makeGearTable()
+    {
+        std::array<uint64_t, 256> table{};
+        uint64_t state = 0x9E3779B97F4A7C15ULL;
+        for (auto &value : table)
+        {
+            state += 0x9E3779B97F4A7C15ULL;
+            uint64_t z = state;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            value = z ^ (z >> 31);
+        }
+        return table;
+    }
+
+    const std::array<uint64_t, 256> gear_table = makeGearTable();
+
+    // 指纹左移累积，高位取决于最近的64字节，掩码取高位
+    constexpr uint64_t highMask(int bits)
+    {
+        return ((1ULL << bits) - 1) << (64 - bits);
+    }
+
+    constexpr int log2(uint64_t value)
+    {
+        return value <= 1 ? 0 : 1 + log2(value / 2);
+    }
+
+    // 归一化分块：未到平均块长时用更严的掩码，之后放宽，块长集中在平均值附近
+    constexpr int avg_bits = log2(FileSyncEngineInterface::chunk_avg_size);
+    constexpr uint64_t mask_small = highMask(avg_bits + 2);
+    constexpr uint64_t mask_large = highMask(avg_bits - 2);
+}
+
+size_t ContentChunker::findCut(const uint8_t *data, size_t size)
+{
+    if (size <= FileSyncEngineInterface::chunk_min_size)
+    {
+        return size;
+    }
+    size = (std::min)(size, static_cast<size_t>(FileSyncEngineInterface::chunk_max_size));
+    size_t normal = (std::min)(size, static_cast<size_t>(FileSyncEngineInterface::chunk_avg_size));
+
+    uint64_t fingerprint = 0;
+    size_t i = FileSyncEngineInterface::chunk_min_size;
+    for (; i < normal; ++i)
+    {
+        fingerprint = (fingerprint << 1) + gear_table[data[i]];
+        if (!(fingerprint & mask_small))
+        {
+            return i + 1;
+        }
+    }
+    for (; i < size; ++i)
+    {
+        fingerprint = (fingerprint << 1) + gear_table[data[i]];
+        if (!(fingerprint & mask_large))
+        {
+            return i + 1;
+        }
+    }
+    return size;
+}
+
+std::string ContentChunker::hashChunk(const uint8_t *data, size_t size)
+{
+    uint8_t digest[SHA256_DIGEST_LENGTH];
+    SHA256(data, size, digest);
+    static const char hex[] = "0123456789abcdef";
+    std::string result(SHA256_DIGEST_LENGTH * 2, '0');
+    for (int i = 0; i < SHA256_DIGEST_LENGTH; ++i)
+    {
+        result[i * 2] = hex[digest[i] >> 4];
+        result[i * 2 + 1] = hex[digest[i] & 0x0F];
+    }
+    return result;
+}
+
+bool ContentChunker::Stream::open(const std::wstring &path, ReadCallback on_read)
+{
+    reader = std::make_unique<FileStreamHelper::PositionalReader>(path);
+    if (!reader->isOpen())
+    {
+        LOG_ERROR("Failed to open file: " << FileStreamHelper::wstringToLocalPath(path));
+        reader.reset();
+        return false;
+    }
+    this->on_read = std::move(on_read);
+    file_size = FileSystemUtils::getFileSize(FileStreamHelper::wstringToLocalPath(path));
+    file_holes = reader->findHoles(file_size, FileSyncEngineInterface::min_block_size, FileSyncEngineInterface::sparse_min_hole);
+    buffer.resize(FileSyncEngineInterface::chunk_max_size * 4);
+    segment_index = 0;
+    is_finished = false;
+    beginSegment(0);
+    return true;
+}
+
+void ContentChunker::Stream::beginSegment(uint64_t begin)
+{
+    segment_end = segment_index < file_holes.size() ? file_holes[segment_index].first : file_size;
+    buffer_offset = begin;
+    buffer_size = 0;
+    position = 0;
+    is_eof = false;
+}
+
+void ContentChunker::Stream::next(std::vector<Chunk> &chunks, size_t max_count)
+{
+    size_t count = 0;
+    while (!is_finished && count < max_count)
+    {
+        if (!is_eof && buffer_size - position < FileSyncEngineInterface::chunk_max_size)
+        {
+            memmove(buffer.data(), buffer.data() + position, buffer_size - position);
+            buffer_offset += position;
+            buffer_size -= position;
+            position = 0;
+            uint64_t read_offset = buffer_offset + buffer_size;
+            size_t read_size = static_cast<size_t>((std::min)(static_cast<uint64_t>(buffer.size() - buffer_size),
+                                                              segment_end - (std::min)(segment_end, read_offset)));
+            size_t bytes_read = read_size > 0 ? reader->readAt(read_offset, buffer.data() + buffer_size, read_size) : 0;
+            if (bytes_read > 0 && on_read)
+            {
+                on_read(read_offset, buffer.data() + buffer_size, bytes_read);
+            }
+            buffer_size += bytes_read;
+            is_eof = bytes_read == 0;
+            continue;
+        }
+        if (position < buffer_size)
+        {
+            size_t length = findCut(buffer.data() + position, buffer_size - position);
+            chunks.push_back({buffer_offset + position, static_cast<uint32_t>(length),
+                              hashChunk(buffer.data() + position, length)});
+            position += length;
+            ++count;
+            continue;
+        }
+        // 当前段已分完，跳过其后的空洞
+        if (segment_index >= file_holes.size())
+        {
+            is_finished = true;
+            reader.reset();
+            break;
+        }
+        uint64_t next_begin = file_holes[segment_index].first + file_holes[segment_index].second;
+        ++segment_index;
+        beginSegment(next_begin);
+    }
+}
+
+bool ContentChunker::chunkFile(const std::wstring &path, std::vector<Chunk> &chunks,
+                               std::vector<std::pair<uint64_t, uint64_t>> *holes)
+{
+    Stream stream;
+    if (!stream.open(path))
+    {
+        return false;
+    }
+    chunks.clear();
+    while (!stream.isFinished())
+    {
+        stream.next(chunks, FileSyncEngineInterface::chunk_batch_size);
+    }
+    if (holes)
+    {
+        *holes = stream.holes();
+    }
+    return true;
+}
+
+std::string ContentChunker::chunkToString(const Chunk &chunk)
+{
+    std::ostringstream oss;
+    oss << chunk.offset << " " << chunk.length << " " << chunk.hash;
+    return oss.str();
+}
+
+bool ContentChunker::chunkFromString(const std::string &str, Chunk &chunk)
+{
+    std::istringstream iss(str);
+    return static_cast<bool>(iss >> chunk.offset >> chunk.length >> chunk.hash) &&
+           chunk.length > 0 && chunk.length <= FileSyncEngineInterface::chunk_max_size;
+}
@@ -0,0 +1,419 @@
+#include "driver/impl/FileSyncEngine/DeltaSync.h"
+#include "driver/impl/FileUtility.h"
+#include "common/DebugOutputer.h"
+
+#include <openssl/evp.h>
+#include <openssl/sha.h>
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    const char hex_digits[] = "0123456789abcdef";
+
+    void appendHex(std::string &str, uint64_t value, int digits)
+    {
+        for (int i = digits - 1; i >= 0; --i)
+        {
+            str.push_back(hex_digits[(value >> (i * 4)) & 0x0F]);
+        }
+    }
+
+    bool parseHex(const char *str, int digits, uint64_t &value)
+    {
+        value = 0;
+        for (int i = 0; i < digits; ++i)
+        {
+            char c = str[i];
+            uint64_t nibble = 0;
+            if (c >= '0' && c <= '9')
+            {
+                nibble = c - '0';
+            }
+            else if (c >= 'a' && c <= 'f')
+            {
+                nibble = c - 'a' + 10;
+            }
+            else
+            {
+                return false;
+            }
+            value = (value << 4) | nibble;
+        }
+        return true;
+    }
+
+    std::string finishHash(EVP_MD_CTX *ctx)
+    {
+        uint8_t digest[SHA256_DIGEST_LENGTH];
+        unsigned int length = 0;
+        EVP_DigestFinal_ex(ctx, digest, &length);
+        std::string result;
+        result.reserve(length * 2);
+        for (unsigned int i = 0; i < length; ++i)
+        {
+            appendHex(result, digest[i], 2);
+        }
+        return result;
+    }
+
+    template <typename T>
+    void appendValue(std::vector<uint8_t> &out, T value)
+    {
+        size_t offset = out.size();
+        out.resize(offset + sizeof(value));
+        memcpy(out.data() + offset, &value, sizeof(value));
+    }
+}
+
+void RollingChecksum::init(const uint8_t *data, size_t size)
+{
+    a = 0;
+    b = 0;
+    length = static_cast<uint32_t>(size);
+    for (size_t i = 0; i < size; ++i)
+    {
+        a += data[i];
+        b += static_cast<uint32_t>(size - i) * data[i];
+    }
+}
+
+void RollingChecksum::roll(uint8_t out, uint8_t in)
+{
+    a = a - out + in;
+    b = b - length * out + a;
+}
+
+uint32_t DeltaSignature::blockSizeFor(uint64_t file_size)
+{
+    uint32_t size = min_block_size;
+    while (size < max_block_size && file_size / size > max_blocks)
+    {
+        size *= 2;
+    }
+    return size;
+}
+
+uint64_t DeltaSignature::strongChecksum(const uint8_t *data, size_t size)
+{
+    uint8_t digest[SHA256_DIGEST_LENGTH];
+    SHA256(data, size, digest);
+    uint64_t value = 0;
+    for (int i = 0; i < 8; ++i)
+    {
+        value = (value << 8) | digest[i];
+    }
+    return value;
+}
+
+bool DeltaSignature::compute(const std::wstring &path)
+{
+    FileStreamHelper::PositionalReader reader(path);
+    if (!reader.isOpen())
+    {
+        return false;
+    }
+    basis_size = FileSystemUtils::getFileSize(FileStreamHelper::wstringToLocalPath(path));
+    if (basis_size > max_basis_size)
+    {
+        return false;
+    }
+    block_size = blockSizeFor(basis_size);
+    blocks.clear();
+    blocks.reserve(basis_size / block_size);
+
+    std::vector<uint8_t> data(block_size);
+    RollingChecksum checksum;
+    for (uint64_t offset = 0; offset + block_size <= basis_size; offset += block_size)
+    {
+        if (reader.readAt(offset, data.data(), block_size) != block_size)
+        {
+            LOG_ERROR("Failed to read: " << FileStreamHelper::wstringToLocalPath(path));
+            return false;
+        }
+        checksum.init(data.data(), block_size);
+        blocks.push_back({checksum.value(), strongChecksum(data.data(), block_size)});
+    }
+    return true;
+}
+
+std::string DeltaSignature::blocksToString() const
+{
+    std::string result;
+    result.reserve(blocks.size() * 24);
+    for (const auto &block : blocks)
+    {
+        appendHex(result, block.weak, 8);
+        appendHex(result, block.strong, 16);
+    }
+    return result;
+}
+
+bool DeltaSignature::blocksFromString(const std::string &str)
+{
+    if (str.size() % 24 != 0 || block_size < min_block_size || block_size > max_block_size ||
+        str.size() / 24 != basis_size / block_size || str.size() / 24 > max_blocks)
+    {
+        return false;
+    }
+    blocks.clear();
+    blocks.reserve(str.size() / 24);
+    for (size_t i = 0; i < str.size(); i += 24)
+    {
+        uint64_t weak = 0;
+        uint64_t strong = 0;
+        if (!parseHex(str.data() + i, 8, weak) || !parseHex(str.data() + i + 8, 16, strong))
+        {
+            return false;
+        }
+        blocks.push_back({static_cast<uint32_t>(weak), strong});
+    }
+    return true;
+}
+
+DeltaEncoder::DeltaEncoder(std::shared_ptr<const DeltaSignature> signature, const std::wstring &path)
+    : signature(std::move(signature)), weak_filter(1 << 16), reader(path), hash_ctx(EVP_MD_CTX_new())
+{
+    file_size = FileSystemUtils::getFileSize(FileStreamHelper::wstringToLocalPath(path));
+    // 缓冲区至少容纳几个块，剩余不足一个块时把尾部挪到开头再读
+    buffer.resize((std::max)(static_cast<size_t>(8 * 1024 * 1024), static_cast<size_t>(this->signature->block_size) * 4));
+    for (uint32_t i = 0; i < this->signature->blocks.size(); ++i)
+    {
+        uint32_t weak = this->signature->blocks[i].weak;
+        block_table[weak].push_back(i);
+        weak_filter[weak & 0xFFFF] = 1;
+    }
+    EVP_DigestInit_ex(hash_ctx, EVP_sha256(), nullptr);
+}
+
+DeltaEncoder::~DeltaEncoder()
+{
+    EVP_MD_CTX_free(hash_ctx);
+}
+
+void DeltaEncoder::fill(std::vector<uint8_t> &out)
+{
+    const size_t block_size = signature->block_size;
+    if (is_eof || buffer_size - position > block_size)
+    {
+        return;
+    }
+    // 挪动前发出窗口之前的字面数据
+    flushLiteral(out);
+    memmove(buffer.data(), buffer.data() + position, buffer_size - position);
+    buffer_offset += position;
+    buffer_size -= position;
+    position = 0;
+    literal_begin = 0;
+    while (buffer_size < buffer.size())
+    {
+        size_t bytes_read = reader.readAt(buffer_offset + buffer_size, buffer.data() + buffer_size,
+                                          buffer.size() - buffer_size);
+        if (bytes_read == 0)
+        {
+            is_eof = true;
+            break;
+        }
+        EVP_DigestUpdate(hash_ctx, buffer.data() + buffer_size, bytes_read);
+        buffer_size += bytes_read;
+    }
+}
+
+int64_t DeltaEncoder::findBlock(uint32_t weak, const uint8_t *data) const
+{
+    if (!weak_filter[weak & 0xFFFF])
+    {
+        return -1;
+    }
+    auto it = block_table.find(weak);
+    if (it == block_table.end())
+    {
+        return -1;
+    }
+    uint64_t strong = DeltaSignature::strongChecksum(data, signature->block_size);
+    for (uint32_t index : it->second)
+    {
+        if (signature->blocks[index].strong == strong)
+        {
+            return index;
+        }
+    }
+    return -1;
+}
+
+void DeltaEncoder::flushLiteral(std::vector<uint8_t> &out)
+{
+    if (position <= literal_begin)
+    {
+        return;
+    }
+    uint32_t length = static_cast<uint32_t>(position - literal_begin);
+    appendValue(out, static_cast<uint8_t>(Literal));
+    appendValue(out, length);
+    out.insert(out.end(), buffer.begin() + literal_begin, buffer.begin() + position);
+    literal_begin = position;
+}
+
+void DeltaEncoder::flushCopy(std::vector<uint8_t> &out)
+{
+    if (copy_count == 0)
+    {
+        return;
+    }
+    appendValue(out, static_cast<uint8_t>(Copy));
+    appendValue(out, copy_begin);
+    appendValue(out, copy_count);
+    copy_count = 0;
+}
+
+bool DeltaEncoder::next(std::vector<uint8_t> &out, size_t max_size)
+{
+    if (is_finished)
+    {
+        return false;
+    }
+    const size_t block_size = signature->block_size;
+    size_t begin_size = out.size();
+    while (out.size() - begin_size < max_size)
+    {
+        fill(out);
+        size_t available = buffer_size - position;
+        if (available < block_size)
+        {
+            // 文件末尾不足一块，全部作为字面数据
+            position = buffer_size;
+            flushCopy(out);
+            flushLiteral(out);
+            is_finished = true;
+            file_hash = finishHash(hash_ctx);
+            break;
+        }
+        if (!rolling_valid)
+        {
+            rolling.init(buffer.data() + position, block_size);
+            rolling_valid = true;
+        }
+        int64_t index = block_table.empty() ? -1 : findBlock(rolling.value(), buffer.data() + position);
+        if (index >= 0)
+        {
+            flushLiteral(out);
+            // 连续的块合并为一条拷贝指令
+            if (copy_count > 0 && copy_begin + copy_count == static_cast<uint32_t>(index))
+            {
+                ++copy_count;
+            }
+            else
+            {
+                flushCopy(out);
+                copy_begin = static_cast<uint32_t>(index);
+                copy_count = 1;
+            }
+            position += block_size;
+            literal_begin = position;
+            rolling_valid = false;
+            continue;
+        }
+
+        flushCopy(out);
+        if (position + block_size < buffer_size)
+        {
+            rolling.roll(buffer[position], buffer[position + block_size]);
+        }
+        else
+        {
+            rolling_valid = false;
+        }
+        ++position;
+        if (position - literal_begin >= max_size)
+        {
+            flushLiteral(out);
+        }
+    }
+    return out.size() > begin_size;
+}
+
+DeltaDecoder::DeltaDecoder(const std::wstring &basis_path, const std::wstring &output_path, uint32_t block_size)
+    : basis(basis_path), output(output_path), block_size(block_size), hash_ctx(EVP_MD_CTX_new())
+{
+    EVP_DigestInit_ex(hash_ctx, EVP_sha256(), nullptr);
+    if (!output.isOpen())
+    {
+        LOG_ERROR("Failed to open: " << FileStreamHelper::wstringToLocalPath(output_path));
+        is_failed = true;
+    }
+}
+
+DeltaDecoder::~DeltaDecoder()
+{
+    EVP_MD_CTX_free(hash_ctx);
+}
+
+bool DeltaDecoder::write(const uint8_t *data, size_t size)
+{
+    if (!output.writeAt(output_size, data, size))
+    {
+        return false;
+    }
+    EVP_DigestUpdate(hash_ctx, data, size);
+    output_size += size;
+    return true;
+}
+
+bool DeltaDecoder::apply(const uint8_t *data, size_t size)
+{
+    size_t offset = 0;
+    while (!is_failed && offset < size)
+    {
+        uint8_t op = data[offset++];
+        uint32_t first = 0;
+        if (size - offset < sizeof(first))
+        {
+            is_failed = true;
+            break;
+        }
+        memcpy(&first, data + offset, sizeof(first));
+        offset += sizeof(first);
+
+        if (op == DeltaEncoder::Literal)
+        {
+            if (size - offset < first || !write(data + offset, first))
+            {
+                is_failed = true;
+                break;
+            }
+            offset += first;
+        }
+        else if (op == DeltaEncoder::Copy)
+        {
+            uint32_t count = 0;
+            if (size - offset < sizeof(count) || !basis.isOpen())
+            {
+                is_failed = true;
+                break;
+            }
+            memcpy(&count, data + offset, sizeof(count));
+            offset += sizeof(count);
+            copy_buffer.resize(block_size);
+            for (uint32_t i = 0; i < count && !is_failed; ++i)
+            {
+                uint64_t basis_offset = (static_cast<uint64_t>(first) + i) * block_size;
+                is_failed = basis.readAt(basis_offset, copy_buffer.data(), block_size) != block_size ||
+                            !write(copy_buffer.data(), block_size);
+            }
+        }
+        else
+        {
+            is_failed = true;
+        }
+    }
+    if (is_failed)
+    {
+        LOG_ERROR("Invalid delta instructions");
+    }
+    return !is_failed;
+}
+
+bool DeltaDecoder::finish(const std::string &expected_hash)
+{
+    return !is_failed && finishHash(hash_ctx) == expected_hash;
+}
@@ -0,0 +1,76 @@
+#include "driver/impl/FileSyncEngine/DirectoryWork.h"
+#include "driver/interface/FileSyncEngine/FileSyncEngineInterface.h"
+
+#include <algorithm>
+
+DirectoryWork::DirectoryWork(std::string root_path, uint32_t part_count) : root_path(std::move(root_path)),
+                                                                           part_count(part_count)
+{
+}
+
+void DirectoryWork::load()
+{
+    if (manifest)
+    {
+        return;
+    }
+    manifest = DirectoryWalker::scan(root_path);
+    items = manifest->files;
+    std::stable_partition(items.begin(), items.end(), [](const auto &item)
+                          { return item.size <= FileSyncEngineInterface::pack_item_max_size; });
+}
+
+uint64_t DirectoryWork::totalSize()
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    load();
+    return manifest->total_size;
+}
+
+uint32_t DirectoryWork::totalPaths()
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    load();
+    return static_cast<uint32_t>(manifest->leaf_folders.size());
+}
+
+bool DirectoryWork::takeItem(DirectoryManifest::FileEntry &entry, uint64_t max_size)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    load();
+    if (next_item >= items.size() || (max_size != 0 && items[next_item].size > max_size))
+    {
+        return false;
+    }
+    entry = std::move(items[next_item++]);
+    return true;
+}
+
+bool DirectoryWork::takePaths(std::vector<std::string> &paths, size_t max_items, size_t max_bytes)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    load();
+    const auto &leaf_folders = manifest->leaf_folders;
+    size_t bytes = 0;
+    while (next_path < leaf_folders.size() && paths.size() < max_items &&
+           (paths.empty() || bytes + leaf_folders[next_path].size() <= max_bytes))
+    {
+        bytes += leaf_folders[next_path].size();
+        paths.push_back(leaf_folders[next_path++]);
+    }
+    return !paths.empty();
+}
+
+bool DirectoryWork::hasItems()
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    load();
+    return next_item < items.size();
+}
+
+bool DirectoryWork::hasPaths()
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    load();
+    return next_path < manifest->leaf_folders.size();
+}
@@ -0,0 +1,156 @@
+#include "driver/impl/FileSyncEngine/DiskWriter.h"
+#include "common/DebugOutputer.h"
+
+#include <algorithm>
+#include <functional>
+
+DiskWriter::DiskWriter() : thread(&DiskWriter::run, this)
+{
+}
+
+DiskWriter::~DiskWriter()
+{
+    stop();
+}
+
+void DiskWriter::submit(Request request)
+{
+    {
+        std::unique_lock<std::mutex> lock(queue_mutex);
+        // 超过容量的单个请求在队列清空后放行
+        not_full.wait(lock, [&]()
+                      { return is_stopped || queued_size == 0 || queued_size + request.size <= queue_capacity; });
+        if (!is_stopped)
+        {
+            queued_size += request.size;
+            queue.push_back(std::move(request));
+            not_empty.notify_one();
+            return;
+        }
+    }
+    if (request.done)
+    {
+        request.done(false);
+    }
+}
+
+void DiskWriter::flush()
+{
+    std::unique_lock<std::mutex> lock(queue_mutex);
+    drained.wait(lock, [this]()
+                 { return queue.empty() && !is_writing; });
+}
+
+void DiskWriter::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        is_stopped = true;
+    }
+    not_empty.notify_all();
+    not_full.notify_all();
+    if (thread.joinable())
+    {
+        thread.join();
+    }
+}
+
+void DiskWriter::run()
+{
+    std::vector<Request> batch;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            not_empty.wait(lock, [this]()
+                           { return is_stopped || !queue.empty(); });
+            if (queue.empty())
+            {
+                break;
+            }
+            batch.swap(queue);
+            is_writing = true;
+        }
+
+        // 多个连接的条带交错到达，排序后相邻的块才能合并
+        std::stable_sort(batch.begin(), batch.end(), [](const Request &a, const Request &b)
+                         {
+            if (a.writer != b.writer)
+            {
+                return std::less<FileStreamHelper::PositionalWriter *>()(a.writer.get(), b.writer.get());
+            }
+            return a.offset < b.offset; });
+
+        size_t begin = 0;
+        while (begin < batch.size())
+        {
+            size_t end = begin + 1;
+            size_t run_size = batch[begin].size;
+            while (end < batch.size() && end - begin < max_write_segments &&
+                   batch[end].writer == batch[begin].writer &&
+                   batch[end].offset == batch[end - 1].offset + batch[end - 1].size &&
+                   run_size + batch[end].size <= max_write_size)
+            {
+                run_size += batch[end].size;
+                ++end;
+            }
+
+            bool is_ok = writeRun(batch, begin, end);
+            if (!is_ok)
+            {
+                LOG_ERROR("Failed to write " << run_size << " bytes at offset " << batch[begin].offset);
+            }
+            for (size_t i = begin; i < end; ++i)
+            {
+                if (batch[i].done)
+                {
+                    batch[i].done(is_ok);
+                }
+                // 尽早释放缓冲区
+                batch[i] = Request();
+            }
+            {
+                std::lock_guard<std::mutex> lock(queue_mutex);
+                queued_size -= run_size;
+            }
+            not_full.notify_all();
+            begin = end;
+        }
+        batch.clear();
+
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            is_writing = false;
+        }
+        drained.notify_all();
+    }
+}
+
+bool DiskWriter::writeRun(std::vector<Request> &batch, size_t begin, size_t end)
+{
+    auto &writer = batch[begin].writer;
+    if (!writer || !writer->isOpen())
+    {
+        return false;
+    }
+#ifdef __linux__
+    if (end - begin > 1)
+    {
+        std::vector<struct iovec> iov(end - begin);
+        for (size_t i = begin; i < end; ++i)
+        {
+            iov[i - begin].iov_base = const_cast<uint8_t *>(batch[i].data);
+            iov[i - begin].iov_len = batch[i].size;
+        }
+        return writer->writeAt(batch[begin].offset, iov.data(), static_cast<int>(iov.size()));
+    }
+#endif
+    for (size_t i = begin; i < end; ++i)
+    {
+        if (!writer->writeAt(batch[i].offset, batch[i].data, batch[i].size))
+        {
+            return false;
+        }
+    }
+    return true;
+}
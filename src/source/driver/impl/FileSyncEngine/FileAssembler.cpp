@@ -0,0 +1,500 @@
+#include "driver/impl/FileSyncEngine/FileAssembler.h"
+#include "control/EventBusManager.h"
+#include "driver/impl/FileUtility.h"
+#include "driver/interface/FileSyncEngine/FileSyncEngineInterface.h"
+#include "common/DebugOutputer.h"
+#include <algorithm>
+
+bool FileAssembler::open(uint32_t id, const std::wstring &path, uint64_t total_size, bool expects_root)
+{
+    std::lock_guard<std::mutex> open_lock(open_mutex);
+    {
+        std::lock_guard<std::mutex> lock(files_mutex);
+        if (receiving_files.find(id) != receiving_files.end())
+        {
+            // 其他连接已经打开
+            return true;
+        }
+    }
+
+    auto file = std::make_shared<ReceivingFile>();
+    file->journal = std::make_unique<TransferJournal>(path);
+    bool is_resume = file->journal->load(total_size);
+    if (!is_resume)
+    {
+        file->journal->reset(total_size);
+    }
+    // 续传时已写入的部分与稀疏文件的空洞都已记入日志，只需为缺失的区间留出空间
+    auto missing_ranges = file->journal->missingRanges();
+    if (!checkSpace(id, path, total_size - file->journal->committedSize()))
+    {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(files_mutex);
+    file->file_writer = std::make_shared<FileStreamHelper::PositionalWriter>(path, !is_resume);
+    if (!file->file_writer->isOpen())
+    {
+        LOG_ERROR("Failed to open: " << FileStreamHelper::wstringToLocalPath(path));
+        return false;
+    }
+    for (const auto &range : missing_ranges)
+    {
+        if (!file->file_writer->reserve(range.offset, range.length))
+        {
+            // 查询与分配之间空间被其他写入占用
+            LOG_ERROR("No space to preallocate " << range.length << " bytes at " << range.offset << " for file " << id);
+            rejected_ids.insert(id);
+            EventBusManager::instance().publish("/file/download_failed", id);
+            return false;
+        }
+    }
+    rejected_ids.erase(id);
+    file->total_size = total_size;
+    file->path = path;
+    file->merkle_root = file->journal->merkleRoot();
+    file->merkle_spans = file->journal->merkleSpans();
+    file->is_root_known = !file->merkle_root.empty();
+    if (expects_root || !file->merkle_root.empty())
+    {
+        file->verifier = std::make_unique<MerkleVerifier>(path, total_size);
+    }
+    if (total_size >= FileSyncEngineInterface::drop_behind_min_size)
+    {
+        file->write_behind = std::make_unique<WriteBehind>();
+    }
+    file->received_size = file->journal->committedSize();
+    file->checkpoint_size = file->received_size;
+    file->reported_size = file->received_size;
+    file->report_time = std::chrono::steady_clock::now();
+    if (is_resume)
+    {
+        LOG_INFO("Resume file " << id << " from " << file->received_size << "/" << total_size);
+    }
+    receiving_files[id] = file;
+    return true;
+}
+
+bool FileAssembler::checkSpace(uint32_t id, const std::wstring &path, uint64_t required_size)
+{
+    // 文件夹可能尚未创建，向上找到已存在的目录查询
+    std::error_code ec;
+    fs::path dir = fs::u8path(FileStreamHelper::wstringToLocalPath(path)).parent_path();
+    while (dir.has_relative_path() && !fs::exists(dir, ec))
+    {
+        dir = dir.parent_path();
+    }
+    uint64_t available_size = FileSystemUtils::getAvailableSpace(dir.u8string());
+    std::lock_guard<std::mutex> lock(files_mutex);
+    if (available_size >= required_size)
+    {
+        return true;
+    }
+    if (rejected_ids.insert(id).second)
+    {
+        LOG_ERROR("Not enough space for file " << id << ": need " << required_size << " bytes, " << available_size << " available");
+        EventBusManager::instance().publish("/file/download_failed", id);
+    }
+    return false;
+}
+
+void FileAssembler::logMissing(uint32_t id)
+{
+    std::lock_guard<std::mutex> lock(files_mutex);
+    if (rejected_ids.find(id) == rejected_ids.end())
+    {
+        LOG_ERROR("Receiving file not found: " << id);
+    }
+}
+
+std::shared_ptr<FileAssembler::ReceivingFile> FileAssembler::find(uint32_t id)
+{
+    std::lock_guard<std::mutex> lock(files_mutex);
+    auto it = receiving_files.find(id);
+    if (it == receiving_files.end())
+    {
+        return nullptr;
+    }
+    return it->second;
+}
+
+void FileAssembler::write(uint32_t id, uint64_t offset, const uint8_t *data, size_t size, std::vector<uint8_t> &&buffer)
+{
+    auto file = find(id);
+    if (!file)
+    {
+        logMissing(id);
+        return;
+    }
+    // 数据还在内存中，在接收线程里计算哈希，写线程只负责落盘
+    if (file->verifier)
+    {
+        file->verifier->update(offset, data, size);
+    }
+    {
+        std::lock_guard<std::mutex> lock(file->mtx);
+        ++file->pending_writes;
+    }
+
+    DiskWriter::Request request;
+    request.writer = file->file_writer;
+    request.offset = offset;
+    request.data = data;
+    request.size = size;
+    request.buffer = std::move(buffer);
+    request.done = [this, id, file, offset, size](bool is_ok)
+    {
+        if (!is_ok)
+        {
+            // 未记入日志，续传时重新请求该区间
+            LOG_ERROR("Failed to write file " << id << " at offset " << offset);
+            std::lock_guard<std::mutex> lock(file->mtx);
+            --file->pending_writes;
+            file->writes_done.notify_all();
+            return;
+        }
+        onWritten(id, *file, offset, size, true);
+    };
+    disk_writer.submit(std::move(request));
+}
+
+bool FileAssembler::receive(uint32_t id, uint64_t offset, size_t size,
+                            const std::function<bool(FileStreamHelper::PositionalWriter *)> &fill, const uint8_t *data)
+{
+    auto file = find(id);
+    if (!file)
+    {
+        logMissing(id);
+        return fill(nullptr);
+    }
+
+    // 定位写入互不影响，无需持锁
+    if (!fill(file->file_writer.get()))
+    {
+        LOG_ERROR("Failed to write file " << id << " at offset " << offset);
+        return false;
+    }
+    if (file->verifier)
+    {
+        file->verifier->update(offset, data, size);
+    }
+    onWritten(id, *file, offset, size, false);
+    return true;
+}
+
+void FileAssembler::onWritten(uint32_t id, ReceivingFile &file, uint64_t offset, size_t size, bool is_async)
+{
+    bool is_complete = false;
+    bool should_report = false;
+    uint8_t progress = 0;
+    uint32_t speed_bps = 0;
+    if (file.write_behind)
+    {
+        // 可能等待更早的区间回写，不持有file.mtx，其他线程的提交不受影响
+        file.write_behind->onWritten(*file.file_writer, offset, size);
+    }
+    {
+        std::lock_guard<std::mutex> lock(file.mtx);
+        if (is_async)
+        {
+            // 与日志提交在同一临界区内减少，finish等到计数归零后删除日志时不会再有保存
+            --file.pending_writes;
+            file.writes_done.notify_all();
+        }
+        if (file.is_finished)
+        {
+            return;
+        }
+        // 只统计新覆盖的字节，重传的区间不会重复计数
+        file.journal->commit(offset, size);
+        file.received_size = file.journal->committedSize();
+        if (file.received_size - file.checkpoint_size >= checkpoint_interval)
+        {
+            file.journal->save();
+            file.checkpoint_size = file.received_size;
+        }
+
+        if (file.received_size >= file.total_size)
+        {
+            is_complete = true;
+        }
+        else if (++file.progress_count >= 40)
+        {
+            auto now = std::chrono::steady_clock::now();
+            auto elapsed_us = std::chrono::duration_cast<std::chrono::microseconds>(now - file.report_time);
+            if (elapsed_us.count() > 0)
+            {
+                speed_bps = static_cast<uint32_t>(((file.received_size - file.reported_size) * 1000000ULL) /
+                                                  static_cast<uint64_t>(elapsed_us.count()));
+            }
+            file.reported_size = file.received_size;
+            file.report_time = now;
+            file.progress_count = 0;
+            progress = static_cast<uint8_t>((file.received_size * 100 + file.total_size / 2) / file.total_size);
+            should_report = true;
+        }
+    }
+
+    if (is_complete)
+    {
+        onReceived(id);
+    }
+    else if (should_report)
+    {
+        EventBusManager::instance().publish("/file/download_progress", id, progress, speed_bps, false);
+    }
+}
+
+void FileAssembler::onReceived(uint32_t id)
+{
+    auto file = find(id);
+    if (!file)
+    {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(file->mtx);
+        if (file->verifier && !file->is_root_known)
+        {
+            // 根随file_end或file_root到达
+            file->is_received = true;
+            return;
+        }
+    }
+    finish(id);
+}
+
+void FileAssembler::finish(uint32_t id, const std::string &merkle_root, const std::string &merkle_spans)
+{
+    std::shared_ptr<ReceivingFile> file;
+    {
+        std::lock_guard<std::mutex> lock(files_mutex);
+        auto it = receiving_files.find(id);
+        if (it == receiving_files.end())
+        {
+            // 已经完成
+            return;
+        }
+        file = std::move(it->second);
+        receiving_files.erase(it);
+    }
+    {
+        std::unique_lock<std::mutex> lock(file->mtx);
+        // file_end可能先于同一连接之前的块落盘；写线程中收满时剩下的只可能是重复的块，不能等待自己
+        if (!disk_writer.isWriterThread())
+        {
+            file->writes_done.wait(lock, [&file]()
+                                   { return file->pending_writes == 0; });
+        }
+        file->is_finished = true;
+        if (!merkle_root.empty())
+        {
+            file->merkle_root = merkle_root;
+            file->merkle_spans = merkle_spans;
+        }
+        file->journal->remove();
+    }
+    if (file->write_behind)
+    {
+        file->write_behind->finish(*file->file_writer);
+    }
+    if (!verify(id, *file))
+    {
+        return;
+    }
+    // 其他连接持有的引用释放后文件自动关闭
+    file.reset();
+    EventBusManager::instance().publish("/file/download_progress", id,
+                                        static_cast<uint8_t>(100), static_cast<uint32_t>(0), true);
+}
+
+void FileAssembler::setMerkleRoot(uint32_t id, const std::string &merkle_root, const std::string &merkle_spans)
+{
+    auto file = find(id);
+    if (!file)
+    {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(file->mtx);
+        file->merkle_root = merkle_root;
+        file->merkle_spans = merkle_spans;
+        file->is_root_known = true;
+        // 之后中断时续传仍可校验
+        file->journal->setMerkleRoot(merkle_root);
+        file->journal->setMerkleSpans(merkle_spans);
+        if (!file->is_received)
+        {
+            return;
+        }
+    }
+    finish(id);
+}
+
+bool FileAssembler::verify(uint32_t id, ReceivingFile &file)
+{
+    if (!file.verifier)
+    {
+        return true;
+    }
+    if (file.merkle_root.empty())
+    {
+        LOG_ERROR("No merkle root for file " << id << ", skip verification");
+        return true;
+    }
+    std::string actual_root = file.verifier->finish();
+    bool should_retry = false;
+    {
+        std::lock_guard<std::mutex> lock(files_mutex);
+        if (actual_root == file.merkle_root)
+        {
+            verify_failed_ids.erase(id);
+        }
+        else
+        {
+            should_retry = verify_failed_ids.insert(id).second;
+        }
+    }
+    if (actual_root == file.merkle_root)
+    {
+        LOG_INFO("Verified file " << id);
+        return true;
+    }
+
+    std::error_code ec;
+    if (!should_retry)
+    {
+        // 损坏的文件不能作为下载结果，也不能再作为分块或增量的来源
+        LOG_ERROR("Merkle root mismatch for file " << id << " again, discard the received file");
+        {
+            std::lock_guard<std::mutex> lock(files_mutex);
+            verify_failed_ids.erase(id);
+        }
+        fs::remove(fs::u8path(FileStreamHelper::wstringToLocalPath(file.path)), ec);
+        EventBusManager::instance().publish("/file/download_failed", id);
+        return false;
+    }
+
+    // 一致的段记为已接收，续传时只请求不一致的段，根与摘要留在日志中供再次校验
+    auto bad_ranges = file.verifier->mismatchedRanges(file.merkle_spans);
+    file.journal->reset(file.total_size);
+    uint64_t offset = 0;
+    uint64_t bad_size = 0;
+    for (const auto &[bad_offset, bad_length] : bad_ranges)
+    {
+        file.journal->commit(offset, bad_offset - offset);
+        offset = bad_offset + bad_length;
+        bad_size += bad_length;
+    }
+    file.journal->commit(offset, file.total_size - offset);
+    file.journal->setMerkleRoot(file.merkle_root);
+    file.journal->setMerkleSpans(file.merkle_spans);
+    if (!file.journal->save())
+    {
+        fs::remove(fs::u8path(FileStreamHelper::wstringToLocalPath(file.path)), ec);
+    }
+    LOG_ERROR("Merkle root mismatch for file " << id << ", request " << bad_size << "/" << file.total_size << " bytes again");
+    EventBusManager::instance().publish("/file/send_get_file", id);
+    return false;
+}
+
+bool FileAssembler::openFolder(uint32_t id, const std::wstring &dir_path, uint64_t total_size, uint32_t part_count)
+{
+    std::lock_guard<std::mutex> open_lock(open_mutex);
+    {
+        std::lock_guard<std::mutex> lock(folders_mutex);
+        if (receiving_folders.find(id) != receiving_folders.end())
+        {
+            // 其他连接的部分已经打开
+            return true;
+        }
+    }
+    if (!checkSpace(id, dir_path, total_size))
+    {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(folders_mutex);
+    ReceivingFolder &folder = receiving_folders[id];
+    folder.total_size = total_size;
+    folder.remaining_parts = (std::max)(part_count, 1u);
+    folder.report_time = std::chrono::steady_clock::now();
+    return true;
+}
+
+void FileAssembler::addFolderReceived(uint32_t id, uint64_t size)
+{
+    uint8_t progress = 0;
+    uint32_t speed_bps = 0;
+    {
+        std::lock_guard<std::mutex> lock(folders_mutex);
+        auto it = receiving_folders.find(id);
+        if (it == receiving_folders.end())
+        {
+            return;
+        }
+        ReceivingFolder &folder = it->second;
+        folder.received_size += size;
+        if (++folder.progress_count < 40 || folder.total_size == 0)
+        {
+            return;
+        }
+        auto now = std::chrono::steady_clock::now();
+        auto elapsed_us = std::chrono::duration_cast<std::chrono::microseconds>(now - folder.report_time);
+        if (elapsed_us.count() > 0)
+        {
+            speed_bps = static_cast<uint32_t>(((folder.received_size - folder.reported_size) * 1000000ULL) /
+                                              static_cast<uint64_t>(elapsed_us.count()));
+        }
+        folder.reported_size = folder.received_size;
+        folder.report_time = now;
+        folder.progress_count = 0;
+        uint64_t effective_size = (std::min)(folder.received_size, folder.total_size);
+        progress = static_cast<uint8_t>((effective_size * 100 + folder.total_size / 2) / folder.total_size);
+    }
+    EventBusManager::instance().publish("/file/download_progress", id, progress, speed_bps, false);
+}
+
+void FileAssembler::finishFolderPart(uint32_t id)
+{
+    {
+        std::lock_guard<std::mutex> lock(folders_mutex);
+        auto it = receiving_folders.find(id);
+        if (it == receiving_folders.end())
+        {
+            return;
+        }
+        if (--it->second.remaining_parts > 0)
+        {
+            return;
+        }
+        receiving_folders.erase(it);
+    }
+    EventBusManager::instance().publish("/file/download_progress", id,
+                                        static_cast<uint8_t>(100), static_cast<uint32_t>(0), true);
+}
+
+void FileAssembler::close()
+{
+    // 队列中的块先落盘，保存的日志才包含它们
+    disk_writer.flush();
+    std::map<uint32_t, std::shared_ptr<ReceivingFile>> unfinished_files;
+    {
+        std::lock_guard<std::mutex> lock(files_mutex);
+        unfinished_files.swap(receiving_files);
+    }
+    {
+        std::lock_guard<std::mutex> lock(folders_mutex);
+        receiving_folders.clear();
+    }
+    for (auto &[id, file] : unfinished_files)
+    {
+        std::lock_guard<std::mutex> lock(file->mtx);
+        file->journal->save();
+        LOG_INFO("Save journal of file " << id << ": " << file->received_size << "/" << file->total_size);
+    }
+}
+
+FileAssembler::~FileAssembler()
+{
+    close();
+}
@@ -2,11 +2,14 @@
 #include "driver/interface/FileSyncEngine/FileSyncEngineInterface.h"
 #include "driver/impl/Nlohmann.h"
 #include "driver/impl/FileUtility.h"
+#include "driver/impl/FileSyncEngine/TransferJournal.h"
 #include "driver/interface/FileStreamHelper.h"
 
 #include <algorithm>
+#include <cstring>
 
-FileMsgBuilder::FileMsgBuilder() : json_builder(std::make_unique<NlohmannJson>())
+FileMsgBuilder::FileMsgBuilder(size_t read_ahead_depth) : json_builder(std::make_unique<NlohmannJson>()),
+                                                          block_reader(std::make_unique<BlockReader>(read_ahead_depth))
 {
 }
 
@@ -14,14 +17,19 @@ std::unique_ptr<std::vector<uint8_t>> FileMsgBuilder::buildHeader()
 {
     if (is_folder && file_state == State::Default) // 第一次消息且是文件夹则发送文件夹元信息
     {
-        uint32_t total_paths = 0;
-        dir_total_size = FileSystemUtils::calculateFolderSize(file_path);
-        auto leaf_paths = FileSystemUtils::vectorToJsonString(FileSystemUtils::findAllLeafFolders(file_path, total_paths));
+        // 未分配共享工作队列时整个文件夹由当前连接发送
+        if (!dir_work)
+        {
+            dir_work = std::make_shared<DirectoryWork>(file_path, 1);
+        }
+        // 头部只带汇总信息，叶子目录随后分批发送
+        dir_total_size = dir_work->totalSize();
+        path_turn = false;
         auto json = json_builder->getBuilder(Json::BuilderType::File);
         std::string json_str = json->buildFileMsg(Json::MessageType::File::DirectoryHeader, {{"id", std::to_string(file_id)},
-                                                                                             {"leaf_paths", std::move(leaf_paths)},
-                                                                                             {"total_paths", std::to_string(total_paths)},
-                                                                                             {"total_size", std::to_string(dir_total_size)}});
+                                                                                             {"total_paths", std::to_string(dir_work->totalPaths())},
+                                                                                             {"total_size", std::to_string(dir_total_size)},
+                                                                                             {"part_count", std::to_string(dir_work->partCount())}});
         auto result = std::make_unique<std::vector<uint8_t>>();
         result->reserve(json_str.size());
         std::transform(json_str.begin(), json_str.end(),
@@ -29,29 +37,32 @@ std::unique_ptr<std::vector<uint8_t>> FileMsgBuilder::buildHeader()
                        [](char c)
                        { return static_cast<uint8_t>(c); });
         file_state = State::Header;
-        dir_items = FileSystemUtils::findAllLeafFiles(file_path);
         return result;
     }
     else if (!is_folder && file_state == State::Default) // 不是文件夹且是第一次消息，发送文件元消息
     {
-        // 使用跨平台方式创建文件流
+        // 使用跨平台方式打开文件，预读线程随即开始读取
         std::wstring wpath = FileSystemUtils::utf8ToWide(file_path);
-        file_reader = FileStreamHelper::createInputFileStream(wpath);
+        file_total_size = FileSystemUtils::getFileSize(file_path);
+        block_size = preferred_block_size;
 
-        if (!file_reader || !file_reader->is_open())
+        if (!openSource(wpath, 0, file_total_size, file_total_size))
         {
             std::error_code ec(errno, std::generic_category());
             LOG_ERROR("Failed to open file: " << FileStreamHelper::wstringToLocalPath(wpath)
                                               << " - Error: " << ec.message());
         }
 
-        file_total_size = FileSystemUtils::getFileSize(file_path);
-        uint64_t total_blocks = (file_total_size + FileSyncEngineInterface::file_block_size - 1) / FileSyncEngineInterface::file_block_size;
+        block_index = 0;
+        beginMerkleRoot(wpath);
+        uint64_t total_blocks = (file_total_size + block_size - 1) / block_size;
         auto json = json_builder->getBuilder(Json::BuilderType::File);
         std::string json_str = json->buildFileMsg(Json::MessageType::File::FileHeader, {
                                                                                            {"id", std::to_string(file_id)},
                                                                                            {"total_size", std::to_string(file_total_size)},
                                                                                            {"total_blocks", std::to_string(total_blocks)},
+                                                                                           {"block_size", std::to_string(block_size)},
+                                                                                           {"merkle_leaf_size", std::to_string(MerkleTree::leaf_size)},
                                                                                        });
         auto result = std::make_unique<std::vector<uint8_t>>();
         result->reserve(json_str.size());
@@ -62,46 +73,115 @@ std::unique_ptr<std::vector<uint8_t>> FileMsgBuilder::buildHeader()
         file_state = State::Block;
         return result;
     }
-    else if (is_folder && file_state == State::Header) // 是文件夹且需要发送Header，则发送文件项的元信息
+    return nullptr;
+}
+
+std::unique_ptr<std::vector<uint8_t>> FileMsgBuilder::buildItemHeader(const DirectoryManifest::FileEntry &item)
+{
+    const std::string &current_file = item.path;
+
+    std::wstring wpath = FileSystemUtils::utf8ToWide(current_file);
+    file_total_size = FileSystemUtils::getFileSize(current_file);
+    block_size = preferred_block_size;
+
+    if (!openSource(wpath, 0, file_total_size, file_total_size))
     {
-        if (dir_file_index >= dir_items.size())
-        {
-            return nullptr;
-        }
+        // 如果文件打开失败，跳过这个文件
+        LOG_ERROR("Failed to open file: " << FileStreamHelper::wstringToLocalPath(wpath));
+        file_total_size = 0;
+        file_sended_size = 0;
+        return nullptr;
+    }
 
-        std::string current_file = dir_items[dir_file_index++];
+    block_index = 0;
+    uint64_t total_blocks = (file_total_size + block_size - 1) / block_size;
+    auto json = json_builder->getBuilder(Json::BuilderType::File);
+    std::string json_str = json->buildFileMsg(Json::MessageType::File::DirectoryItemHeader, {
+                                                                                                {"id", std::to_string(file_id)},
+                                                                                                {"total_size", std::to_string(file_total_size)},
+                                                                                                {"path", FileSystemUtils::absoluteToRelativePath(current_file, file_path)},
+                                                                                                {"total_blocks", std::to_string(total_blocks)},
+                                                                                                {"block_size", std::to_string(block_size)},
+                                                                                            });
+    auto result = std::make_unique<std::vector<uint8_t>>();
+    result->reserve(json_str.size());
+    std::transform(json_str.begin(), json_str.end(),
+                   std::back_inserter(*result),
+                   [](char c)
+                   { return static_cast<uint8_t>(c); });
+    file_state = State::Block;
+    return result;
+}
 
-        std::wstring wpath = FileSystemUtils::utf8ToWide(current_file);
-        file_reader = FileStreamHelper::createInputFileStream(wpath);
+std::unique_ptr<std::vector<uint8_t>> FileMsgBuilder::buildStripeHeader()
+{
+    // 条带起点必须落在块边界上
+    block_size = preferred_block_size;
+    while (block_size > FileSyncEngineInterface::min_block_size && stripe_offset % block_size != 0)
+    {
+        block_size /= 2;
+    }
+    std::wstring wpath = FileSystemUtils::utf8ToWide(file_path);
+    if (!openSource(wpath, stripe_offset, stripe_length, FileSystemUtils::getFileSize(file_path)))
+    {
+        std::error_code ec(errno, std::generic_category());
+        LOG_ERROR("Failed to open file: " << FileStreamHelper::wstringToLocalPath(wpath)
+                                          << " - Error: " << ec.message());
+    }
 
-        if (!file_reader || !file_reader->is_open())
-        {
-            LOG_ERROR("Failed to open file: " << FileStreamHelper::wstringToLocalPath(wpath));
-            // 如果文件打开失败，跳过这个文件
-            file_total_size = 0;
-            file_sended_size = 0;
-            return buildHeader(); // 尝试下一个文件
-        }
+    // 条带内按普通文件发送，file_total_size为条带长度，块索引从条带起点所在块开始
+    file_total_size = stripe_length;
+    block_index = stripe_offset / block_size;
+    std::map<std::string, std::string> args{{"id", std::to_string(file_id)},
+                                            {"total_size", std::to_string(FileSystemUtils::getFileSize(file_path))},
+                                            {"offset", std::to_string(stripe_offset)},
+                                            {"size", std::to_string(stripe_length)},
+                                            {"block_size", std::to_string(block_size)}};
+    if (is_stripe_root)
+    {
+        args["merkle_leaf_size"] = std::to_string(MerkleTree::leaf_size);
+    }
+    auto json = json_builder->getBuilder(Json::BuilderType::File);
+    std::string json_str = json->buildFileMsg(Json::MessageType::File::FileStripe, std::move(args));
+    auto result = std::make_unique<std::vector<uint8_t>>();
+    result->reserve(json_str.size());
+    std::transform(json_str.begin(), json_str.end(),
+                   std::back_inserter(*result),
+                   [](char c)
+                   { return static_cast<uint8_t>(c); });
+    file_state = State::Block;
+    return result;
+}
 
-        file_total_size = FileSystemUtils::getFileSize(current_file);
-        uint64_t total_blocks = (file_total_size + FileSyncEngineInterface::file_block_size - 1) / FileSyncEngineInterface::file_block_size;
-        auto json = json_builder->getBuilder(Json::BuilderType::File);
-        std::string json_str = json->buildFileMsg(Json::MessageType::File::DirectoryItemHeader, {
-                                                                                                    {"id", std::to_string(file_id)},
-                                                                                                    {"total_size", std::to_string(file_total_size)},
-                                                                                                    {"path", FileSystemUtils::absoluteToRelativePath(current_file, file_path)},
-                                                                                                    {"total_blocks", std::to_string(total_blocks)},
-                                                                                                });
-        auto result = std::make_unique<std::vector<uint8_t>>();
-        result->reserve(json_str.size());
-        std::transform(json_str.begin(), json_str.end(),
-                       std::back_inserter(*result),
-                       [](char c)
-                       { return static_cast<uint8_t>(c); });
-        file_state = State::Block;
-        return result;
+bool FileMsgBuilder::openSource(const std::wstring &wpath, uint64_t offset, uint64_t length, uint64_t file_size)
+{
+    bool drop_behind = file_size >= FileSyncEngineInterface::drop_behind_min_size;
+    if (!zero_copy)
+    {
+        return block_reader->open(wpath, offset, length, block_size, drop_behind);
     }
-    return nullptr;
+    source_file = std::make_unique<FileStreamHelper::PositionalReader>(wpath);
+    if (!source_file->isOpen())
+    {
+        source_file.reset();
+        return false;
+    }
+    source_file->adviseSequential(offset, length);
+    is_drop_behind = drop_behind;
+    drop_offset = offset;
+    drop_end = offset;
+    return true;
+}
+
+void FileMsgBuilder::closeSource()
+{
+    block_reader->close();
+    if (source_file && is_drop_behind && drop_end > drop_offset)
+    {
+        source_file->adviseDontNeed(drop_offset, drop_end - drop_offset);
+    }
+    is_drop_behind = false;
+    source_file.reset();
 }
 
 std::unique_ptr<std::vector<uint8_t>> FileMsgBuilder::buildBlock()
@@ -112,64 +192,284 @@ std::unique_ptr<std::vector<uint8_t>> FileMsgBuilder::buildBlock()
         return nullptr;
     }
 
-    constexpr uint32_t HEADER_SIZE = sizeof(file_id);
-    uint32_t offset = 0;
+    constexpr uint32_t HEADER_SIZE = FileSyncEngineInterface::block_header_size;
 
-    // 计算本次可读取的数据大小
-    uint64_t remaining_data = file_total_size - file_sended_size;
-    uint64_t max_data_size = FileSyncEngineInterface::file_block_size - HEADER_SIZE;
-    uint64_t ready_to_read_size = (std::min)(remaining_data, max_data_size);
+    std::unique_ptr<std::vector<uint8_t>> result;
+    uint64_t bytes_read = 0;
+    if (zero_copy)
+    {
+        // 只构造块前缀，载荷位置交给发送端
+        if (!source_file)
+        {
+            file_state = State::End;
+            return nullptr;
+        }
+        bytes_read = (std::min)(file_total_size - file_sended_size, static_cast<uint64_t>(block_size));
+        result = std::make_unique<std::vector<uint8_t>>(HEADER_SIZE);
+        source_offset = FileSyncEngineInterface::blockOffset(static_cast<uint32_t>(block_index), block_size);
+        source_length = static_cast<uint32_t>(bytes_read);
+        // 取下一块时之前的块已由发送端交给sendfile
+        if (is_drop_behind && source_offset >= drop_offset + FileSyncEngineInterface::drop_behind_window)
+        {
+            source_file->adviseDontNeed(drop_offset, source_offset - drop_offset);
+            drop_offset = source_offset;
+        }
+        drop_end = source_offset + source_length;
+    }
+    else
+    {
+        // 取预读线程已经读好的块，块前预留了前缀空间
+        result = block_reader->next();
+        if (!result)
+        {
+            // 无法读取数据，转到结束状态
+            file_state = State::End;
+            return nullptr;
+        }
+        bytes_read = result->size() - HEADER_SIZE;
+    }
 
-    // 创建数据块（实际大小 = 头部 + 数据）
-    uint64_t total_block_size = HEADER_SIZE + ready_to_read_size;
-    auto result = std::make_unique<std::vector<uint8_t>>(total_block_size);
+    file_sended_size += bytes_read;
+    if (is_folder)
+    {
+        dir_sended_size += bytes_read;
+    }
 
-    // 写入文件 ID 头部
-    memcpy(result->data() + offset, &file_id, HEADER_SIZE);
-    offset += HEADER_SIZE;
+    // 写入块前缀，接收端据此定位写入
+    FileSyncEngineInterface::FileBlock block{file_id, static_cast<uint32_t>(block_index++),
+                                             static_cast<uint32_t>(bytes_read), nullptr};
+    FileSyncEngineInterface::writeBlockHeader(result->data(), block);
 
-    // 读取文件数据
-    if (ready_to_read_size > 0 && file_reader && file_reader->is_open())
+    // 检查是否到达文件末尾
+    if (file_sended_size >= file_total_size)
     {
-        file_reader->read(reinterpret_cast<char *>(result->data() + offset),
-                          ready_to_read_size);
+        file_state = State::End;
+    }
+    return result;
+}
 
-        // 检查实际读取的字节数
-        std::streamsize bytes_read = file_reader->gcount();
-        if (is_folder)
+std::unique_ptr<std::vector<uint8_t>> FileMsgBuilder::buildPack()
+{
+    constexpr uint32_t HEADER_SIZE = FileSyncEngineInterface::block_header_size;
+    std::vector<uint8_t> table(sizeof(uint32_t));
+    std::vector<uint8_t> contents;
+    uint32_t item_count = 0;
+
+    DirectoryManifest::FileEntry item;
+    while (item_count < FileSyncEngineInterface::pack_max_items)
+    {
+        uint64_t max_size = FileSyncEngineInterface::pack_item_max_size;
+        if (item_count > 0)
         {
-            dir_sended_size += bytes_read;
+            if (contents.size() >= FileSyncEngineInterface::pack_max_size)
+            {
+                break;
+            }
+            max_size = (std::min)(max_size, FileSyncEngineInterface::pack_max_size - contents.size());
         }
-        else
+        if (!dir_work->takeItem(item, max_size))
         {
-            file_sended_size += bytes_read;
+            break;
         }
+        const std::string &current_file = item.path;
+        uint64_t item_size = item.size;
 
-        // 如果读取的字节数少于预期，调整向量大小
-        if (bytes_read < static_cast<std::streamsize>(ready_to_read_size))
+        std::wstring wpath = FileSystemUtils::utf8ToWide(current_file);
+        FileStreamHelper::PositionalReader reader(wpath);
+        if (!reader.isOpen())
         {
-            result->resize(HEADER_SIZE + bytes_read);
+            // 打开失败则跳过这个文件
+            LOG_ERROR("Failed to open file: " << FileStreamHelper::wstringToLocalPath(wpath));
+            continue;
         }
+        size_t content_offset = contents.size();
+        contents.resize(content_offset + item_size);
+        uint32_t bytes_read = static_cast<uint32_t>(reader.readAt(0, contents.data() + content_offset, item_size));
+        contents.resize(content_offset + bytes_read);
+
+        std::string relative_path = FileSystemUtils::absoluteToRelativePath(current_file, file_path);
+        uint32_t path_size = static_cast<uint32_t>(relative_path.size());
+        size_t table_offset = table.size();
+        table.resize(table_offset + sizeof(uint32_t) * 2 + path_size);
+        memcpy(table.data() + table_offset, &path_size, sizeof(path_size));
+        memcpy(table.data() + table_offset + sizeof(uint32_t), &bytes_read, sizeof(bytes_read));
+        memcpy(table.data() + table_offset + sizeof(uint32_t) * 2, relative_path.data(), path_size);
+        ++item_count;
+        dir_sended_size += bytes_read;
+    }
+
+    if (item_count == 0)
+    {
+        return nullptr;
+    }
+    memcpy(table.data(), &item_count, sizeof(item_count));
 
-        // 检查是否到达文件末尾
-        if (file_reader->eof() || file_sended_size >= file_total_size)
+    auto result = std::make_unique<std::vector<uint8_t>>(HEADER_SIZE);
+    result->reserve(HEADER_SIZE + table.size() + contents.size());
+    result->insert(result->end(), table.begin(), table.end());
+    result->insert(result->end(), contents.begin(), contents.end());
+    FileSyncEngineInterface::FileBlock block{file_id, FileSyncEngineInterface::pack_block_index,
+                                             static_cast<uint32_t>(result->size() - HEADER_SIZE), nullptr};
+    FileSyncEngineInterface::writeBlockHeader(result->data(), block);
+    return result;
+}
+
+std::unique_ptr<std::vector<uint8_t>> FileMsgBuilder::buildDirPaths()
+{
+    std::vector<std::string> paths;
+    if (!dir_work->takePaths(paths, FileSyncEngineInterface::dir_paths_max_items, FileSyncEngineInterface::dir_paths_max_bytes))
+    {
+        return nullptr;
+    }
+    auto json = json_builder->getBuilder(Json::BuilderType::File);
+    std::string json_str = json->buildFileListMsg(Json::MessageType::File::DirectoryPaths,
+                                                  {{"id", std::to_string(file_id)}}, std::move(paths));
+    return std::make_unique<std::vector<uint8_t>>(json_str.begin(), json_str.end());
+}
+
+FileMsgBuilderInterface::FileMsgBuilderResult FileMsgBuilder::buildNextItem(uint8_t progress)
+{
+    file_state = State::Header;
+    // 目录批次与目录项交替发送，接收端建目录与写数据重叠进行
+    path_turn = !path_turn;
+    if (path_turn || !dir_work->hasItems())
+    {
+        auto paths = buildDirPaths();
+        if (paths)
         {
-            file_state = State::End;
+            return {false, progress, std::move(paths)};
         }
     }
-    else
+    // 连续的小文件一帧打包发送，省去每个文件的目录项头与文件块
+    auto pack = buildPack();
+    if (pack)
+    {
+        return {true, calculateProgress(), std::move(pack)};
+    }
+    // 其余目录项逐个发送，打开失败的跳过
+    DirectoryManifest::FileEntry item;
+    while (dir_work->takeItem(item))
+    {
+        auto header = buildItemHeader(item);
+        if (header)
+        {
+            return {false, progress, std::move(header)};
+        }
+    }
+    // 其他连接领完了目录项，剩余的叶子目录由本连接发完
+    auto paths = buildDirPaths();
+    if (paths)
+    {
+        return {false, progress, std::move(paths)};
+    }
+    return finishTransfer(progress);
+}
+
+std::unique_ptr<std::vector<uint8_t>> FileMsgBuilder::buildChunkBatch(bool is_first)
+{
+    std::vector<ContentChunker::Chunk> batch;
+    manifest_stream->next(batch, FileSyncEngineInterface::chunk_batch_size);
+    std::vector<std::string> chunks;
+    chunks.reserve(batch.size());
+    for (const auto &chunk : batch)
+    {
+        chunks.push_back(ContentChunker::chunkToString(chunk));
+    }
+    // 块数恰好是整批时，最后一条清单可能不带块
+    bool is_last = manifest_stream->isFinished();
+    std::map<std::string, std::string> args{{"id", std::to_string(file_id)},
+                                            {"total_size", std::to_string(file_total_size)},
+                                            {"is_last", is_last ? "1" : "0"}};
+    if (is_first && !manifest_stream->holes().empty())
     {
-        // 无法读取数据，转到结束状态
-        result.reset();
+        // 接收端在第一条清单时创建文件，空洞不预分配也不请求
+        std::vector<TransferJournal::Range> holes;
+        holes.reserve(manifest_stream->holes().size());
+        for (const auto &hole : manifest_stream->holes())
+        {
+            holes.push_back({hole.first, hole.second});
+        }
+        args["holes"] = TransferJournal::rangesToString(holes);
+    }
+    if (is_last)
+    {
+        // 接收端收齐缺失区间后据此校验整个文件
+        std::string root = manifest_merkle->finish();
+        if (!root.empty())
+        {
+            args["merkle_root"] = std::move(root);
+            args["merkle_spans"] = manifest_merkle->spans();
+        }
         file_state = State::End;
     }
-    return result;
+    auto json = json_builder->getBuilder(Json::BuilderType::File);
+    std::string json_str = json->buildFileListMsg(Json::MessageType::File::FileChunks, std::move(args), std::move(chunks));
+    return std::make_unique<std::vector<uint8_t>>(json_str.begin(), json_str.end());
+}
+
+std::unique_ptr<std::vector<uint8_t>> FileMsgBuilder::buildDeltaHeader()
+{
+    delta_encoder = std::make_unique<DeltaEncoder>(delta_signature, FileSystemUtils::utf8ToWide(file_path));
+    if (!delta_encoder->isOpen())
+    {
+        // 打开失败时按普通文件发送
+        LOG_ERROR("Failed to open file: " << file_path);
+        delta_encoder.reset();
+        delta_signature.reset();
+        return nullptr;
+    }
+    is_folder = false;
+    file_total_size = delta_encoder->fileSize();
+    file_sended_size = 0;
+    block_size = preferred_block_size;
+    auto json = json_builder->getBuilder(Json::BuilderType::File);
+    std::string json_str = json->buildFileMsg(Json::MessageType::File::FileDelta, {
+                                                                                      {"id", std::to_string(file_id)},
+                                                                                      {"total_size", std::to_string(file_total_size)},
+                                                                                      {"block_size", std::to_string(delta_signature->block_size)},
+                                                                                  });
+    file_state = State::Block;
+    return std::make_unique<std::vector<uint8_t>>(json_str.begin(), json_str.end());
+}
+
+FileMsgBuilderInterface::FileMsgBuilderResult FileMsgBuilder::buildDeltaFrame()
+{
+    constexpr uint32_t HEADER_SIZE = FileSyncEngineInterface::block_header_size;
+    // 每帧的指令约为一个块大小，与普通文件块的发送节奏一致
+    auto result = std::make_unique<std::vector<uint8_t>>(HEADER_SIZE);
+    if (!delta_encoder->next(*result, block_size))
+    {
+        std::string file_hash = delta_encoder->fileHash();
+        return finishTransfer(100, {{"id", std::to_string(file_id)}, {"sha256", file_hash}});
+    }
+    file_sended_size = delta_encoder->consumedSize();
+    FileSyncEngineInterface::FileBlock block{file_id, FileSyncEngineInterface::delta_block_index,
+                                             static_cast<uint32_t>(result->size() - HEADER_SIZE), nullptr};
+    FileSyncEngineInterface::writeBlockHeader(result->data(), block);
+    return {true, calculateProgress(), std::move(result)};
+}
+
+FileMsgBuilderInterface::FileMsgBuilderResult FileMsgBuilder::finishTransfer(uint8_t progress, std::map<std::string, std::string> end_args)
+{
+    file_state = State::Default;
+    is_end = true;
+    if (is_folder)
+    {
+        dir_sended_size = 0;
+        dir_total_size = 0;
+    }
+    else
+    {
+        file_sended_size = 0;
+        file_total_size = 0;
+    }
+    return {false, progress, buildEnd(std::move(end_args))};
 }
 
-std::unique_ptr<std::vector<uint8_t>> FileMsgBuilder::buildEnd()
+std::unique_ptr<std::vector<uint8_t>> FileMsgBuilder::buildEnd(std::map<std::string, std::string> args)
 {
     auto json = json_builder->getBuilder(Json::BuilderType::File);
-    std::string json_str = json->buildFileMsg(Json::MessageType::File::FileEnd, {});
+    std::string json_str = json->buildFileMsg(Json::MessageType::File::FileEnd, std::move(args));
     auto result = std::make_unique<std::vector<uint8_t>>();
     result->reserve(json_str.size());
     std::transform(json_str.begin(), json_str.end(),
@@ -181,13 +481,41 @@ std::unique_ptr<std::vector<uint8_t>> FileMsgBuilder::buildEnd()
     file_sended_size = 0;
 
     // 清理文件流
-    file_reader.reset();
-    dir_file_index = 0;
-    dir_items.clear();
+    closeSource();
+    dir_work.reset();
+    delta_encoder.reset();
 
     return result;
 }
 
+std::unique_ptr<std::vector<uint8_t>> FileMsgBuilder::buildStripeRoot(const std::string &merkle_root, const std::string &merkle_spans)
+{
+    auto json = json_builder->getBuilder(Json::BuilderType::File);
+    std::string json_str = json->buildFileMsg(Json::MessageType::File::FileRoot, {{"id", std::to_string(file_id)},
+                                                                                   {"merkle_root", merkle_root},
+                                                                                   {"merkle_spans", merkle_spans}});
+    return std::make_unique<std::vector<uint8_t>>(json_str.begin(), json_str.end());
+}
+
+void FileMsgBuilder::beginMerkleRoot(const std::wstring &wpath)
+{
+    merkle_root = std::async(std::launch::async, &MerkleTree::computeFile, wpath, nullptr);
+}
+
+void FileMsgBuilder::appendMerkleRoot(std::map<std::string, std::string> &args)
+{
+    if (!merkle_root.valid())
+    {
+        return;
+    }
+    MerkleTree::FileRoot root = merkle_root.get();
+    if (!root.root.empty())
+    {
+        args["merkle_root"] = std::move(root.root);
+        args["merkle_spans"] = std::move(root.spans);
+    }
+}
+
 uint8_t FileMsgBuilder::calculateProgress()
 {
     if (is_folder)
@@ -221,42 +549,103 @@ FileMsgBuilderInterface::FileMsgBuilderResult FileMsgBuilder::getStream()
         is_end = false; // 重置
         return {false, 100, nullptr};
     }
+    if (is_chunk_manifest)
+    {
+        if (file_state == State::Default)
+        {
+            // 每次只分一批块就发出，叶子哈希在分块读取的同一遍中计算；打开失败时按普通文件发送
+            std::wstring wpath = FileSystemUtils::utf8ToWide(file_path);
+            manifest_stream = std::make_unique<ContentChunker::Stream>();
+            if (manifest_stream->open(wpath, [this](uint64_t offset, const uint8_t *data, size_t size)
+                                      { manifest_merkle->update(offset, data, size); }))
+            {
+                // 打开时只查找空洞，数据在分块时才读取
+                is_folder = false;
+                file_total_size = manifest_stream->fileSize();
+                manifest_merkle = std::make_unique<MerkleVerifier>(wpath, file_total_size);
+                file_state = State::Block;
+                return {false, 0, buildChunkBatch(true)};
+            }
+            manifest_stream.reset();
+            is_chunk_manifest = false;
+        }
+        else if (file_state == State::Block)
+        {
+            return {false, 0, buildChunkBatch(false)};
+        }
+        else
+        {
+            file_state = State::Default;
+            file_total_size = 0;
+            manifest_stream.reset();
+            manifest_merkle.reset();
+            return {false, 100, nullptr};
+        }
+    }
+    if (delta_signature)
+    {
+        // 增量模式：先发增量头部，之后每次一帧指令，最后以带哈希的file_end结束
+        if (file_state == State::Default)
+        {
+            auto header = buildDeltaHeader();
+            if (header)
+            {
+                return {false, 0, std::move(header)};
+            }
+        }
+        else
+        {
+            return buildDeltaFrame();
+        }
+    }
     // 初次调用，发送文件头或文件夹头
     if (file_state == State::Default)
     {
+        if (is_stripe)
+        {
+            is_folder = false;
+            return {false, 0, buildStripeHeader()};
+        }
         is_folder = FileSystemUtils::isDirectory(file_path);
         return {false, 0, buildHeader()};
     }
     switch (file_state)
     {
     case State::Header:
-        return {false, 0, buildHeader()};
+        return buildNextItem(0);
     case State::Block:
-        return {true, calculateProgress(), buildBlock()};
+    {
+        source_length = 0;
+        auto block = buildBlock();
+        uint8_t progress = calculateProgress();
+        if (source_length > 0)
+        {
+            return {true, progress, std::move(block), source_file.get(), source_offset, source_length};
+        }
+        return {true, progress, std::move(block)};
+    }
     case State::End:
     {
         uint8_t final_progress = calculateProgress();
-        if (is_folder && dir_file_index <= dir_items.size() - 1)
+        if (is_stripe) // 条带没有file_end，接收端按已收字节数判断完成
         {
-            file_state = State::Header;
+            file_state = State::Default;
             file_sended_size = 0;
             file_total_size = 0;
-            file_reader.reset(); // 关闭当前文件
-            return {false, final_progress, buildHeader()};
+            closeSource();
+            return {false, final_progress, nullptr};
         }
-        file_state = State::Default;
-        is_end = true;
         if (is_folder)
         {
-            dir_sended_size = 0;
-            dir_total_size = 0;
-        }
-        else
-        {
+            file_state = State::Header;
             file_sended_size = 0;
             file_total_size = 0;
+            closeSource(); // 关闭当前文件
+            return buildNextItem(final_progress);
         }
-        return {false, final_progress, buildEnd()};
+        std::map<std::string, std::string> end_args;
+        appendMerkleRoot(end_args);
+        return finishTransfer(final_progress, std::move(end_args));
     }
     default:
         break;
@@ -5,10 +5,16 @@
 #include "driver/impl/FileUtility.h"
 #include "control/EventBusManager.h"
 #include "driver/interface/FileStreamHelper.h"
+#include "driver/impl/FileSyncEngine/BlockCompressor.h"
 #include "common/DebugOutputer.h"
 #include <string>
+#include <algorithm>
+#include <cstring>
 
-FileParser::FileParser() : json_parser(std::make_unique<NlohmannJson>())
+FileParser::FileParser(std::shared_ptr<FileAssembler> assembler, std::shared_ptr<CompressionInterface> compression)
+    : json_parser(std::make_unique<NlohmannJson>()),
+      file_assembler(std::move(assembler)),
+      compression_instance(std::move(compression))
 {
     if (!FileSystemUtils::directoryExists(GlobalStatusManager::absolute_tmp_dir))
     {
@@ -16,49 +22,80 @@ FileParser::FileParser() : json_parser(std::make_unique<NlohmannJson>())
     }
     type_parser_map["file_header"] = std::bind(&FileParser::onFileHeader, this, std::placeholders::_1);
     type_parser_map["dir_header"] = std::bind(&FileParser::onDirHeader, this, std::placeholders::_1);
+    type_parser_map["dir_paths"] = std::bind(&FileParser::onDirPaths, this, std::placeholders::_1);
     type_parser_map["dir_item_header"] = std::bind(&FileParser::onDirItemHeader, this, std::placeholders::_1);
     type_parser_map["file_end"] = std::bind(&FileParser::onFileEnd, this, std::placeholders::_1);
+    type_parser_map["file_stripe"] = std::bind(&FileParser::onFileStripe, this, std::placeholders::_1);
+    type_parser_map["file_chunks"] = std::bind(&FileParser::onFileChunks, this, std::placeholders::_1);
+    type_parser_map["file_delta"] = std::bind(&FileParser::onFileDelta, this, std::placeholders::_1);
+    type_parser_map["file_root"] = std::bind(&FileParser::onFileRoot, this, std::placeholders::_1);
 }
 
-uint8_t FileParser::calculateProgress()
+FileParser::~FileParser()
 {
-    if (total_size == 0)
+    // 正在拷贝的清单在两个块之间放弃，未处理的清单直接丢弃
     {
-        return 0;
+        std::lock_guard<std::mutex> lock(chunk_mutex);
+        is_chunk_stopped = true;
+    }
+    chunk_cv.notify_one();
+    if (chunk_thread.joinable())
+    {
+        chunk_thread.join();
     }
-    uint64_t effective_size = (received_size > total_size) ? total_size : received_size;
-    return static_cast<uint8_t>((effective_size * 100 + total_size / 2) / total_size);
 }
 
 void FileParser::parse(std::unique_ptr<NetworkInterface::UserMsg> msg)
 {
-    static uint8_t progress_count = 0;
+    if (msg->header.flag & static_cast<uint8_t>(NetworkInterface::Flag::IS_COMPRESS))
+    {
+        std::vector<uint8_t> data;
+        if (!compression_instance ||
+            !compression_instance->decompress(msg->data.data(), msg->data.size(), data, BlockCompressor::max_frame_size))
+        {
+            LOG_ERROR("Failed to decompress file block");
+            return;
+        }
+        msg->data = std::move(data);
+    }
     if (msg->header.flag & static_cast<uint8_t>(NetworkInterface::Flag::IS_BINARY))
     {
-        if (file_stream)
+        auto block = FileSyncEngineInterface::parseBlock(msg->data.data(), msg->data.size());
+        if (!block)
+        {
+            LOG_ERROR("Invalid file block");
+            return;
+        }
+        if (is_folder && block->index == FileSyncEngineInterface::pack_block_index)
         {
-            file_stream->write(reinterpret_cast<const char *>(msg->data.data()) + 4, msg->data.size() - 4);
-            received_size += msg->data.size() - 4;
-            bytes_received += msg->data.size() - 4;
-            if (progress_count >= 40)
+            if (is_rejected)
             {
-                end_time_point = std::chrono::steady_clock::now();
-                auto elapsed_us = std::chrono::duration_cast<std::chrono::microseconds>(end_time_point - start_time_point);
-                uint32_t speed_bps = 0;
-                if (elapsed_us.count() > 0)
-                {
-                    uint64_t bps = (static_cast<uint64_t>(bytes_received) * 1000000ULL) / elapsed_us.count();
-                    speed_bps = static_cast<uint32_t>(bps);
-                    bytes_received = 0;
-                }
-                start_time_point = std::chrono::steady_clock::now();
-                EventBusManager::instance().publish("/file/download_progress", current_file_id,
-                                                    calculateProgress(), static_cast<uint32_t>(speed_bps), false);
-                progress_count = 0;
+                return;
             }
-            ++progress_count;
+            unpackItems(block->data, block->data_size);
+            return;
         }
-        else
+        if (delta_decoder && block->index == FileSyncEngineInterface::delta_block_index)
+        {
+            applyDelta(block->data, block->data_size);
+            return;
+        }
+        uint64_t offset = FileSyncEngineInterface::blockOffset(block->index, block_size);
+        if (!is_folder)
+        {
+            // 单文件按块索引定位写入，块可以乱序或来自不同连接
+            file_assembler->write(block->id, offset, block->data, block->data_size, std::move(msg->data));
+        }
+        else if (item_writer && item_writer->isOpen())
+        {
+            item_writer->writeAt(offset, block->data, block->data_size);
+            if (item_write_behind)
+            {
+                item_write_behind->onWritten(*item_writer, offset, block->data_size);
+            }
+            onItemReceived(block->data_size);
+        }
+        else if (!is_rejected)
         {
             LOG_ERROR("FStream hasn't ready");
         }
@@ -81,87 +118,649 @@ void FileParser::parse(std::unique_ptr<NetworkInterface::UserMsg> msg)
     }
 }
 
-void FileParser::onFileHeader(std::unique_ptr<Json::Parser> content_parser)
+void FileParser::onItemReceived(uint32_t size)
 {
-    uint32_t id = std::stoul(content_parser->getValue("id"));
-    if (file_stream)
+    // 同一文件夹的其他部分可能在别的连接上接收，进度由重组器汇总
+    file_assembler->addFolderReceived(current_file_id, size);
+}
+
+void FileParser::closeItem()
+{
+    if (item_write_behind && item_writer)
     {
-        file_stream.reset();
+        item_write_behind->finish(*item_writer);
     }
+    item_write_behind.reset();
+    item_writer.reset();
+}
 
-    // 接收到的字符是utf8，需要转换成宽字节
-    std::wstring wide_tmp_dir = FileSystemUtils::utf8ToWide(GlobalStatusManager::absolute_tmp_dir);
-    std::wstring wide_filename = FileSystemUtils::utf8ToWide(GlobalStatusManager::getInstance().getFileName(id));
-    std::wstring full_path = wide_tmp_dir + wide_filename;
+void FileParser::unpackItems(const uint8_t *data, size_t size)
+{
+    uint32_t item_count = 0;
+    if (size < sizeof(item_count))
+    {
+        LOG_ERROR("Invalid item pack");
+        return;
+    }
+    memcpy(&item_count, data, sizeof(item_count));
 
-    current_file_id = std::stoul(content_parser->getValue("id"));
+    // 先解析目录项表，内容紧随表之后
+    struct PackedItem
+    {
+        std::string path;
+        uint32_t data_size;
+    };
+    std::vector<PackedItem> items;
+    items.reserve(item_count);
+    size_t offset = sizeof(item_count);
+    for (uint32_t i = 0; i < item_count; ++i)
+    {
+        uint32_t path_size = 0;
+        uint32_t data_size = 0;
+        if (size - offset < sizeof(uint32_t) * 2)
+        {
+            LOG_ERROR("Invalid item pack");
+            return;
+        }
+        memcpy(&path_size, data + offset, sizeof(path_size));
+        memcpy(&data_size, data + offset + sizeof(uint32_t), sizeof(data_size));
+        offset += sizeof(uint32_t) * 2;
+        if (size - offset < path_size)
+        {
+            LOG_ERROR("Invalid item pack");
+            return;
+        }
+        items.push_back({std::string(reinterpret_cast<const char *>(data + offset), path_size), data_size});
+        offset += path_size;
+    }
 
-    file_stream = FileStreamHelper::createOutputFileStream(full_path);
+    uint64_t unpacked_size = 0;
+    for (const auto &item : items)
+    {
+        if (size - offset < item.data_size)
+        {
+            LOG_ERROR("Invalid item pack");
+            break;
+        }
+        ensureParentDirectory(item.path);
+        std::wstring full_path = dir_path + FileSystemUtils::utf8ToWide(item.path);
+        FileStreamHelper::PositionalWriter writer(full_path);
+        if (!writer.isOpen() || !writer.writeAt(0, data + offset, item.data_size))
+        {
+            LOG_ERROR("Failed to write: " << FileStreamHelper::wstringToLocalPath(full_path));
+        }
+        offset += item.data_size;
+        unpacked_size += item.data_size;
+    }
+    onItemReceived(static_cast<uint32_t>(unpacked_size));
+}
 
-    total_size = std::stoull(content_parser->getValue("total_size"));
+// 从非阻塞socket读满size字节，dst为nullptr时丢弃
+static bool recvExact(UnifiedSocket socket, uint8_t *dst, size_t size)
+{
+    uint8_t discard_buffer[4096];
+    while (size > 0)
+    {
+        uint8_t *buffer = dst ? dst : discard_buffer;
+        size_t want = dst ? size : (std::min)(size, sizeof(discard_buffer));
+        int n = recv(socket, reinterpret_cast<char *>(buffer), static_cast<int>(want), 0);
+        if (n == 0)
+        {
+            return false;
+        }
+        if (n < 0)
+        {
+            int err = GET_SOCKET_ERROR;
+            if (err == SOCKET_EINTR)
+            {
+                continue;
+            }
+            if (err != SOCKET_EWOULDBLOCK)
+            {
+                return false;
+            }
+            fd_set readfds;
+            FD_ZERO(&readfds);
+            FD_SET(socket, &readfds);
+            struct timeval timeout = {1, 0};
+#ifdef _WIN32
+            select(0, &readfds, nullptr, nullptr, &timeout);
+#else
+            select(socket + 1, &readfds, nullptr, nullptr, &timeout);
+#endif
+            continue;
+        }
+        if (dst)
+        {
+            dst += n;
+        }
+        size -= n;
+    }
+    return true;
+}
 
-    if (!file_stream || !file_stream->is_open())
+bool FileParser::receiveBinary(UnifiedSocket socket, uint32_t payload_length)
+{
+    constexpr uint32_t HEADER_SIZE = FileSyncEngineInterface::block_header_size;
+    if (payload_length < HEADER_SIZE)
     {
-        LOG_ERROR("Failed to open: " << FileStreamHelper::wstringToLocalPath(full_path));
+        LOG_ERROR("Invalid file block");
+        return recvExact(socket, nullptr, payload_length);
     }
-    else
+    uint8_t prefix[HEADER_SIZE];
+    if (!recvExact(socket, prefix, HEADER_SIZE))
+    {
+        return false;
+    }
+    auto block = FileSyncEngineInterface::parseBlock(prefix, payload_length);
+    if (!block)
     {
-        start_time_point = std::chrono::steady_clock::now();
+        LOG_ERROR("Invalid file block");
+        return recvExact(socket, nullptr, payload_length - HEADER_SIZE);
     }
+
+    if (is_folder && block->index == FileSyncEngineInterface::pack_block_index)
+    {
+        std::vector<uint8_t> pack(block->data_size);
+        if (!recvExact(socket, pack.data(), pack.size()))
+        {
+            return false;
+        }
+        unpackItems(pack.data(), pack.size());
+        return true;
+    }
+    if (delta_decoder && block->index == FileSyncEngineInterface::delta_block_index)
+    {
+        std::vector<uint8_t> instructions(block->data_size);
+        if (!recvExact(socket, instructions.data(), instructions.size()))
+        {
+            return false;
+        }
+        applyDelta(instructions.data(), instructions.size());
+        return true;
+    }
+    uint64_t offset = FileSyncEngineInterface::blockOffset(block->index, block_size);
+    uint32_t size = block->data_size;
+    auto fill = [socket, offset, size](FileStreamHelper::PositionalWriter *writer) -> bool
+    {
+#ifdef __linux__
+        if (writer)
+        {
+            // 数据经管道从socket直接进入页缓存
+            return writer->spliceFrom(socket, offset, size);
+        }
+#endif
+        std::vector<uint8_t> data(writer ? size : 0);
+        if (!recvExact(socket, writer ? data.data() : nullptr, size))
+        {
+            return false;
+        }
+        return !writer || writer->writeAt(offset, data.data(), size);
+    };
+
+    if (!is_folder)
+    {
+        return file_assembler->receive(block->id, offset, size, fill);
+    }
+    if (item_writer && item_writer->isOpen())
+    {
+        if (!fill(item_writer.get()))
+        {
+            return false;
+        }
+        if (item_write_behind)
+        {
+            item_write_behind->onWritten(*item_writer, offset, size);
+        }
+        onItemReceived(size);
+        return true;
+    }
+    if (!is_rejected)
+    {
+        LOG_ERROR("FStream hasn't ready");
+    }
+    return fill(nullptr);
+}
+
+void FileParser::onFileHeader(std::unique_ptr<Json::Parser> content_parser)
+{
+    uint32_t id = std::stoul(content_parser->getValue("id"));
+    closeItem();
+    abandonDelta();
+
+    // 接收到的字符是utf8，需要转换成宽字节
+    std::wstring wide_tmp_dir = FileSystemUtils::utf8ToWide(GlobalStatusManager::absolute_tmp_dir);
+    std::wstring wide_filename = FileSystemUtils::utf8ToWide(GlobalStatusManager::getInstance().getFileName(id));
+    std::wstring full_path = wide_tmp_dir + wide_filename;
+
+    current_file_id = id;
+    is_folder = false;
+    is_rejected = false;
+    block_size = parseBlockSize(*content_parser);
+    // 叶子大小一致时才能校验发送端随file_end给出的Merkle根
+    std::string leaf_size = content_parser->getValue("merkle_leaf_size");
+    bool expects_root = leaf_size == std::to_string(MerkleTree::leaf_size);
+    if (!leaf_size.empty() && !expects_root)
+    {
+        LOG_ERROR("Unsupported merkle leaf size: " << leaf_size);
+    }
+    file_assembler->open(id, full_path, std::stoull(content_parser->getValue("total_size")), expects_root);
 }
 
 void FileParser::onDirHeader(std::unique_ptr<Json::Parser> content_parser)
 {
     uint32_t id = std::stoul(content_parser->getValue("id"));
-    total_size = std::stoull(content_parser->getValue("total_size"));
+    uint64_t total_size = std::stoull(content_parser->getValue("total_size"));
+    std::string part_count = content_parser->getValue("part_count");
+    abandonDelta();
     std::wstring wide_tmp_dir = FileSystemUtils::utf8ToWide(GlobalStatusManager::absolute_tmp_dir);
     std::wstring wide_filename = FileSystemUtils::utf8ToWide(GlobalStatusManager::getInstance().getFileName(id));
     std::wstring end = FileSystemUtils::utf8ToWide("/");
     dir_path = wide_tmp_dir + wide_filename + end;
+    created_dirs.clear();
+
+    current_file_id = id;
+    is_folder = true;
+    // 空间不足时整个部分的目录与文件都不再创建
+    is_rejected = !file_assembler->openFolder(id, dir_path, total_size,
+                                              part_count.empty() ? 1 : static_cast<uint32_t>(std::stoul(part_count)));
+}
 
-    auto leaf_paths = content_parser->getArray("leaf_paths");
-    for (auto &i : leaf_paths)
+void FileParser::onDirPaths(std::unique_ptr<Json::Parser> content_parser)
+{
+    if (is_rejected)
+    {
+        return;
+    }
+    auto paths = content_parser->getArray("paths");
+    for (auto &i : paths)
     {
-        auto tmp = i->getArrayItems();
-        for (auto &a : tmp)
+        for (auto &a : i->getArrayItems())
         {
-            std::string path_str = FileStreamHelper::wstringToLocalPath(dir_path + FileSystemUtils::utf8ToWide(a));
-            FileSystemUtils::createDirectoryRecursive(path_str);
+            ensureDirectory(a);
         }
     }
+}
 
-    current_file_id = std::stoul(content_parser->getValue("id"));
-    is_folder = true;
-    start_time_point = std::chrono::steady_clock::now();
+void FileParser::ensureDirectory(const std::string &relative_path)
+{
+    if (!created_dirs.insert(relative_path).second)
+    {
+        return;
+    }
+    std::string path_str = FileStreamHelper::wstringToLocalPath(dir_path + FileSystemUtils::utf8ToWide(relative_path));
+    FileSystemUtils::createDirectoryRecursive(path_str);
+}
+
+void FileParser::ensureParentDirectory(const std::string &relative_path)
+{
+    size_t pos = relative_path.find_last_of("/\\");
+    ensureDirectory(pos == std::string::npos ? std::string(".") : relative_path.substr(0, pos));
 }
 
 void FileParser::onDirItemHeader(std::unique_ptr<Json::Parser> content_parser)
 {
-    std::wstring file_relative_path = FileSystemUtils::utf8ToWide(content_parser->getValue("path"));
+    closeItem();
+    block_size = parseBlockSize(*content_parser);
+    if (is_rejected)
+    {
+        return;
+    }
+    std::string relative_path = content_parser->getValue("path");
+    ensureParentDirectory(relative_path);
+    std::wstring file_relative_path = FileSystemUtils::utf8ToWide(relative_path);
     std::wstring full_path = dir_path + file_relative_path;
 
-    file_stream = FileStreamHelper::createOutputFileStream(full_path);
+    item_writer = std::make_unique<FileStreamHelper::PositionalWriter>(full_path);
 
-    if (!file_stream || !file_stream->is_open())
+    if (!item_writer->isOpen())
     {
         LOG_ERROR("Failed to open: " << FileStreamHelper::wstringToLocalPath(full_path));
     }
+    else
+    {
+        uint64_t item_size = std::stoull(content_parser->getValue("total_size"));
+        if (!item_writer->reserve(item_size))
+        {
+            LOG_ERROR("No space to preallocate: " << FileStreamHelper::wstringToLocalPath(full_path));
+        }
+        if (item_size >= FileSyncEngineInterface::drop_behind_min_size)
+        {
+            item_write_behind = std::make_unique<WriteBehind>();
+        }
+    }
 
     file_name = content_parser->getValue("path");
 }
 
+uint32_t FileParser::parseBlockSize(Json::Parser &content_parser)
+{
+    uint32_t size = static_cast<uint32_t>(std::stoul(content_parser.getValue("block_size")));
+    if (size < FileSyncEngineInterface::min_block_size || size > FileSyncEngineInterface::max_block_size)
+    {
+        LOG_ERROR("Invalid block size: " << size);
+        return FileSyncEngineInterface::file_block_size;
+    }
+    return size;
+}
+
 void FileParser::onFileEnd(std::unique_ptr<Json::Parser> content_parser)
 {
-    EventBusManager::instance().publish("/file/download_progress", current_file_id,
-                                        static_cast<uint8_t>(100), static_cast<uint32_t>(0), true);
-    received_size = 0;
+    if (delta_decoder)
+    {
+        // 只有增量传输的结束带id，其他传输的结束说明增量传输已被打断
+        std::string id = content_parser->getValue("id");
+        if (!id.empty() && std::stoul(id) == delta_file_id)
+        {
+            finishDelta(content_parser->getValue("sha256"));
+            return;
+        }
+        abandonDelta();
+    }
+    if (!is_folder)
+    {
+        // 收满后重组器等待Merkle根，空文件等未收满的情况也在这里完成
+        file_assembler->finish(current_file_id, content_parser->getValue("merkle_root"),
+                               content_parser->getValue("merkle_spans"));
+        return;
+    }
+
+    // 最后结束的部分发布完成事件
+    closeItem();
+    is_folder = false;
+    file_assembler->finishFolderPart(current_file_id);
+}
+
+void FileParser::onFileStripe(std::unique_ptr<Json::Parser> content_parser)
+{
+    uint32_t id = std::stoul(content_parser->getValue("id"));
+    closeItem();
+    abandonDelta();
+
+    std::wstring wide_tmp_dir = FileSystemUtils::utf8ToWide(GlobalStatusManager::absolute_tmp_dir);
+    std::wstring wide_filename = FileSystemUtils::utf8ToWide(GlobalStatusManager::getInstance().getFileName(id));
+    std::wstring full_path = wide_tmp_dir + wide_filename;
+
+    // 第一个到达的条带负责创建文件，其余条带复用；块自带索引，无需记录条带偏移
+    current_file_id = id;
+    is_folder = false;
+    is_rejected = false;
+    block_size = parseBlockSize(*content_parser);
+    // 整个文件拆成条带时，根随后由file_root给出
+    bool expects_root = content_parser->getValue("merkle_leaf_size") == std::to_string(MerkleTree::leaf_size);
+    file_assembler->open(id, full_path, std::stoull(content_parser->getValue("total_size")), expects_root);
+}
+
+void FileParser::onFileRoot(std::unique_ptr<Json::Parser> content_parser)
+{
+    file_assembler->setMerkleRoot(static_cast<uint32_t>(std::stoul(content_parser->getValue("id"))),
+                                  content_parser->getValue("merkle_root"), content_parser->getValue("merkle_spans"));
+}
+
+void FileParser::onFileChunks(std::unique_ptr<Json::Parser> content_parser)
+{
+    ChunkBatch batch;
+    batch.id = std::stoul(content_parser->getValue("id"));
+    batch.total_size = std::stoull(content_parser->getValue("total_size"));
+    batch.holes = TransferJournal::rangesFromString(content_parser->getValue("holes"));
+    batch.is_last = content_parser->getValue("is_last") == "1";
+    batch.merkle_root = content_parser->getValue("merkle_root");
+    batch.merkle_spans = content_parser->getValue("merkle_spans");
+    abandonDelta();
+
+    auto chunks = content_parser->getArray("chunks");
+    for (auto &i : chunks)
+    {
+        for (auto &a : i->getArrayItems())
+        {
+            ContentChunker::Chunk chunk;
+            if (!ContentChunker::chunkFromString(a, chunk) || chunk.offset + chunk.length > batch.total_size)
+            {
+                LOG_ERROR("Invalid chunk: " << a);
+                continue;
+            }
+            batch.chunks.push_back(std::move(chunk));
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(chunk_mutex);
+        if (!chunk_thread.joinable())
+        {
+            chunk_thread = std::thread(&FileParser::chunkLoop, this);
+        }
+        chunk_batches.push_back(std::move(batch));
+    }
+    chunk_cv.notify_one();
+}
+
+void FileParser::chunkLoop()
+{
+    while (true)
+    {
+        ChunkBatch batch;
+        {
+            std::unique_lock<std::mutex> lock(chunk_mutex);
+            chunk_cv.wait(lock, [this]()
+                          { return is_chunk_stopped || !chunk_batches.empty(); });
+            if (is_chunk_stopped)
+            {
+                return;
+            }
+            batch = std::move(chunk_batches.front());
+            chunk_batches.pop_front();
+        }
+        copyChunks(batch);
+    }
+}
+
+void FileParser::copyChunks(const ChunkBatch &batch)
+{
+    if (!chunk_writer || chunk_file_id != batch.id)
+    {
+        beginChunks(batch.id, batch.total_size, batch.holes);
+    }
+
+    std::vector<uint8_t> data;
+    for (const auto &chunk : batch.chunks)
+    {
+        if (is_chunk_stopped)
+        {
+            return;
+        }
+        if (chunk_writer->isOpen() && chunk_store->read(chunk, data) &&
+            chunk_writer->writeAt(chunk.offset, data.data(), data.size()))
+        {
+            chunk_journal->commit(chunk.offset, chunk.length);
+        }
+    }
+
+    if (batch.is_last)
+    {
+        // 记入续传日志，缺失区间收齐后据此校验整个文件
+        chunk_journal->setMerkleRoot(batch.merkle_root);
+        chunk_journal->setMerkleSpans(batch.merkle_spans);
+        finishChunks();
+    }
+}
+
+void FileParser::beginChunks(uint32_t id, uint64_t total_size, const std::vector<TransferJournal::Range> &holes)
+{
+    std::wstring wide_tmp_dir = FileSystemUtils::utf8ToWide(GlobalStatusManager::absolute_tmp_dir);
+    std::wstring wide_filename = FileSystemUtils::utf8ToWide(GlobalStatusManager::getInstance().getFileName(id));
+    std::wstring full_path = wide_tmp_dir + wide_filename;
+
+    // 新文件写在原路径上，旧版本连同块索引一起改名，修改时间不变，索引仍然有效
+    chunk_previous_path = full_path + L".xftprev";
+    std::error_code ec;
+    fs::path target = fs::u8path(FileStreamHelper::wstringToLocalPath(full_path));
+    if (fs::exists(target, ec))
+    {
+        fs::rename(target, fs::u8path(FileStreamHelper::wstringToLocalPath(chunk_previous_path)), ec);
+        fs::rename(fs::u8path(FileStreamHelper::wstringToLocalPath(full_path + ChunkStore::index_suffix)),
+                   fs::u8path(FileStreamHelper::wstringToLocalPath(chunk_previous_path + ChunkStore::index_suffix)), ec);
+    }
+
+    chunk_file_id = id;
+    chunk_store = std::make_unique<ChunkStore>(wide_tmp_dir);
+    chunk_store->refresh(full_path);
+    chunk_journal = std::make_unique<TransferJournal>(full_path);
+    chunk_journal->reset(total_size);
+    // 空洞读出即为零，直接记为已接收，续传时不再请求
+    uint64_t hole_size = 0;
+    for (const auto &hole : holes)
+    {
+        if (hole.offset + hole.length <= total_size)
+        {
+            hole_size += chunk_journal->commit(hole.offset, hole.length);
+        }
+    }
+
+    chunk_writer = std::make_unique<FileStreamHelper::PositionalWriter>(full_path);
+    if (!chunk_writer->isOpen())
+    {
+        LOG_ERROR("Failed to open: " << FileStreamHelper::wstringToLocalPath(full_path));
+        return;
+    }
+    if (hole_size > 0)
+    {
+        // 先打洞再延长，Windows上文件因此成为稀疏文件，延长的部分不占用空间
+        for (const auto &hole : holes)
+        {
+            chunk_writer->punchHole(hole.offset, hole.length);
+        }
+        chunk_writer->resize(total_size);
+        LOG_INFO("File " << id << " has " << hole_size << "/" << total_size << " bytes of holes");
+    }
+    // 只为数据区间预分配
+    for (const auto &range : chunk_journal->missingRanges())
+    {
+        if (!chunk_writer->reserve(range.offset, range.length))
+        {
+            // 拷贝失败的块留给随后的续传请求，届时重组器会拒绝空间不足的文件
+            LOG_ERROR("No space to preallocate: " << FileStreamHelper::wstringToLocalPath(full_path));
+            break;
+        }
+    }
+}
+
+void FileParser::finishChunks()
+{
+    chunk_writer.reset();
+    chunk_store.reset();
+    // 需要的块都已拷贝，旧版本不再保留
+    std::error_code ec;
+    fs::remove(fs::u8path(FileStreamHelper::wstringToLocalPath(chunk_previous_path)), ec);
+    ChunkStore::removeIndex(chunk_previous_path);
+
+    LOG_INFO("Reuse " << chunk_journal->committedSize() << "/" << chunk_journal->totalSize()
+                      << " bytes of file " << chunk_file_id);
+    if (chunk_journal->committedSize() >= chunk_journal->totalSize())
+    {
+        chunk_journal->remove();
+        EventBusManager::instance().publish("/file/download_progress", chunk_file_id,
+                                            static_cast<uint8_t>(100), static_cast<uint32_t>(0), true);
+        // 发送端不会再收到续传请求，由此得知上传完成
+        EventBusManager::instance().publish("/file/send_manifest_satisfied", chunk_file_id);
+    }
+    else
+    {
+        // 通过续传流程只请求缺失的区间
+        chunk_journal->save();
+        EventBusManager::instance().publish("/file/send_get_file", chunk_file_id);
+    }
+    chunk_journal.reset();
+}
+
+void FileParser::onFileDelta(std::unique_ptr<Json::Parser> content_parser)
+{
+    uint32_t id = std::stoul(content_parser->getValue("id"));
+    uint32_t delta_block_size = static_cast<uint32_t>(std::stoul(content_parser->getValue("block_size")));
+    closeItem();
+    abandonDelta();
 
-    static uint8_t progress_count = 0;
-    progress_count = 0;
+    std::wstring wide_tmp_dir = FileSystemUtils::utf8ToWide(GlobalStatusManager::absolute_tmp_dir);
+    std::wstring wide_filename = FileSystemUtils::utf8ToWide(GlobalStatusManager::getInstance().getFileName(id));
+    delta_target_path = wide_tmp_dir + wide_filename;
+    delta_basis_path = delta_target_path + L".xftbasis";
+    std::error_code ec;
+    fs::rename(fs::u8path(FileStreamHelper::wstringToLocalPath(delta_target_path)),
+               fs::u8path(FileStreamHelper::wstringToLocalPath(delta_basis_path)), ec);
+    if (ec)
+    {
+        // 旧版本不可用时拷贝指令失败，结束时转为完整下载
+        LOG_ERROR("Failed to keep previous version: " << ec.message());
+    }
+    if (delta_block_size < DeltaSignature::min_block_size || delta_block_size > DeltaSignature::max_block_size)
+    {
+        LOG_ERROR("Invalid block size: " << delta_block_size);
+        delta_block_size = DeltaSignature::min_block_size;
+    }
+
+    current_file_id = id;
+    is_folder = false;
+    delta_file_id = id;
+    delta_total_size = std::stoull(content_parser->getValue("total_size"));
+    delta_decoder = std::make_unique<DeltaDecoder>(delta_basis_path, delta_target_path, delta_block_size);
+    delta_frame_count = 0;
+    delta_reported_size = 0;
+    delta_report_time = std::chrono::steady_clock::now();
+}
 
-    if (file_stream)
+void FileParser::applyDelta(const uint8_t *data, size_t size)
+{
+    if (!delta_decoder->apply(data, size) || delta_total_size == 0 || ++delta_frame_count < 40)
+    {
+        return;
+    }
+    delta_frame_count = 0;
+    auto now = std::chrono::steady_clock::now();
+    auto elapsed_us = std::chrono::duration_cast<std::chrono::microseconds>(now - delta_report_time);
+    uint64_t output_size = (std::min)(delta_decoder->outputSize(), delta_total_size);
+    uint32_t speed_bps = 0;
+    if (elapsed_us.count() > 0)
     {
-        file_stream->flush();
-        file_stream.reset();
+        speed_bps = static_cast<uint32_t>(((output_size - delta_reported_size) * 1000000ULL) /
+                                          static_cast<uint64_t>(elapsed_us.count()));
     }
-}
\ No newline at end of file
+    delta_reported_size = output_size;
+    delta_report_time = now;
+    uint8_t progress = static_cast<uint8_t>((output_size * 100 + delta_total_size / 2) / delta_total_size);
+    EventBusManager::instance().publish("/file/download_progress", delta_file_id, progress, speed_bps, false);
+}
+
+void FileParser::finishDelta(const std::string &expected_hash)
+{
+    uint64_t output_size = delta_decoder->outputSize();
+    bool is_valid = output_size == delta_total_size && delta_decoder->finish(expected_hash);
+    delta_decoder.reset();
+    std::error_code ec;
+    fs::remove(fs::u8path(FileStreamHelper::wstringToLocalPath(delta_basis_path)), ec);
+
+    if (is_valid)
+    {
+        LOG_INFO("Rebuild file " << delta_file_id << " from previous version, " << output_size << " bytes");
+        EventBusManager::instance().publish("/file/download_progress", delta_file_id,
+                                            static_cast<uint8_t>(100), static_cast<uint32_t>(0), true);
+        return;
+    }
+    // 旧版本已删除，重新请求时对端发送整个文件
+    LOG_ERROR("Delta rebuild failed for file " << delta_file_id << ", download it again");
+    fs::remove(fs::u8path(FileStreamHelper::wstringToLocalPath(delta_target_path)), ec);
+    EventBusManager::instance().publish("/file/send_get_file", delta_file_id);
+}
+
+void FileParser::abandonDelta()
+{
+    if (!delta_decoder)
+    {
+        return;
+    }
+    // 关闭文件后把旧版本改回原名，下次仍可作为增量传输的基础
+    delta_decoder.reset();
+    LOG_ERROR("Delta transfer of file " << delta_file_id << " was interrupted");
+    std::error_code ec;
+    fs::rename(fs::u8path(FileStreamHelper::wstringToLocalPath(delta_basis_path)),
+               fs::u8path(FileStreamHelper::wstringToLocalPath(delta_target_path)), ec);
+    EventBusManager::instance().publish("/file/download_failed", delta_file_id);
+}
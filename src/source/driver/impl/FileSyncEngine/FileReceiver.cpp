@@ -4,6 +4,7 @@
 #include <iostream>
 #include <cstring>
 #include <mutex>
+#include <algorithm>
 
 bool FileReceiver::initialize()
 {
@@ -73,146 +74,194 @@ void FileReceiver::start(std::function<void(UnifiedSocket)> accept_cb,
                          std::function<void(UnifiedSocket socket, std::unique_ptr<NetworkInterface::UserMsg>)> msg_cb)
 {
     running = true;
-    tcp_listen_thread = std::make_unique<std::thread>([this, accept_cb = std::move(accept_cb), msg_cb = std::move(msg_cb)]()
-                                                      {
-#ifdef _WIN32
-            // Windows使用WSAPoll
-            WSAPOLLFD fds[1];
-            fds[0].fd = listen_socket;
-            fds[0].events = POLLRDNORM;
-#else
-            // Linux使用poll
-            pollfd fds[1];
-            fds[0].fd = listen_socket;
-            fds[0].events = POLLIN;
-#endif
-
-            while (this->running)
-            {
-#ifdef _WIN32
-                int result = WSAPoll(fds, 1, 100);
-#else
-                int result = poll(fds, 1, 100);
-#endif
+    this->accept_cb = std::move(accept_cb);
+    this->msg_cb = std::move(msg_cb);
+    if (binary_payload_sink)
+    {
+        outer_parser->setBinaryPayloadSink([this](UnifiedSocket socket, uint32_t payload_length)
+                                           {
+            bool is_ok = binary_payload_sink(socket, payload_length);
+            onFrameConsumed(socket, sizeof(NetworkInterface::Header) + payload_length);
+            return is_ok; });
+    }
 
-                if (result > 0) {
-#ifdef _WIN32
-                    bool ready = (fds[0].revents & POLLRDNORM) != 0;
-#else
-                    bool ready = (fds[0].revents & POLLIN) != 0;
-#endif
-                    if (ready)
-                    {
-                        sockaddr_in client_addr;
-                        socklen_t client_addr_len = sizeof(client_addr);
-                        
-                        UnifiedSocket accepted_socket = accept(listen_socket, 
-                            (sockaddr*)&client_addr, &client_addr_len);
-                            
-                        if (accepted_socket != INVALID_SOCKET_VAL)
-                        {
-                            {
-                                std::lock_guard<std::mutex> lock(sockets_mutex);
-                                receive_sockets.push_back(accepted_socket);
-                            }
-                            
-                            LOG_INFO("Accepted connection from " 
-                                      << inet_ntoa(client_addr.sin_addr) << ":" 
-                                      << ntohs(client_addr.sin_port));
-                            
-                            // 调用accept回调
-                            accept_cb(accepted_socket);
-                            
-                            // 创建接收线程
-                            std::shared_ptr<std::thread> recv_thread = std::make_shared<std::thread>([this, accepted_socket, msg_cb]() {
-                                bool thread_running = true;
-                                
-                                // 为每个连接设置socket选项
-                                int timeout_val = 5000; // 5秒超时
-#ifdef _WIN32
-                                setsockopt(accepted_socket, SOL_SOCKET, SO_RCVTIMEO, 
-                                          (const char*)&timeout_val, sizeof(timeout_val));
-#else
-                                struct timeval tv;
-                                tv.tv_sec = timeout_val / 1000;
-                                tv.tv_usec = (timeout_val % 1000) * 1000;
-                                setsockopt(accepted_socket, SOL_SOCKET, SO_RCVTIMEO, 
-                                          &tv, sizeof(tv));
-#endif
+    unsigned loop_count = (std::min)((std::max)(std::thread::hardware_concurrency(), 1u), max_event_loops);
+    for (unsigned i = 0; i < loop_count; ++i)
+    {
+        auto loop = std::make_unique<EventLoop>();
+        if (!loop->poller.isValid())
+        {
+            break;
+        }
+        event_loops.push_back(std::move(loop));
+    }
+    if (event_loops.empty())
+    {
+        LOG_ERROR("Failed to create event loop");
+        return;
+    }
+    // 监听socket同样非阻塞，可读时接受所有排队的连接
+    SOCKET_NONBLOCK(listen_socket);
+    event_loops[0]->poller.add(listen_socket);
+    for (size_t i = 0; i < event_loops.size(); ++i)
+    {
+        event_loops[i]->thread = std::thread(&FileReceiver::runLoop, this, i);
+    }
+}
 
-                                outer_parser->delegateRecv(accepted_socket,
-                                    [accepted_socket, msg_cb](std::unique_ptr<NetworkInterface::UserMsg> parsed_msg) {
-                                        msg_cb(accepted_socket, std::move(parsed_msg));
-                                    }, 
-                                    [this, accepted_socket]() {
-                                        // 连接关闭回调
-                                        LOG_INFO("Connection closed for socket: " << accepted_socket);
-                                        this->removeSocket(accepted_socket);
-                                    },
-                                    [](const NetworkInterface::RecvError error) {
-                                        // 接收错误回调
-                                        LOG_ERROR("Receive error: " << static_cast<int>(error));
-                                    },
-                                    security_instance, thread_running);
-                                    
-                            });
-                            
-                            {
-                                std::lock_guard<std::mutex> lock(threads_mutex);
-                                receive_threads.push_back(recv_thread);
-                            }
-                        }
-                        else
-                        {
-                            LOG_ERROR("Failed to accept connection: " << GET_SOCKET_ERROR);
-                        }
-                    }
-                }
-                else if (result < 0)
+void FileReceiver::runLoop(size_t loop_index)
+{
+    SocketPoller &poller = event_loops[loop_index]->poller;
+    std::vector<UnifiedSocket> ready;
+    while (running)
+    {
+        if (poller.wait(ready, -1) < 0)
+        {
+            LOG_ERROR("Error in poll: " << GET_SOCKET_ERROR);
+            break;
+        }
+        for (UnifiedSocket socket : ready)
+        {
+            if (!running)
+            {
+                break;
+            }
+            if (socket == listen_socket)
+            {
+                acceptConnection();
+                continue;
+            }
+            std::shared_ptr<Connection> connection;
+            {
+                std::lock_guard<std::mutex> lock(sockets_mutex);
+                // 同一批就绪事件中socket可能已关闭，其句柄又被复用给了其他循环的新连接
+                auto it = connections.find(socket);
+                if (it == connections.end() || it->second->loop_index != loop_index)
                 {
-                    LOG_ERROR("Error in poll: " << GET_SOCKET_ERROR);
-                    break;
+                    continue;
                 }
-                
-                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                connection = it->second;
+            }
+            bool is_open = outer_parser->receiveAvailable(socket, connection->recv_state,
+                                                          [this, socket](std::unique_ptr<NetworkInterface::UserMsg> parsed_msg)
+                                                          {
+                                                              uint64_t frame_size = sizeof(NetworkInterface::Header) + ntohl(parsed_msg->header.length);
+                                                              msg_cb(socket, std::move(parsed_msg));
+                                                              onFrameConsumed(socket, frame_size);
+                                                          },
+                                                          security_instance, max_bytes_per_wakeup);
+            if (!is_open && running)
+            {
+                LOG_INFO("Connection closed for socket: " << socket);
+                removeSocket(socket);
             }
+        }
+    }
+}
 
-            CLOSE_SOCKET(listen_socket); });
+void FileReceiver::acceptConnection()
+{
+    while (running)
+    {
+        sockaddr_in client_addr;
+        socklen_t client_addr_len = sizeof(client_addr);
+        UnifiedSocket accepted_socket = accept(listen_socket, (sockaddr *)&client_addr, &client_addr_len);
+        if (accepted_socket == INVALID_SOCKET_VAL)
+        {
+            int error = GET_SOCKET_ERROR;
+            if (error != SOCKET_EWOULDBLOCK && error != SOCKET_EINTR)
+            {
+                LOG_ERROR("Failed to accept connection: " << error);
+            }
+            return;
+        }
+        SOCKET_NONBLOCK(accepted_socket);
+        LOG_INFO("Accepted connection from "
+                 << inet_ntoa(client_addr.sin_addr) << ":"
+                 << ntohs(client_addr.sin_port));
+
+        // 先建立解析状态再授予初始信用，发送端据此确认对端支持流控
+        accept_cb(accepted_socket);
+        auto connection = std::make_shared<Connection>();
+        connection->granter = std::make_shared<CreditGranter>(accepted_socket);
+        {
+            std::lock_guard<std::mutex> lock(sockets_mutex);
+            auto least_loaded = std::min_element(event_loops.begin(), event_loops.end(),
+                                                 [](const std::unique_ptr<EventLoop> &a, const std::unique_ptr<EventLoop> &b)
+                                                 { return a->connection_count < b->connection_count; });
+            connection->loop_index = least_loaded - event_loops.begin();
+            ++(*least_loaded)->connection_count;
+            connections[accepted_socket] = connection;
+        }
+        connection->granter->start();
+        if (!event_loops[connection->loop_index]->poller.add(accepted_socket))
+        {
+            removeSocket(accepted_socket);
+        }
+    }
 }
 
 void FileReceiver::removeSocket(UnifiedSocket socket)
 {
     std::lock_guard<std::mutex> lock(sockets_mutex);
-    auto it = std::find(receive_sockets.begin(), receive_sockets.end(), socket);
-    if (it != receive_sockets.end())
+    auto it = connections.find(socket);
+    if (it != connections.end())
     {
+        auto &loop = event_loops[it->second->loop_index];
+        loop->poller.remove(socket);
+        --loop->connection_count;
         CLOSE_SOCKET(socket);
-        receive_sockets.erase(it);
+        connections.erase(it);
         LOG_INFO("Socket " << socket << " removed");
     }
 }
 
+void FileReceiver::onFrameConsumed(UnifiedSocket socket, uint64_t frame_size)
+{
+    std::shared_ptr<CreditGranter> granter;
+    {
+        std::lock_guard<std::mutex> lock(sockets_mutex);
+        auto it = connections.find(socket);
+        if (it == connections.end())
+        {
+            return;
+        }
+        granter = it->second->granter;
+    }
+    granter->onConsumed(frame_size);
+}
+
 void FileReceiver::closeReceiver()
 {
     running = false;
 
-    // 先关闭所有socket，这会中断阻塞的select/poll调用
+    // 先唤醒并等待所有事件循环退出，之后不再有线程访问连接
+    for (auto &loop : event_loops)
+    {
+        loop->poller.wakeup();
+    }
+    for (auto &loop : event_loops)
+    {
+        if (loop->thread.joinable())
+        {
+            loop->thread.join();
+        }
+    }
+
     {
         std::lock_guard<std::mutex> lock(sockets_mutex);
-        for (auto socket : receive_sockets)
+        for (auto &connection : connections)
         {
-            // 设置socket为异步关闭模式
 #ifdef _WIN32
-            // Windows上使用shutdown强制关闭
-            shutdown(socket, SD_BOTH);
+            shutdown(connection.first, SD_BOTH);
 #else
-            // Linux上使用shutdown中断阻塞调用
-            shutdown(socket, SHUT_RDWR);
+            shutdown(connection.first, SHUT_RDWR);
 #endif
-            CLOSE_SOCKET(socket);
+            CLOSE_SOCKET(connection.first);
         }
-        receive_sockets.clear();
+        connections.clear();
     }
+    event_loops.clear();
 
     // 关闭监听socket
     if (listen_socket != INVALID_SOCKET_VAL)
@@ -226,58 +275,10 @@ void FileReceiver::closeReceiver()
         listen_socket = INVALID_SOCKET_VAL;
     }
 
-    // 等待监听线程结束
-    if (tcp_listen_thread)
-    {
-        if (tcp_listen_thread->joinable())
-        {
-            tcp_listen_thread->join();
-        }
-        tcp_listen_thread.reset();
-        tcp_listen_thread = nullptr;
-    }
-
-    // 等待所有接收线程结束，设置超时避免无限等待
-    {
-        std::lock_guard<std::mutex> lock(threads_mutex);
-        for (auto thread : receive_threads)
-        {
-            if (thread->joinable())
-            {
-                // 设置超时，避免死锁
-                if (thread->joinable())
-                {
-                    // 尝试等待2秒
-                    auto start_time = std::chrono::steady_clock::now();
-                    bool thread_joined = false;
-
-                    while (std::chrono::steady_clock::now() - start_time < std::chrono::seconds(2))
-                    {
-                        if (thread->joinable())
-                        {
-                            thread->join();
-                            thread_joined = true;
-                            break;
-                        }
-                        std::this_thread::sleep_for(std::chrono::milliseconds(100));
-                    }
-
-                    if (!thread_joined)
-                    {
-                        LOG_ERROR("Warning: Thread failed to join in time, detaching");
-                        thread->detach();
-                    }
-                }
-            }
-            thread.reset();
-        }
-        receive_threads.clear();
-    }
-
     LOG_INFO("FileReceiver closed successfully");
 }
 
 void FileReceiver::stop()
 {
     closeReceiver();
-}
\ No newline at end of file
+}
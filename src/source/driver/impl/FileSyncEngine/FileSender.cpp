@@ -6,6 +6,13 @@
 #include <iostream>
 #include <cerrno>
 #include <cstring>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#include <netinet/tcp.h>
+#endif
+#ifndef _WIN32
+#include <sys/uio.h>
+#endif
 
 bool FileSender::initialize()
 {
@@ -43,11 +50,23 @@ bool FileSender::initialize()
         return false;
     }
 
+    credit_account = std::make_unique<CreditAccount>(client_socket);
+    if (!credit_account->handshake())
+    {
+        LOG_INFO("Peer does not grant credits, flow control disabled");
+        credit_account.reset();
+    }
+
     file_msg_builder = std::make_unique<FileMsgBuilder>();
+    block_compressor = std::make_unique<BlockCompressor>(compression_instance);
     if (security_instance)
     {
         getOuterMsgBuilder().setSecurityInstance(security_instance);
     }
+#ifdef __linux__
+    // 不加密时文件载荷用sendfile直接从页缓存发出
+    file_msg_builder->setZeroCopy(!security_instance);
+#endif
 
     LOG_INFO("FileSender initialized successfully");
     return true;
@@ -58,28 +77,106 @@ void FileSender::sendMsg(std::vector<uint8_t> &&msg, bool is_binary)
     if (msg.empty() || client_socket == INVALID_SOCKET_VAL)
         return;
 
-    NetworkInterface::Flag flag = NetworkInterface::Flag::IS_ENCRYPT;
+    // 没有安全实例时消息不会被加密，不能声明IS_ENCRYPT
+    NetworkInterface::Flag flag = security_instance ? NetworkInterface::Flag::IS_ENCRYPT : static_cast<NetworkInterface::Flag>(0);
     if (is_binary)
     {
         flag = static_cast<NetworkInterface::Flag>(static_cast<uint8_t>(flag) |
                                                    static_cast<uint8_t>(NetworkInterface::Flag::IS_BINARY));
+        // 先压缩再加密，不可压缩的块原样发送
+        std::vector<uint8_t> compressed;
+        if (block_compressor->compress(msg, compressed))
+        {
+            msg = std::move(compressed);
+            flag = flag | NetworkInterface::Flag::IS_COMPRESS;
+        }
     }
 
-    auto ready_to_send_msg = getOuterMsgBuilder().buildMsg(msg, flag);
-    if (!ready_to_send_msg)
+    // 载荷原地加密后与Header分开发出，不再拼接
+    auto frame = getOuterMsgBuilder().buildFrame(std::move(msg), flag);
+    if (!frame)
     {
         LOG_ERROR("Failed to build message");
         return;
     }
+    // 接收端处理不过来时在此等待信用
+    if (credit_account && !credit_account->acquire(frame->head.size() + frame->payload.size(), running))
+    {
+        return;
+    }
+
+    sendFrame(*frame);
+}
 
-    size_t final_msg_length = ready_to_send_msg->data.size();
+bool FileSender::sendFrame(const OuterMsgBuilderInterface::Frame &frame)
+{
+    const std::vector<uint8_t> *parts[] = {&frame.head, &frame.payload};
+    size_t length = frame.head.size() + frame.payload.size();
     size_t sended_length = 0;
 
-    while (sended_length < final_msg_length && running)
+    while (sended_length < length && running)
+    {
+        // 跳过已发出的部分，其余部分一次系统调用发出
+#ifdef _WIN32
+        WSABUF buffers[2];
+#else
+        struct iovec buffers[2];
+#endif
+        size_t count = 0;
+        size_t skip = sended_length;
+        for (auto part : parts)
+        {
+            if (skip >= part->size())
+            {
+                skip -= part->size();
+                continue;
+            }
+#ifdef _WIN32
+            buffers[count].buf = const_cast<char *>(reinterpret_cast<const char *>(part->data() + skip));
+            buffers[count].len = static_cast<ULONG>(part->size() - skip);
+#else
+            buffers[count].iov_base = const_cast<uint8_t *>(part->data() + skip);
+            buffers[count].iov_len = part->size() - skip;
+#endif
+            ++count;
+            skip = 0;
+        }
+
+#ifdef _WIN32
+        DWORD sent = 0;
+        int ret = WSASend(client_socket, buffers, static_cast<DWORD>(count), &sent, 0, nullptr, nullptr) == 0
+                      ? static_cast<int>(sent)
+                      : -1;
+#else
+        struct msghdr header = {};
+        header.msg_iov = buffers;
+        header.msg_iovlen = count;
+        ssize_t ret = sendmsg(client_socket, &header, 0);
+#endif
+        if (ret <= 0)
+        {
+            int err = GET_SOCKET_ERROR;
+            if (err == SOCKET_EINTR)
+            {
+                continue; // 被信号中断，重试
+            }
+            LOG_ERROR("Send failed, error: " << err);
+            return false;
+        }
+        sended_length += ret;
+    }
+    return sended_length == length;
+}
+
+bool FileSender::sendAll(const uint8_t *data, size_t length, int flags)
+{
+    size_t sended_length = 0;
+
+    while (sended_length < length && running)
     {
         int ret = send(client_socket,
-                       reinterpret_cast<const char *>(ready_to_send_msg->data.data() + sended_length),
-                       static_cast<int>(final_msg_length - sended_length), 0);
+                       reinterpret_cast<const char *>(data + sended_length),
+                       static_cast<int>(length - sended_length), flags);
         if (ret <= 0)
         {
             int err = GET_SOCKET_ERROR;
@@ -88,13 +185,60 @@ void FileSender::sendMsg(std::vector<uint8_t> &&msg, bool is_binary)
                 continue; // 被信号中断，重试
             }
             LOG_ERROR("Send failed, error: " << err);
-            break;
+            return false;
         }
         sended_length += ret;
     }
+    return sended_length == length;
 }
 
-void FileSender::start(std::function<std::optional<std::pair<uint32_t, std::string>>()> get_task_cb)
+#ifdef __linux__
+void FileSender::sendFileRegion(std::vector<uint8_t> &&prefix, FileStreamHelper::PositionalReader &source,
+                                uint64_t offset, uint32_t length)
+{
+    if (client_socket == INVALID_SOCKET_VAL)
+        return;
+
+    // Header与块前缀一起发出，MSG_MORE让内核与随后的文件数据合并成满包
+    auto frame = getOuterMsgBuilder().buildHeader(static_cast<uint32_t>(prefix.size()) + length,
+                                                  NetworkInterface::Flag::IS_BINARY);
+    frame.insert(frame.end(), prefix.begin(), prefix.end());
+    if (credit_account && !credit_account->acquire(frame.size() + length, running))
+    {
+        return;
+    }
+    if (!sendAll(frame.data(), frame.size(), MSG_MORE))
+    {
+        return;
+    }
+
+    off_t file_offset = static_cast<off_t>(offset);
+    size_t remaining = length;
+    while (remaining > 0 && running)
+    {
+        ssize_t ret = sendfile(client_socket, source.nativeHandle(), &file_offset, remaining);
+        if (ret < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (ret <= 0)
+        {
+            LOG_ERROR("Sendfile failed, error: " << (ret < 0 ? errno : 0));
+            break;
+        }
+        remaining -= ret;
+    }
+
+    if (remaining > 0 && running)
+    {
+        // 文件被截断等情况下补零，保证接收端的帧边界不被破坏
+        std::vector<uint8_t> padding(remaining, 0);
+        sendAll(padding.data(), padding.size(), 0);
+    }
+}
+#endif
+
+void FileSender::start(std::function<std::optional<FileSyncEngineInterface::SendTask>()> get_task_cb)
 {
     if (!running)
     {
@@ -102,87 +246,182 @@ void FileSender::start(std::function<std::optional<std::pair<uint32_t, std::stri
 
         send_thread = new std::thread([this, get_task_cb]()
                                       {
-            static uint8_t progress_count = 0;
+            // 每个发送线程单独计数
+            uint8_t progress_count = 0;
             
             while (running)
             {
-                // 检查是否有任务
-                bool has_task = false;
+                // 阻塞直到调度器分配任务，调度器停止后返回空
+                auto pending_file = get_task_cb();
+                if (!pending_file.has_value())
                 {
-                    std::unique_lock<std::mutex> lock(mtx);
-                    if (check_queue_cb) {
-                        has_task = check_queue_cb();
-                    }
+                    break;
                 }
+                auto& task = pending_file.value();
+                uint32_t id = task.id;
                 
-                if (!has_task) {
-                    // 没有任务，等待一段时间
-                    std::this_thread::sleep_for(std::chrono::milliseconds(100));
-                    continue;
+                // 设置文件信息，块大小取决于之前测得的链路状况
+                file_msg_builder->setFileInfo(id, task.path);
+                file_msg_builder->setBlockSize(block_size_tuner.blockSize());
+                block_compressor->reset();
+                if (task.is_stripe)
+                {
+                    file_msg_builder->setStripeInfo(task.offset, task.length,
+                                                    task.stripe_progress && task.stripe_progress->merkle_root.valid());
                 }
-                
-                auto pending_file = get_task_cb();
-                if (pending_file.has_value())
+                else if (task.dir_work)
                 {
-                    auto& [id, file_path] = pending_file.value();
-                    
-                    // 设置文件信息
-                    file_msg_builder->setFileInfo(id, file_path);
-                    
-                    // 获取并发送文件流
-                    FileMsgBuilderInterface::FileMsgBuilderResult msg;
-                    start_time_point = std::chrono::steady_clock::now();
-                    bytes_sent = 0;
-                    
-                    do {
-                        msg = file_msg_builder->getStream();
-                        if (msg.data && !msg.data->empty()) {
-                            bytes_sent += static_cast<uint32_t>(msg.data->size());
+                    file_msg_builder->setDirectoryWork(task.dir_work);
+                }
+                else if (task.is_chunk_manifest)
+                {
+                    file_msg_builder->setChunkManifest();
+                }
+                else if (task.delta_signature)
+                {
+                    file_msg_builder->setDeltaSignature(task.delta_signature);
+                }
+                
+                // 获取并发送文件流
+                FileMsgBuilderInterface::FileMsgBuilderResult msg;
+                start_time_point = std::chrono::steady_clock::now();
+                bytes_sent = 0;
+                // 载荷发送时被移入帧，先记下本次是否取到数据
+                bool has_data = false;
+                
+                do {
+                    msg = file_msg_builder->getStream();
+                    has_data = msg.data && !msg.data->empty();
+                    if (has_data) {
+                        if (rate_limiter)
+                        {
+                            rate_limiter->acquire(id, msg.data->size() + msg.source_length);
+                        }
+                        bytes_sent += static_cast<uint32_t>(msg.data->size() + msg.source_length);
+                        if (task.stripe_progress && msg.is_binary)
+                        {
+                            task.stripe_progress->sent_size += msg.data->size() + msg.source_length - FileSyncEngineInterface::block_header_size;
+                        }
+#ifdef __linux__
+                        if (msg.source)
+                        {
+                            sendFileRegion(std::move(*msg.data), *msg.source, msg.source_offset, msg.source_length);
+                        }
+                        else
+#endif
+                        {
                             sendMsg(std::move(*msg.data), msg.is_binary);
                         }
+                    }
+                    
+                    // 每处理40个数据块发送一次进度
+                    if (progress_count >= 40)
+                    {
+                        end_time_point = std::chrono::steady_clock::now();
+                        auto elapsed_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                            end_time_point - start_time_point);
+                        
+                        sampleLink(bytes_sent, elapsed_us);
+                        uint32_t speed_bps = 0;
+                        if (elapsed_us.count() > 0) {
+                            uint64_t bps = (static_cast<uint64_t>(bytes_sent) * 1000000ULL) / 
+                                          static_cast<uint64_t>(elapsed_us.count());
+                            speed_bps = static_cast<uint32_t>(bps);
+                            bytes_sent = 0;
+                        }
                         
-                        // 每处理40个数据块发送一次进度
-                        if (progress_count >= 40)
+                        start_time_point = std::chrono::steady_clock::now();
+                        if (task.stripe_progress)
+                        {
+                            reportStripeProgress(id, *task.stripe_progress);
+                        }
+                        else
                         {
-                            end_time_point = std::chrono::steady_clock::now();
-                            auto elapsed_us = std::chrono::duration_cast<std::chrono::microseconds>(
-                                end_time_point - start_time_point);
-                            
-                            uint32_t speed_bps = 0;
-                            if (elapsed_us.count() > 0) {
-                                uint64_t bps = (static_cast<uint64_t>(bytes_sent) * 1000000ULL) / 
-                                              static_cast<uint64_t>(elapsed_us.count());
-                                speed_bps = static_cast<uint32_t>(bps);
-                                bytes_sent = 0;
-                            }
-                            
-                            start_time_point = std::chrono::steady_clock::now();
                             EventBusManager::instance().publish("/file/upload_progress", 
                                 id, msg.progress, speed_bps, false);
-                            progress_count = 0;
                         }
-                        ++progress_count;
-                        
-                    } while (msg.data && !msg.data->empty());
+                        progress_count = 0;
+                    }
+                    ++progress_count;
                     
+                } while (has_data && running);
+
+                // 数据量太小时耗时主要是延迟，不作为吞吐样本
+                if (bytes_sent >= FileSyncEngineInterface::max_block_size)
+                {
+                    sampleLink(bytes_sent, std::chrono::duration_cast<std::chrono::microseconds>(
+                                               std::chrono::steady_clock::now() - start_time_point));
+                }
+                
+                // 停止时任务未发送完，不发布完成事件
+                // 条带与文件夹部分任务由最后完成的发送线程发布完成事件
+                // 发出分块清单时由接收端决定：续传缺失区间的条带完成或接收端回复manifest_satisfied时完成
+                bool is_complete = running && !file_msg_builder->isChunkManifest();
+                if (is_complete && task.stripe_progress)
+                {
+                    is_complete = task.stripe_progress->remaining.fetch_sub(1) == 1;
+                    if (is_complete && task.stripe_progress->merkle_root.valid())
+                    {
+                        // 根与条带并行计算，通常此时已经算完；计算失败时发送空根，接收端不再等待
+                        MerkleTree::FileRoot root = task.stripe_progress->merkle_root.get();
+                        sendMsg(std::move(*file_msg_builder->buildStripeRoot(root.root, root.spans)), false);
+                    }
+                }
+                if (is_complete)
+                {
                     // 发送完成事件
                     EventBusManager::instance().publish("/file/upload_progress", 
                         id, static_cast<uint8_t>(100), static_cast<uint32_t>(0), true);
-                    progress_count = 0;
                 }
+                progress_count = 0;
             }
             
             LOG_INFO("FileSender thread exited"); });
     }
 }
 
-void FileSender::stop()
+void FileSender::sampleLink(uint64_t bytes, std::chrono::microseconds elapsed)
 {
-    running = false;
-    if (send_thread)
+#ifdef __linux__
+    tcp_info info{};
+    socklen_t info_len = sizeof(info);
+    if (getsockopt(client_socket, IPPROTO_TCP, TCP_INFO, &info, &info_len) == 0)
     {
-        cv.notify_all();
+        block_size_tuner.onTcpInfo(info.tcpi_rtt, info.tcpi_total_retrans);
     }
+#endif
+    block_size_tuner.onSent(bytes, elapsed);
+}
+
+void FileSender::reportStripeProgress(uint32_t id, FileSyncEngineInterface::StripeProgress &progress)
+{
+    uint8_t percent = 0;
+    uint32_t speed_bps = 0;
+    {
+        // 速度按所有连接汇总计算
+        std::lock_guard<std::mutex> lock(progress.report_mutex);
+        auto now = std::chrono::steady_clock::now();
+        uint64_t sent = progress.sent_size.load();
+        auto elapsed_us = std::chrono::duration_cast<std::chrono::microseconds>(now - progress.report_time);
+        if (elapsed_us.count() > 0)
+        {
+            speed_bps = static_cast<uint32_t>(((sent - progress.reported_size) * 1000000ULL) /
+                                              static_cast<uint64_t>(elapsed_us.count()));
+        }
+        progress.reported_size = sent;
+        progress.report_time = now;
+        if (progress.total_size > 0)
+        {
+            uint64_t effective_size = (sent > progress.total_size) ? progress.total_size : sent;
+            percent = static_cast<uint8_t>((effective_size * 100 + progress.total_size / 2) / progress.total_size);
+        }
+    }
+    EventBusManager::instance().publish("/file/upload_progress", id, percent, speed_bps, false);
+}
+
+void FileSender::stop()
+{
+    running = false;
 }
 
 FileSender::~FileSender()
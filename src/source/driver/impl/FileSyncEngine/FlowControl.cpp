@@ -0,0 +1,139 @@
+#include "driver/impl/FileSyncEngine/FlowControl.h"
+#include "common/DebugOutputer.h"
+
+#include <algorithm>
+
+namespace
+{
+    int pollSocket(UnifiedSocket socket, short events, int timeout_ms)
+    {
+#ifdef _WIN32
+        WSAPOLLFD fds[1];
+        fds[0].fd = socket;
+        fds[0].events = events;
+        return WSAPoll(fds, 1, timeout_ms);
+#else
+        pollfd fds[1];
+        fds[0].fd = socket;
+        fds[0].events = events;
+        return poll(fds, 1, timeout_ms);
+#endif
+    }
+}
+
+CreditGranter::CreditGranter(UnifiedSocket socket) : socket(socket)
+{
+}
+
+bool CreditGranter::start()
+{
+    return grant();
+}
+
+void CreditGranter::onConsumed(uint64_t frame_size)
+{
+    consumed_size += frame_size;
+    // 发送端可能透支一帧，在途字节按有符号计算
+    int64_t in_flight = static_cast<int64_t>(granted_size - consumed_size);
+    if (static_cast<int64_t>(credit_window) - in_flight >= static_cast<int64_t>(grant_threshold))
+    {
+        grant();
+    }
+}
+
+bool CreditGranter::grant()
+{
+    uint64_t total = consumed_size + credit_window;
+    uint8_t msg[8];
+    for (int i = 0; i < 8; ++i)
+    {
+        msg[i] = static_cast<uint8_t>(total >> ((7 - i) * 8));
+    }
+    // 接收socket为非阻塞，反向几乎没有数据，发送缓冲区满时等待可写
+    size_t sent = 0;
+    while (sent < sizeof(msg))
+    {
+        int ret = send(socket, reinterpret_cast<const char *>(msg + sent), static_cast<int>(sizeof(msg) - sent), 0);
+        if (ret > 0)
+        {
+            sent += ret;
+            continue;
+        }
+        int err = GET_SOCKET_ERROR;
+        if (ret < 0 && (err == SOCKET_EWOULDBLOCK || err == SOCKET_EINTR) &&
+            pollSocket(socket, POLLOUT, 1000) > 0)
+        {
+            continue;
+        }
+        LOG_ERROR("Failed to send credit, error: " << err);
+        return false;
+    }
+    granted_size = total;
+    return true;
+}
+
+CreditAccount::CreditAccount(UnifiedSocket socket) : socket(socket)
+{
+}
+
+bool CreditAccount::handshake()
+{
+    auto deadline = std::chrono::steady_clock::now() + handshake_timeout;
+    while (granted_size == 0)
+    {
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        if (remaining.count() <= 0 || !readGrants(static_cast<int>(remaining.count())))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool CreditAccount::acquire(uint64_t frame_size, const bool &running)
+{
+    if (!readGrants(0))
+    {
+        return false;
+    }
+    while (sent_size >= granted_size)
+    {
+        if (!running || !readGrants(100))
+        {
+            return false;
+        }
+    }
+    sent_size += frame_size;
+    return true;
+}
+
+bool CreditAccount::readGrants(int timeout_ms)
+{
+    while (pollSocket(socket, POLLIN, timeout_ms) > 0)
+    {
+        int ret = recv(socket, reinterpret_cast<char *>(partial + partial_size), static_cast<int>(sizeof(partial) - partial_size), 0);
+        if (ret <= 0)
+        {
+            if (ret < 0 && GET_SOCKET_ERROR == SOCKET_EINTR)
+            {
+                continue;
+            }
+            LOG_ERROR("Credit channel closed, error: " << (ret < 0 ? GET_SOCKET_ERROR : 0));
+            return false;
+        }
+        partial_size += ret;
+        if (partial_size == sizeof(partial))
+        {
+            uint64_t total = 0;
+            for (size_t i = 0; i < sizeof(partial); ++i)
+            {
+                total = (total << 8) | partial[i];
+            }
+            granted_size = (std::max)(granted_size, total);
+            partial_size = 0;
+        }
+        // 已读到的授予之后不再等待
+        timeout_ms = 0;
+    }
+    return true;
+}
@@ -0,0 +1,372 @@
+#include "driver/impl/FileSyncEngine/MerkleTree.h"
+#include "driver/impl/FileUtility.h"
+#include "common/DebugOutputer.h"
+
+#include <openssl/evp.h>
+#include <openssl/sha.h>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <thread>
+
+namespace
+{
+    const uint8_t leaf_prefix = 0x00;
+    const uint8_t node_prefix = 0x01;
+
+    std::string toHex(const MerkleTree::Digest &digest)
+    {
+        static const char hex_digits[] = "0123456789abcdef";
+        std::string result;
+        result.reserve(digest.size() * 2);
+        for (uint8_t byte : digest)
+        {
+            result.push_back(hex_digits[byte >> 4]);
+            result.push_back(hex_digits[byte & 0x0F]);
+        }
+        return result;
+    }
+
+    EVP_MD_CTX *beginLeaf()
+    {
+        EVP_MD_CTX *ctx = EVP_MD_CTX_new();
+        EVP_DigestInit_ex(ctx, EVP_sha256(), nullptr);
+        EVP_DigestUpdate(ctx, &leaf_prefix, sizeof(leaf_prefix));
+        return ctx;
+    }
+
+    MerkleTree::Digest endLeaf(EVP_MD_CTX *ctx)
+    {
+        MerkleTree::Digest digest{};
+        unsigned int length = 0;
+        EVP_DigestFinal_ex(ctx, digest.data(), &length);
+        EVP_MD_CTX_free(ctx);
+        return digest;
+    }
+}
+
+uint64_t MerkleTree::leafCount(uint64_t file_size)
+{
+    return file_size == 0 ? 1 : (file_size + leaf_size - 1) / leaf_size;
+}
+
+uint64_t MerkleTree::spanLeaves(uint64_t leaf_count)
+{
+    // 段按2的幂对齐，各段的根就是树中对应的节点
+    uint64_t span = 1;
+    while ((leaf_count + span - 1) / span > max_spans)
+    {
+        span *= 2;
+    }
+    return span;
+}
+
+MerkleTree::Digest MerkleTree::hashLeaf(const uint8_t *data, size_t size)
+{
+    EVP_MD_CTX *ctx = beginLeaf();
+    EVP_DigestUpdate(ctx, data, size);
+    return endLeaf(ctx);
+}
+
+std::string MerkleTree::rootOf(const std::vector<Digest> &leaves)
+{
+    if (leaves.empty())
+    {
+        return toHex(hashLeaf(nullptr, 0));
+    }
+    std::vector<Digest> level = leaves;
+    uint8_t buffer[1 + SHA256_DIGEST_LENGTH * 2];
+    buffer[0] = node_prefix;
+    while (level.size() > 1)
+    {
+        size_t next_size = 0;
+        for (size_t i = 0; i < level.size(); i += 2)
+        {
+            if (i + 1 == level.size())
+            {
+                level[next_size++] = level[i];
+                break;
+            }
+            memcpy(buffer + 1, level[i].data(), SHA256_DIGEST_LENGTH);
+            memcpy(buffer + 1 + SHA256_DIGEST_LENGTH, level[i + 1].data(), SHA256_DIGEST_LENGTH);
+            SHA256(buffer, sizeof(buffer), level[next_size++].data());
+        }
+        level.resize(next_size);
+    }
+    return toHex(level[0]);
+}
+
+std::string MerkleTree::spansOf(const std::vector<Digest> &leaves)
+{
+    uint64_t span = spanLeaves(leaves.size());
+    std::string result;
+    result.reserve((leaves.size() + span - 1) / span * span_digest_size);
+    for (uint64_t begin = 0; begin < leaves.size(); begin += span)
+    {
+        uint64_t end = (std::min)(begin + span, static_cast<uint64_t>(leaves.size()));
+        std::vector<Digest> span_leaves(leaves.begin() + begin, leaves.begin() + end);
+        result += rootOf(span_leaves).substr(0, span_digest_size);
+    }
+    return result;
+}
+
+bool MerkleTree::hashLeaves(const std::wstring &path, uint64_t file_size, const std::vector<uint64_t> &indices,
+                            std::vector<Digest> &digests, const std::atomic<bool> *stop)
+{
+    if (indices.empty())
+    {
+        return true;
+    }
+    std::vector<uint64_t> data_indices;
+    {
+        FileStreamHelper::PositionalReader reader(path);
+        std::vector<std::pair<uint64_t, uint64_t>> holes;
+        if (reader.isOpen())
+        {
+            holes = reader.findHoles(file_size, leaf_size, leaf_size);
+        }
+        Digest zero_digest{};
+        if (!holes.empty())
+        {
+            std::vector<uint8_t> zeros(leaf_size, 0);
+            zero_digest = hashLeaf(zeros.data(), zeros.size());
+        }
+        for (uint64_t index : indices)
+        {
+            // 空洞按叶子对齐，找到起点不超过叶子起点的最后一个空洞
+            uint64_t offset = index * leaf_size;
+            auto it = std::upper_bound(holes.begin(), holes.end(), offset,
+                                       [](uint64_t value, const std::pair<uint64_t, uint64_t> &hole)
+                                       { return value < hole.first; });
+            if (it != holes.begin() && offset + leaf_size <= file_size &&
+                offset + leaf_size <= std::prev(it)->first + std::prev(it)->second)
+            {
+                digests[index] = zero_digest;
+            }
+            else
+            {
+                data_indices.push_back(index);
+            }
+        }
+    }
+    if (data_indices.empty())
+    {
+        return true;
+    }
+    unsigned thread_count = (std::max)(1u, (std::min)(std::thread::hardware_concurrency(), max_threads));
+    thread_count = static_cast<unsigned>((std::min)(static_cast<size_t>(thread_count), data_indices.size()));
+    size_t per_thread = (data_indices.size() + thread_count - 1) / thread_count;
+    std::atomic<bool> is_ok{true};
+
+    auto work = [&](size_t begin, size_t end)
+    {
+        FileStreamHelper::PositionalReader reader(path);
+        if (!reader.isOpen())
+        {
+            is_ok = false;
+            return;
+        }
+        std::vector<uint8_t> data(leaf_size);
+        for (size_t i = begin; i < end && is_ok; ++i)
+        {
+            if (stop && *stop)
+            {
+                is_ok = false;
+                return;
+            }
+            uint64_t offset = data_indices[i] * leaf_size;
+            size_t size = static_cast<size_t>((std::min)(static_cast<uint64_t>(leaf_size), file_size - (std::min)(file_size, offset)));
+            if (reader.readAt(offset, data.data(), size) != size)
+            {
+                is_ok = false;
+                return;
+            }
+            digests[data_indices[i]] = hashLeaf(data.data(), size);
+        }
+    };
+
+    // 每个线程负责一段连续的叶子，读取保持顺序
+    std::vector<std::thread> threads;
+    for (unsigned t = 1; t < thread_count; ++t)
+    {
+        size_t begin = t * per_thread;
+        threads.emplace_back(work, begin, (std::min)(begin + per_thread, data_indices.size()));
+    }
+    work(0, (std::min)(per_thread, data_indices.size()));
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+    if (!is_ok && !(stop && *stop))
+    {
+        LOG_ERROR("Failed to hash: " << FileStreamHelper::wstringToLocalPath(path));
+    }
+    return is_ok;
+}
+
+MerkleTree::FileRoot MerkleTree::computeFile(const std::wstring &path, const std::atomic<bool> *stop)
+{
+    uint64_t file_size = FileSystemUtils::getFileSize(FileStreamHelper::wstringToLocalPath(path));
+    std::vector<Digest> digests(leafCount(file_size));
+    std::vector<uint64_t> indices(digests.size());
+    for (uint64_t i = 0; i < indices.size(); ++i)
+    {
+        indices[i] = i;
+    }
+    if (!hashLeaves(path, file_size, indices, digests, stop))
+    {
+        return {};
+    }
+    return {rootOf(digests), spansOf(digests)};
+}
+
+MerkleVerifier::MerkleVerifier(const std::wstring &path, uint64_t total_size)
+    : path(path), total_size(total_size), reader(path), leaves(MerkleTree::leafCount(total_size))
+{
+}
+
+MerkleVerifier::~MerkleVerifier()
+{
+    for (auto &leaf : leaves)
+    {
+        EVP_MD_CTX_free(leaf.ctx);
+    }
+}
+
+uint32_t MerkleVerifier::leafSize(uint64_t index) const
+{
+    uint64_t offset = index * MerkleTree::leaf_size;
+    return static_cast<uint32_t>((std::min)(static_cast<uint64_t>(MerkleTree::leaf_size), total_size - (std::min)(total_size, offset)));
+}
+
+void MerkleVerifier::update(uint64_t offset, const uint8_t *data, size_t size)
+{
+    if (size == 0 || offset + size > total_size)
+    {
+        return;
+    }
+    std::vector<uint8_t> readback;
+    if (!data)
+    {
+        // 刚写入的数据还在页缓存中
+        readback.resize(size);
+        if (!reader.isOpen() || reader.readAt(offset, readback.data(), size) != size)
+        {
+            return;
+        }
+        data = readback.data();
+    }
+    while (size > 0)
+    {
+        uint64_t index = offset / MerkleTree::leaf_size;
+        uint32_t leaf_offset = static_cast<uint32_t>(offset % MerkleTree::leaf_size);
+        uint32_t piece = static_cast<uint32_t>((std::min)(static_cast<uint64_t>(leafSize(index) - leaf_offset), static_cast<uint64_t>(size)));
+        updateLeaf(index, leaf_offset, data, piece);
+        offset += piece;
+        data += piece;
+        size -= piece;
+    }
+}
+
+void MerkleVerifier::updateLeaf(uint64_t index, uint32_t leaf_offset, const uint8_t *data, uint32_t size)
+{
+    Leaf &leaf = leaves[index];
+    EVP_MD_CTX *ctx = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (leaf.is_broken)
+        {
+            return;
+        }
+        if (leaf.is_done || leaf_offset != leaf.streamed_size)
+        {
+            // 已计算的内容可能被覆盖，结束时以文件为准
+            leaf.is_broken = true;
+            leaf.is_done = false;
+            EVP_MD_CTX_free(leaf.ctx);
+            leaf.ctx = nullptr;
+            return;
+        }
+        // 取出上下文在锁外计算，同一叶子只会由一个连接按顺序写入
+        ctx = leaf.ctx ? leaf.ctx : beginLeaf();
+        leaf.ctx = nullptr;
+    }
+    EVP_DigestUpdate(ctx, data, size);
+    std::lock_guard<std::mutex> lock(mtx);
+    leaf.streamed_size += size;
+    if (leaf.streamed_size == leafSize(index))
+    {
+        leaf.digest = endLeaf(ctx);
+        leaf.is_done = true;
+    }
+    else
+    {
+        leaf.ctx = ctx;
+    }
+}
+
+std::string MerkleVerifier::finish()
+{
+    digests.assign(leaves.size(), MerkleTree::Digest{});
+    std::vector<uint64_t> missing;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        for (uint64_t i = 0; i < leaves.size(); ++i)
+        {
+            if (leaves[i].is_done)
+            {
+                digests[i] = leaves[i].digest;
+            }
+            else
+            {
+                missing.push_back(i);
+            }
+        }
+    }
+    if (!missing.empty())
+    {
+        LOG_INFO("Hash " << missing.size() << "/" << leaves.size() << " leaves from "
+                         << FileStreamHelper::wstringToLocalPath(path));
+    }
+    if (!MerkleTree::hashLeaves(path, total_size, missing, digests))
+    {
+        digests.clear();
+        return "";
+    }
+    return MerkleTree::rootOf(digests);
+}
+
+std::string MerkleVerifier::spans() const
+{
+    return digests.empty() ? "" : MerkleTree::spansOf(digests);
+}
+
+std::vector<std::pair<uint64_t, uint64_t>> MerkleVerifier::mismatchedRanges(const std::string &expected_spans) const
+{
+    std::string actual_spans = spans();
+    if (actual_spans.empty() || actual_spans.size() != expected_spans.size())
+    {
+        return {{0, total_size}};
+    }
+    uint64_t span_size = MerkleTree::spanLeaves(digests.size()) * MerkleTree::leaf_size;
+    std::vector<std::pair<uint64_t, uint64_t>> ranges;
+    for (size_t i = 0; i < actual_spans.size(); i += MerkleTree::span_digest_size)
+    {
+        if (actual_spans.compare(i, MerkleTree::span_digest_size, expected_spans, i, MerkleTree::span_digest_size) == 0)
+        {
+            continue;
+        }
+        uint64_t offset = i / MerkleTree::span_digest_size * span_size;
+        uint64_t length = (std::min)(span_size, total_size - offset);
+        // 相邻的段合并为一个区间
+        if (!ranges.empty() && ranges.back().first + ranges.back().second == offset)
+        {
+            ranges.back().second += length;
+        }
+        else
+        {
+            ranges.push_back({offset, length});
+        }
+    }
+    return ranges;
+}
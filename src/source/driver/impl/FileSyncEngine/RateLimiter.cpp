@@ -0,0 +1,114 @@
+#include "driver/impl/FileSyncEngine/RateLimiter.h"
+
+#include <algorithm>
+
+void TokenBucket::refill()
+{
+    auto now = std::chrono::steady_clock::now();
+    double elapsed = std::chrono::duration<double>(now - last_time).count();
+    last_time = now;
+    double burst = static_cast<double>(rate_bps) * std::chrono::duration<double>(burst_time).count();
+    tokens = (std::min)(burst, tokens + static_cast<double>(rate_bps) * elapsed);
+}
+
+void TokenBucket::setRate(uint64_t bytes_per_second)
+{
+    // 按旧速率结算后再切换
+    refill();
+    rate_bps = bytes_per_second;
+    if (rate_bps == 0)
+    {
+        tokens = 0;
+    }
+}
+
+std::chrono::microseconds TokenBucket::tryConsume(uint64_t bytes)
+{
+    if (rate_bps == 0)
+    {
+        return std::chrono::microseconds(0);
+    }
+    refill();
+    if (tokens < 0)
+    {
+        double wait_us = -tokens * 1000000.0 / static_cast<double>(rate_bps);
+        return std::chrono::microseconds(static_cast<int64_t>(wait_us) + 1);
+    }
+    tokens -= static_cast<double>(bytes);
+    return std::chrono::microseconds(0);
+}
+
+void RateLimiter::setGlobalRate(uint64_t bytes_per_second)
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        global_bucket.setRate(bytes_per_second);
+    }
+    // 等待中的发送线程按新速率重新计算
+    cv.notify_all();
+}
+
+void RateLimiter::setTransferRate(uint32_t id, uint64_t bytes_per_second)
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (bytes_per_second == 0)
+        {
+            transfer_buckets.erase(id);
+        }
+        else
+        {
+            transfer_buckets[id].setRate(bytes_per_second);
+        }
+    }
+    cv.notify_all();
+}
+
+bool RateLimiter::acquireFrom(std::unique_lock<std::mutex> &lock, uint32_t id, bool is_global, uint64_t bytes)
+{
+    while (!is_interrupted)
+    {
+        TokenBucket *bucket = &global_bucket;
+        if (!is_global)
+        {
+            // 等待期间限速可能被取消
+            auto it = transfer_buckets.find(id);
+            if (it == transfer_buckets.end())
+            {
+                return true;
+            }
+            bucket = &it->second;
+        }
+        auto wait_time = bucket->tryConsume(bytes);
+        if (wait_time.count() == 0)
+        {
+            return true;
+        }
+        cv.wait_for(lock, wait_time);
+    }
+    return false;
+}
+
+void RateLimiter::acquire(uint32_t id, uint64_t bytes)
+{
+    std::unique_lock<std::mutex> lock(mtx);
+    if (acquireFrom(lock, id, false, bytes))
+    {
+        acquireFrom(lock, id, true, bytes);
+    }
+}
+
+void RateLimiter::interrupt()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        is_interrupted = true;
+    }
+    cv.notify_all();
+}
+
+void RateLimiter::resume()
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    is_interrupted = false;
+}
@@ -0,0 +1,186 @@
+#include "driver/impl/FileSyncEngine/TransferJournal.h"
+#include "driver/interface/FileStreamHelper.h"
+#include "driver/impl/FileUtility.h"
+#include <sstream>
+
+TransferJournal::TransferJournal(const std::wstring &path) : data_path(path), journal_path(path + journal_suffix)
+{
+}
+
+bool TransferJournal::load(uint64_t expected_size)
+{
+    committed.clear();
+    committed_size = 0;
+
+    auto reader = FileStreamHelper::createInputFileStream(journal_path);
+    if (!reader || !reader->is_open())
+    {
+        return false;
+    }
+
+    std::string first_line;
+    std::getline(*reader, first_line);
+    std::istringstream first_iss(first_line);
+    uint64_t size = 0;
+    if (!(first_iss >> size) || (expected_size != 0 && size != expected_size))
+    {
+        return false;
+    }
+    reset(size);
+    first_iss >> merkle_root >> merkle_spans;
+
+    uint64_t offset = 0;
+    uint64_t length = 0;
+    uint64_t max_end = 0;
+    while (*reader >> offset >> length)
+    {
+        commit(offset, length);
+        max_end = (std::max)(max_end, offset + length);
+    }
+
+    // 临时文件被删除或截断时日志失效
+    std::error_code ec;
+    fs::path data_file(data_path);
+    if (!fs::exists(data_file, ec) || fs::file_size(data_file, ec) < max_end || ec)
+    {
+        reset(size);
+        return false;
+    }
+    return true;
+}
+
+void TransferJournal::reset(uint64_t size)
+{
+    total_size = size;
+    merkle_root.clear();
+    merkle_spans.clear();
+    committed.clear();
+    committed_size = 0;
+}
+
+uint64_t TransferJournal::commit(uint64_t offset, uint64_t length)
+{
+    if (length == 0)
+    {
+        return 0;
+    }
+    uint64_t begin = offset;
+    uint64_t end = offset + length;
+    uint64_t before = committed_size;
+
+    // 与前一个区间相交或相邻时合并
+    auto it = committed.upper_bound(begin);
+    if (it != committed.begin())
+    {
+        auto prev = std::prev(it);
+        if (prev->second >= begin)
+        {
+            begin = prev->first;
+            end = (std::max)(end, prev->second);
+            committed_size -= prev->second - prev->first;
+            it = committed.erase(prev);
+        }
+    }
+    // 合并后续所有相交或相邻的区间
+    while (it != committed.end() && it->first <= end)
+    {
+        end = (std::max)(end, it->second);
+        committed_size -= it->second - it->first;
+        it = committed.erase(it);
+    }
+    committed[begin] = end;
+    committed_size += end - begin;
+    return committed_size - before;
+}
+
+bool TransferJournal::save()
+{
+    std::ostringstream oss;
+    oss << total_size;
+    if (!merkle_root.empty())
+    {
+        oss << " " << merkle_root;
+        if (!merkle_spans.empty())
+        {
+            oss << " " << merkle_spans;
+        }
+    }
+    oss << "\n";
+    for (const auto &[begin, end] : committed)
+    {
+        oss << begin << " " << end - begin << "\n";
+    }
+    std::string content = oss.str();
+
+    auto writer = FileStreamHelper::createOutputFileStream(journal_path);
+    if (!writer || !writer->is_open())
+    {
+        LOG_ERROR("Failed to save journal: " << FileStreamHelper::wstringToLocalPath(journal_path));
+        return false;
+    }
+    writer->write(content.data(), content.size());
+    return static_cast<bool>(*writer);
+}
+
+void TransferJournal::remove()
+{
+    std::error_code ec;
+    fs::remove(fs::path(journal_path), ec);
+}
+
+std::vector<TransferJournal::Range> TransferJournal::missingRanges() const
+{
+    std::vector<Range> ranges;
+    uint64_t cursor = 0;
+    for (const auto &[begin, end] : committed)
+    {
+        if (begin > cursor)
+        {
+            ranges.push_back({cursor, begin - cursor});
+        }
+        cursor = (std::max)(cursor, end);
+    }
+    if (cursor < total_size)
+    {
+        ranges.push_back({cursor, total_size - cursor});
+    }
+    return ranges;
+}
+
+std::string TransferJournal::rangesToString(const std::vector<Range> &ranges)
+{
+    std::ostringstream oss;
+    for (size_t i = 0; i < ranges.size(); ++i)
+    {
+        if (i > 0)
+        {
+            oss << ",";
+        }
+        oss << ranges[i].offset << "-" << ranges[i].length;
+    }
+    return oss.str();
+}
+
+std::vector<TransferJournal::Range> TransferJournal::rangesFromString(const std::string &str)
+{
+    std::vector<Range> ranges;
+    std::istringstream iss(str);
+    std::string item;
+    while (std::getline(iss, item, ','))
+    {
+        auto pos = item.find('-');
+        if (pos == std::string::npos)
+        {
+            continue;
+        }
+        try
+        {
+            ranges.push_back({std::stoull(item.substr(0, pos)), std::stoull(item.substr(pos + 1))});
+        }
+        catch (const std::exception &e)
+        {
+            LOG_ERROR("Invalid range: " << item);
+        }
+    }
+    return ranges;
+}
@@ -0,0 +1,197 @@
+#include "driver/impl/FileSyncEngine/TransferScheduler.h"
+
+#include <algorithm>
+
+TransferScheduler::TransferScheduler(size_t worker_count, Policy policy) : policy(policy)
+{
+    // 没有可用连接时任务先留在队列中
+    worker_count = (std::max)(worker_count, static_cast<size_t>(1));
+    for (size_t i = 0; i < worker_count; ++i)
+    {
+        workers.push_back(std::make_unique<Worker>());
+    }
+}
+
+bool TransferScheduler::isBefore(const Entry &lhs, const Entry &rhs) const
+{
+    switch (policy)
+    {
+    case Policy::SmallestFirst:
+        // 同时入队时即按大小排序；大任务等待期间每发出一个字节，之后的任务就要再小一个字节才能插队
+        if (lhs.deadline != rhs.deadline)
+        {
+            return lhs.deadline < rhs.deadline;
+        }
+        break;
+    default:
+        break;
+    }
+    return lhs.insertion_order < rhs.insertion_order;
+}
+
+size_t TransferScheduler::leastLoaded()
+{
+    size_t best = 0;
+    uint64_t best_size = UINT64_MAX;
+    for (size_t i = 0; i < workers.size(); ++i)
+    {
+        std::lock_guard<std::mutex> lock(workers[i]->mtx);
+        if (workers[i]->queued_size < best_size)
+        {
+            best = i;
+            best_size = workers[i]->queued_size;
+        }
+    }
+    return best;
+}
+
+void TransferScheduler::push(size_t worker, FileSyncEngineInterface::SendTask task)
+{
+    Worker &target = *workers[worker];
+    uint64_t deadline = taken_size.load() + task.size;
+    Entry entry{std::move(task), insertion_counter++, deadline};
+    std::lock_guard<std::mutex> lock(target.mtx);
+    target.queued_size += entry.task.size;
+    // 队列保持按策略有序，队首最先发送
+    auto it = std::upper_bound(target.tasks.begin(), target.tasks.end(), entry,
+                               [this](const Entry &lhs, const Entry &rhs)
+                               { return isBefore(lhs, rhs); });
+    target.tasks.insert(it, std::move(entry));
+    ++pending_count;
+}
+
+void TransferScheduler::notify(size_t count)
+{
+    {
+        // 与等待方的条件检查互斥，避免丢失唤醒
+        std::lock_guard<std::mutex> lock(wait_mutex);
+    }
+    if (count > 1)
+    {
+        wait_cv.notify_all();
+    }
+    else
+    {
+        wait_cv.notify_one();
+    }
+}
+
+void TransferScheduler::submit(FileSyncEngineInterface::SendTask task)
+{
+    push(leastLoaded(), std::move(task));
+    notify(1);
+}
+
+void TransferScheduler::submit(std::vector<FileSyncEngineInterface::SendTask> tasks)
+{
+    if (tasks.empty())
+    {
+        return;
+    }
+    size_t worker = leastLoaded();
+    size_t count = tasks.size();
+    for (auto &task : tasks)
+    {
+        push(worker, std::move(task));
+        worker = (worker + 1) % workers.size();
+    }
+    notify(count);
+}
+
+std::optional<FileSyncEngineInterface::SendTask> TransferScheduler::pop(Worker &worker, bool from_back)
+{
+    std::lock_guard<std::mutex> lock(worker.mtx);
+    if (worker.tasks.empty())
+    {
+        return std::nullopt;
+    }
+    Entry entry = from_back ? std::move(worker.tasks.back()) : std::move(worker.tasks.front());
+    if (from_back)
+    {
+        worker.tasks.pop_back();
+    }
+    else
+    {
+        worker.tasks.pop_front();
+    }
+    worker.queued_size -= entry.task.size;
+    taken_size += entry.task.size;
+    --pending_count;
+    return std::move(entry.task);
+}
+
+std::optional<FileSyncEngineInterface::SendTask> TransferScheduler::steal(size_t thief)
+{
+    // 从排队最多的队列窃取；按入队顺序时取队尾，与队列所属连接错开，有序策略下取最优先的队首
+    size_t victim = thief;
+    size_t victim_count = 0;
+    for (size_t i = 0; i < workers.size(); ++i)
+    {
+        if (i == thief)
+        {
+            continue;
+        }
+        std::lock_guard<std::mutex> lock(workers[i]->mtx);
+        if (workers[i]->tasks.size() > victim_count)
+        {
+            victim = i;
+            victim_count = workers[i]->tasks.size();
+        }
+    }
+    if (victim == thief)
+    {
+        return std::nullopt;
+    }
+    return pop(*workers[victim], policy == Policy::Fifo);
+}
+
+std::optional<FileSyncEngineInterface::SendTask> TransferScheduler::take(size_t worker)
+{
+    worker %= workers.size();
+    while (true)
+    {
+        {
+            std::lock_guard<std::mutex> lock(wait_mutex);
+            if (is_stopped)
+            {
+                return std::nullopt;
+            }
+        }
+        auto task = pop(*workers[worker], false);
+        if (!task)
+        {
+            task = steal(worker);
+        }
+        if (task)
+        {
+            return task;
+        }
+        // 其他连接可能刚取走任务，被唤醒后重新查找
+        std::unique_lock<std::mutex> lock(wait_mutex);
+        wait_cv.wait(lock, [this]
+                     { return is_stopped || pending_count > 0; });
+    }
+}
+
+void TransferScheduler::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(wait_mutex);
+        is_stopped = true;
+    }
+    wait_cv.notify_all();
+    // 排队的任务属于已关闭的连接，对端重新连接后会再次请求
+    for (auto &worker : workers)
+    {
+        std::lock_guard<std::mutex> lock(worker->mtx);
+        pending_count -= worker->tasks.size();
+        worker->tasks.clear();
+        worker->queued_size = 0;
+    }
+}
+
+void TransferScheduler::resume()
+{
+    std::lock_guard<std::mutex> lock(wait_mutex);
+    is_stopped = false;
+}
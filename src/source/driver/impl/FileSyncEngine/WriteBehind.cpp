@@ -0,0 +1,59 @@
+#include "driver/impl/FileSyncEngine/WriteBehind.h"
+#include "driver/interface/FileSyncEngine/FileSyncEngineInterface.h"
+
+#include <vector>
+
+void WriteBehind::onWritten(FileStreamHelper::PositionalWriter &writer, uint64_t offset, uint64_t size)
+{
+    uint64_t begin = offset;
+    uint64_t end = offset + size;
+    std::vector<std::pair<uint64_t, uint64_t>> expired;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        auto it = pending_runs.find(offset);
+        if (it != pending_runs.end())
+        {
+            begin = it->second;
+            pending_runs.erase(it);
+        }
+        if (end - begin < FileSyncEngineInterface::drop_behind_window)
+        {
+            pending_runs[end] = begin;
+            return;
+        }
+        flushing.emplace_back(begin, end - begin);
+        while (flushing.size() > max_flushing)
+        {
+            expired.push_back(flushing.front());
+            flushing.pop_front();
+        }
+    }
+
+    // 系统调用不持锁，其他线程的写入不受等待影响
+    writer.startWriteback(begin, end - begin);
+    for (const auto &range : expired)
+    {
+        writer.waitWriteback(range.first, range.second);
+        writer.adviseDontNeed(range.first, range.second);
+    }
+}
+
+void WriteBehind::finish(FileStreamHelper::PositionalWriter &writer)
+{
+    std::map<uint64_t, uint64_t> runs;
+    std::deque<std::pair<uint64_t, uint64_t>> ranges;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        runs.swap(pending_runs);
+        ranges.swap(flushing);
+    }
+    for (const auto &run : runs)
+    {
+        writer.startWriteback(run.second, run.first - run.second);
+    }
+    // 仍在回写的页不会被丢弃，留给内核处理
+    for (const auto &range : ranges)
+    {
+        writer.adviseDontNeed(range.first, range.second);
+    }
+}
@@ -169,6 +169,12 @@ void FileJsonMsgBuilder::buildFileHeader(json& result, Json::MessageType::File::
         content["id"] = args.at("id");
         content["total_size"] = args.at("total_size");
         content["total_blocks"] = args.at("total_blocks");
+        content["block_size"] = args.at("block_size");
+        // 发送端会在file_end中给出Merkle根
+        if (args.count("merkle_leaf_size"))
+        {
+            content["merkle_leaf_size"] = args.at("merkle_leaf_size");
+        }
 
         result["content"] = content;
     }
@@ -183,9 +189,9 @@ void FileJsonMsgBuilder::buildDirHeader(json& result, Json::MessageType::File::T
         json content;
         result["type"] = Json::MessageType::File::toString(type);
         content["id"] = args.at("id");
-        content["leaf_paths"] = json::parse(args.at("leaf_paths"));
         content["total_paths"] = args.at("total_paths");
         content["total_size"] = args.at("total_size");
+        content["part_count"] = args.at("part_count");
 
         result["content"] = content;
     }
@@ -204,6 +210,7 @@ void FileJsonMsgBuilder::buildDirItemHeader(json& result, Json::MessageType::Fil
         content["path"] = args.at("path");
         content["total_size"] = args.at("total_size");
         content["total_blocks"] = args.at("total_blocks");
+        content["block_size"] = args.at("block_size");
 
         result["content"] = content;
     }
@@ -212,6 +219,71 @@ void FileJsonMsgBuilder::buildDirItemHeader(json& result, Json::MessageType::Fil
     }
 }
 
+void FileJsonMsgBuilder::buildFileStripe(json& result, Json::MessageType::File::Type type, const std::map<std::string, std::string>& args)
+{
+    try {
+        json content;
+        result["type"] = Json::MessageType::File::toString(type);
+
+        content["id"] = args.at("id");
+        content["total_size"] = args.at("total_size");
+        content["offset"] = args.at("offset");
+        content["size"] = args.at("size");
+        content["block_size"] = args.at("block_size");
+        // 整个文件拆成条带时，Merkle根在最后一个条带之后由file_root给出
+        if (args.count("merkle_leaf_size"))
+        {
+            content["merkle_leaf_size"] = args.at("merkle_leaf_size");
+        }
+
+        result["content"] = content;
+    }
+    catch (const std::out_of_range& e) {
+        throw std::runtime_error("Missing required field in file stripe");
+    }
+}
+
+void FileJsonMsgBuilder::buildFileDelta(json& result, Json::MessageType::File::Type type, const std::map<std::string, std::string>& args)
+{
+    try {
+        json content;
+        result["type"] = Json::MessageType::File::toString(type);
+
+        content["id"] = args.at("id");
+        content["total_size"] = args.at("total_size");
+        content["block_size"] = args.at("block_size");
+
+        result["content"] = content;
+    }
+    catch (const std::out_of_range& e) {
+        throw std::runtime_error("Missing required field in file delta");
+    }
+}
+
+std::string FileJsonMsgBuilder::buildFileListMsg(Json::MessageType::File::Type type, std::map<std::string, std::string> args, std::vector<std::string>&& items)
+{
+    json result;
+    json content;
+    result["type"] = Json::MessageType::File::toString(type);
+    for (auto& [key, value] : args)
+    {
+        content[key] = std::move(value);
+    }
+    switch (type)
+    {
+    case Json::MessageType::File::DirectoryPaths:
+        content["paths"] = std::move(items);
+        break;
+    case Json::MessageType::File::FileChunks:
+        content["chunks"] = std::move(items);
+        break;
+    default:
+        break;
+    }
+    result["content"] = content;
+    return result.dump();
+}
+
 std::string FileJsonMsgBuilder::buildFileMsg(Json::MessageType::File::Type type, std::map<std::string, std::string> args)
 {
     json result;
@@ -227,8 +299,20 @@ std::string FileJsonMsgBuilder::buildFileMsg(Json::MessageType::File::Type type,
     case Json::MessageType::File::DirectoryItemHeader:
         buildDirItemHeader(result, type, args);
         break;
+    case Json::MessageType::File::FileStripe:
+        buildFileStripe(result, type, args);
+        break;
+    case Json::MessageType::File::FileDelta:
+        buildFileDelta(result, type, args);
+        break;
     case Json::MessageType::File::FileEnd:
-        result["type"] = Json::MessageType::File::toString(Json::MessageType::File::FileEnd);
+    case Json::MessageType::File::FileRoot:
+        // 增量传输的结束消息带有新文件的哈希，条带文件的根单独发送
+        result["type"] = Json::MessageType::File::toString(type);
+        for (auto& [key, value] : args)
+        {
+            content[key] = std::move(value);
+        }
         result["content"] = content;
         return result.dump();
     default:
@@ -1,12 +1,14 @@
 #include "driver/impl/OpensslDriver.h"
 #include "common/DebugOutputer.h"
 #include <openssl/aes.h>
+#include <openssl/evp.h>
 #include <openssl/sha.h>
 #include <openssl/rand.h>
 #include <cstring>
 #include <string>
 #include <iostream>
 #include <memory>
+#include <algorithm>
 
 #ifdef _WIN32
 #include <openssl/applink.c>
@@ -238,11 +240,21 @@ SecurityInterface::TlsInfo OpensslDriver::getAesKey(UnifiedSocket socket)
 
     LOG_INFO("Successfully received encryption key from server");
 
+    // 新版本服务端在密钥之后发送帧模式，收到后回复本端的帧模式；旧版本服务端此时已关闭连接
+    bool is_aead = false;
+    uint8_t peer_mode = 0;
+    if (SSL_read(ssl, &peer_mode, 1) == 1)
+    {
+        uint8_t mode = frame_mode_aead;
+        is_aead = SSL_write(ssl, &mode, 1) == 1 && (peer_mode & frame_mode_aead);
+    }
+    LOG_INFO("Frame cipher: " << (is_aead ? "AES-256-GCM" : "AES-256-CBC"));
+
     // 清理SSL连接
     SSL_shutdown(ssl);
     SSL_free(ssl);
 
-    return SecurityInterface::TlsInfo{key};
+    return SecurityInterface::TlsInfo{key, is_aead, false};
 }
 
 void OpensslDriver::dealTlsRequest(UnifiedSocket socket, std::function<void(bool, TlsInfo)> callback)
@@ -288,8 +300,11 @@ void OpensslDriver::dealTlsRequest(UnifiedSocket socket, std::function<void(bool
             throw std::runtime_error("RAND_bytes failed");
         }
 
-        // 发送密钥给客户端
-        int bytes_sent = SSL_write(ssl, key.get(), 32);
+        // 发送密钥和本端的帧模式给客户端
+        uint8_t key_msg[33];
+        memcpy(key_msg, key.get(), 32);
+        key_msg[32] = frame_mode_aead;
+        int bytes_sent = SSL_write(ssl, key_msg, sizeof(key_msg));
         if (bytes_sent <= 0)
         {
             int ssl_error = SSL_get_error(ssl, bytes_sent);
@@ -299,12 +314,17 @@ void OpensslDriver::dealTlsRequest(UnifiedSocket socket, std::function<void(bool
 
         LOG_INFO("Successfully sent key to client: " << bytes_sent << " bytes");
 
+        // 旧版本客户端读完密钥即关闭连接，读不到帧模式按旧模式处理
+        uint8_t peer_mode = 0;
+        bool is_aead = SSL_read(ssl, &peer_mode, 1) == 1 && (peer_mode & frame_mode_aead);
+        LOG_INFO("Frame cipher: " << (is_aead ? "AES-256-GCM" : "AES-256-CBC"));
+
         // 安全关闭连接
         SSL_shutdown(ssl);
         SSL_free(ssl);
         closesocket(socket);
 
-        callback(true, {key});
+        callback(true, {key, is_aead, true});
     }
     catch (const std::exception &e)
     {
@@ -512,5 +532,82 @@ bool OpensslDriver::verifyAndDecrypt(const std::vector<uint8_t> &encrypted_data,
     }
     out_plaintext.resize(out_plaintext.size() - sizeof(uint32_t));
 
+    return true;
+}
+
+// 每个线程复用一个EVP上下文，避免每帧分配
+static EVP_CIPHER_CTX *threadCipherContext()
+{
+    struct ContextHolder
+    {
+        EVP_CIPHER_CTX *ctx{EVP_CIPHER_CTX_new()};
+        ~ContextHolder() { EVP_CIPHER_CTX_free(ctx); }
+    };
+    thread_local ContextHolder holder;
+    return holder.ctx;
+}
+
+// EVP_*Update的长度为int，超长的数据分段处理
+static const size_t max_cipher_update = 1 << 30;
+
+bool OpensslDriver::aeadSeal(const uint8_t *key, const uint8_t *nonce, const uint8_t *aad, size_t aad_length,
+                             const uint8_t *in, size_t length, uint8_t *out, uint8_t *tag)
+{
+    EVP_CIPHER_CTX *ctx = threadCipherContext();
+    int out_length = 0;
+    if (!ctx || EVP_EncryptInit_ex(ctx, EVP_aes_256_gcm(), nullptr, key, nonce) != 1 ||
+        (aad_length > 0 && EVP_EncryptUpdate(ctx, nullptr, &out_length, aad, static_cast<int>(aad_length)) != 1))
+    {
+        LOG_ERROR("Failed to initialize AES-GCM encryption");
+        return false;
+    }
+    size_t offset = 0;
+    while (offset < length)
+    {
+        size_t size = (std::min)(length - offset, max_cipher_update);
+        if (EVP_EncryptUpdate(ctx, out + offset, &out_length, in + offset, static_cast<int>(size)) != 1)
+        {
+            LOG_ERROR("AES-GCM encryption failed");
+            return false;
+        }
+        offset += size;
+    }
+    if (EVP_EncryptFinal_ex(ctx, out + offset, &out_length) != 1 ||
+        EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, static_cast<int>(aead_tag_size), tag) != 1)
+    {
+        LOG_ERROR("Failed to finalize AES-GCM encryption");
+        return false;
+    }
+    return true;
+}
+
+bool OpensslDriver::aeadOpen(const uint8_t *key, const uint8_t *nonce, const uint8_t *aad, size_t aad_length,
+                             const uint8_t *in, size_t length, uint8_t *out, const uint8_t *tag)
+{
+    EVP_CIPHER_CTX *ctx = threadCipherContext();
+    int out_length = 0;
+    if (!ctx || EVP_DecryptInit_ex(ctx, EVP_aes_256_gcm(), nullptr, key, nonce) != 1 ||
+        (aad_length > 0 && EVP_DecryptUpdate(ctx, nullptr, &out_length, aad, static_cast<int>(aad_length)) != 1))
+    {
+        LOG_ERROR("Failed to initialize AES-GCM decryption");
+        return false;
+    }
+    size_t offset = 0;
+    while (offset < length)
+    {
+        size_t size = (std::min)(length - offset, max_cipher_update);
+        if (EVP_DecryptUpdate(ctx, out + offset, &out_length, in + offset, static_cast<int>(size)) != 1)
+        {
+            LOG_ERROR("AES-GCM decryption failed");
+            return false;
+        }
+        offset += size;
+    }
+    if (EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, static_cast<int>(aead_tag_size), const_cast<uint8_t *>(tag)) != 1 ||
+        EVP_DecryptFinal_ex(ctx, out + offset, &out_length) != 1)
+    {
+        LOG_ERROR("AES-GCM tag mismatch");
+        return false;
+    }
     return true;
 }
\ No newline at end of file
@@ -1,14 +1,24 @@
 #include "driver/impl/OuterMsgBuilder.h"
+#include "common/DebugOutputer.h"
 #include <memory.h>
 #include <iostream>
 #include <fstream>
+#include <limits>
 
 OuterMsgBuilder::OuterMsgBuilder(std::shared_ptr<SecurityInterface> instance)
-    : version(0x01)
+    : version(0x01), builder_id(next_builder_id.fetch_add(1))
 {
     security_instance = instance;
 }
 
+void OuterMsgBuilder::setSecurityInstance(std::shared_ptr<SecurityInterface> instance)
+{
+    std::lock_guard<std::mutex> lock(nonce_mutex);
+    security_instance = instance;
+    nonce_key.reset();
+    nonce_counter = 0;
+}
+
 std::unique_ptr<NetworkInterface::UserMsg> OuterMsgBuilder::buildMsg(std::string payload, NetworkInterface::Flag flag)
 {
     return build(
@@ -21,78 +31,140 @@ std::unique_ptr<NetworkInterface::UserMsg> OuterMsgBuilder::buildMsg(std::vector
     return build(std::move(payload), flag);
 }
 
-std::unique_ptr<NetworkInterface::UserMsg> OuterMsgBuilder::build(std::vector<uint8_t> real_msg, NetworkInterface::Flag flag)
+std::vector<uint8_t> OuterMsgBuilder::buildHeader(uint32_t payload_length, NetworkInterface::Flag flag)
+{
+    std::vector<uint8_t> result(sizeof(NetworkInterface::Header));
+    writeHeader(result.data(), version, payload_length, flag);
+    return result;
+}
+
+void OuterMsgBuilder::writeHeader(uint8_t *dst, uint8_t header_version, uint32_t payload_length, NetworkInterface::Flag flag)
 {
-    // 构造Header
     NetworkInterface::Header header;
 
     uint16_t net_magic = htons(NetworkInterface::magic);
-
     memcpy(&header.magic, &net_magic, sizeof(net_magic));
-    memcpy(&header.version, &version, sizeof(version));
+    memcpy(&header.version, &header_version, sizeof(header_version));
 
-    uint8_t msg_flag = static_cast<uint8_t>(flag);
+    uint32_t net_length = htonl(payload_length);
+    memcpy(&header.length, &net_length, sizeof(net_length));
 
+    uint8_t msg_flag = static_cast<uint8_t>(flag);
     memcpy(&header.flag, &msg_flag, sizeof(msg_flag));
 
-    uint8_t *iv = nullptr;
-    uint8_t *sha256 = nullptr;
+    memcpy(dst, &header, sizeof(NetworkInterface::Header));
+}
 
+std::unique_ptr<OuterMsgBuilderInterface::Frame> OuterMsgBuilder::buildFrame(std::vector<uint8_t> &&payload, NetworkInterface::Flag flag)
+{
+    constexpr size_t header_size = sizeof(NetworkInterface::Header);
     bool encrypt = security_instance && (flag & NetworkInterface::Flag::IS_ENCRYPT);
-    if (encrypt)
+    if (!encrypt)
     {
-        iv = security_instance->aesEncrypt(real_msg, security_instance->getTlsInfo().key.get());
-        // 向量+内容一起做sha256
-        std::vector<uint8_t> vi_encrypt(iv, iv + 16);
-        vi_encrypt.insert(vi_encrypt.end(), real_msg.begin(), real_msg.end());
-        sha256 = security_instance->sha256(vi_encrypt.data(), vi_encrypt.size());
+        auto frame = std::make_unique<Frame>();
+        frame->head.resize(header_size);
+        writeHeader(frame->head.data(), version, static_cast<uint32_t>(payload.size()), flag);
+        frame->payload = std::move(payload);
+        return frame;
     }
-    else
+
+    auto tls_info = security_instance->getTlsInfo();
+    if (tls_info.is_aead)
     {
-        iv = nullptr;
-        sha256 = nullptr;
+        return buildAead(std::move(payload), flag, tls_info);
     }
 
-    // 计算载荷长度
-    uint32_t payload_length;
-    if (encrypt)
+    // 旧模式：AES-256-CBC加密后对 iv + 密文 做sha256
+    std::unique_ptr<uint8_t[]> iv(security_instance->aesEncrypt(payload, tls_info.key.get()));
+    if (!iv)
     {
-        payload_length = 16 + 32 + real_msg.size();
+        return nullptr;
     }
-    else
+    std::vector<uint8_t> vi_encrypt(iv.get(), iv.get() + 16);
+    vi_encrypt.insert(vi_encrypt.end(), payload.begin(), payload.end());
+    std::unique_ptr<uint8_t[]> sha256(security_instance->sha256(vi_encrypt.data(), vi_encrypt.size()));
+    if (!sha256)
     {
-        payload_length = real_msg.size();
+        return nullptr;
     }
-    std::vector<uint8_t> msg(sizeof(NetworkInterface::Header) + payload_length);
 
-    // 补上Header中的payload length字段
-    payload_length = htonl(payload_length);
-    memcpy(&header.length, &payload_length, sizeof(payload_length));
+    // 0-7字节消息头，随后iv(16字节)、sha256(32字节)
+    auto frame = std::make_unique<Frame>();
+    frame->head.resize(header_size + 16 + 32);
+    writeHeader(frame->head.data(), version, static_cast<uint32_t>(16 + 32 + payload.size()), flag);
+    memcpy(frame->head.data() + header_size, iv.get(), 16);
+    memcpy(frame->head.data() + header_size + 16, sha256.get(), 32);
+    frame->payload = std::move(payload);
+    return frame;
+}
 
-    size_t offset = 0;
-    // 0-7字节，消息头
-    memcpy(msg.data() + offset, &header, sizeof(NetworkInterface::Header));
-    offset += sizeof(NetworkInterface::Header);
+bool OuterMsgBuilder::nextNonce(const SecurityInterface::TlsInfo &tls_info, uint8_t *nonce)
+{
+    uint64_t counter = 0;
+    {
+        std::lock_guard<std::mutex> lock(nonce_mutex);
+        if (nonce_key != tls_info.key)
+        {
+            nonce_key = tls_info.key;
+            nonce_counter = 0;
+        }
+        if (nonce_counter == (std::numeric_limits<uint64_t>::max)())
+        {
+            LOG_ERROR("GCM nonce exhausted, refuse to encrypt with the current key");
+            return false;
+        }
+        counter = nonce_counter++;
+    }
+    nonce[0] = tls_info.is_server ? 1 : 0;
+    nonce[1] = static_cast<uint8_t>(builder_id >> 16);
+    nonce[2] = static_cast<uint8_t>(builder_id >> 8);
+    nonce[3] = static_cast<uint8_t>(builder_id);
+    for (size_t i = 0; i < sizeof(counter); ++i)
+    {
+        nonce[SecurityInterface::aead_nonce_size - 1 - i] = static_cast<uint8_t>(counter >> (i * 8));
+    }
+    return true;
+}
+
+std::unique_ptr<OuterMsgBuilderInterface::Frame> OuterMsgBuilder::buildAead(std::vector<uint8_t> &&payload, NetworkInterface::Flag flag,
+                                                                            const SecurityInterface::TlsInfo &tls_info)
+{
+    constexpr size_t header_size = sizeof(NetworkInterface::Header);
+    constexpr size_t nonce_size = SecurityInterface::aead_nonce_size;
+    constexpr size_t tag_size = SecurityInterface::aead_tag_size;
+
+    auto frame = std::make_unique<Frame>();
+    frame->head.resize(header_size + nonce_size + tag_size);
+    uint8_t *header = frame->head.data();
+    writeHeader(header, NetworkInterface::aead_version, static_cast<uint32_t>(nonce_size + tag_size + payload.size()), flag);
 
-    // 加密则写入iv(16字节)sha256(32字节)，不加密则不写入
-    if (iv)
+    uint8_t *nonce = header + header_size;
+    if (!nextNonce(tls_info, nonce))
     {
-        memcpy(msg.data() + offset, iv, 16);
-        offset += 16;
+        return nullptr;
     }
-    if (sha256)
+    // 原地加密，Header一并认证，长度与标志位无法被篡改
+    if (!security_instance->aeadSeal(tls_info.key.get(), nonce, header, header_size,
+                                     payload.data(), payload.size(), payload.data(), nonce + nonce_size))
     {
-        memcpy(msg.data() + offset, sha256, 32);
-        offset += 32;
+        return nullptr;
     }
-    // 拷贝加密后的数据
-    memcpy(msg.data() + offset, real_msg.data(), real_msg.size());
-    offset += real_msg.size();
-    auto user_msg = std::make_unique<NetworkInterface::UserMsg>();
-    user_msg->iv.assign(iv, iv + 16);
-    user_msg->sha256.assign(sha256, sha256 + 32);
-    user_msg->data = std::move(msg);
+    frame->payload = std::move(payload);
+    return frame;
+}
 
+std::unique_ptr<NetworkInterface::UserMsg> OuterMsgBuilder::build(std::vector<uint8_t> real_msg, NetworkInterface::Flag flag)
+{
+    auto frame = buildFrame(std::move(real_msg), flag);
+    if (!frame)
+    {
+        return nullptr;
+    }
+    // 需要连续内存的调用方才拼接一次
+    auto user_msg = std::make_unique<NetworkInterface::UserMsg>();
+    user_msg->data.reserve(frame->head.size() + frame->payload.size());
+    user_msg->data.insert(user_msg->data.end(), frame->head.begin(), frame->head.end());
+    user_msg->data.insert(user_msg->data.end(), frame->payload.begin(), frame->payload.end());
     return user_msg;
 }
 
@@ -181,6 +181,18 @@ void OuterMsgParser::delegateRecv(UnifiedSocket client_socket,
                     uint8_t flag = 0x0;
                     memcpy(&flag, buffer + 7, sizeof(flag));
 
+                    if (isSinkPayload(flag))
+                    {
+                        // 明文未压缩的文件块不经过缓冲区，由接收方直接搬运
+                        if (!binary_payload_sink(client_socket, payload_length))
+                        {
+                            if (dcc_cb)
+                                dcc_cb();
+                            break;
+                        }
+                        continue;
+                    }
+
                     std::vector<uint8_t> receive_msg(payload_length);
                     uint32_t readed_length = 0;
 
@@ -224,20 +236,7 @@ void OuterMsgParser::delegateRecv(UnifiedSocket client_socket,
                     if (readed_length < payload_length)
                         continue;
 
-                    auto parsed = parse(std::move(receive_msg), payload_length, flag);
-                    memcpy(&parsed->header, buffer, HEADER_SIZE);
-                    std::vector<uint8_t> result_vec;
-
-                    if (flag & static_cast<uint8_t>(NetworkInterface::Flag::IS_ENCRYPT) &&
-                        security_instance && security_instance->verifyAndDecrypt(parsed->data, security_instance->getTlsInfo().key.get(), parsed->iv, result_vec, parsed->sha256))
-                    {
-                        parsed->data.assign(result_vec.begin(), result_vec.end());
-                        callback(std::move(parsed));
-                    }
-                    else
-                    {
-                        callback(std::move(parsed));
-                    }
+                    deliver(buffer, std::move(receive_msg), payload_length, flag, callback, security_instance);
                 }
                 else
                 {
@@ -276,6 +275,160 @@ void OuterMsgParser::delegateRecv(UnifiedSocket client_socket,
     SOCKET_BLOCK(client_socket);
 }
 
+bool OuterMsgParser::receiveAvailable(UnifiedSocket client_socket, RecvState &state,
+                                      const std::function<void(std::unique_ptr<NetworkInterface::UserMsg> parsed_msg)> &callback,
+                                      const std::shared_ptr<SecurityInterface> &security_instance,
+                                      size_t max_bytes)
+{
+    constexpr uint32_t HEADER_SIZE = sizeof(state.header);
+    size_t received_bytes = 0;
+    while (received_bytes < max_bytes)
+    {
+        bool is_header = state.header_received < HEADER_SIZE;
+        uint8_t *dst = is_header ? state.header + state.header_received
+                                 : state.payload.data() + state.payload_received;
+        uint32_t want = is_header ? HEADER_SIZE - state.header_received
+                                  : static_cast<uint32_t>(state.payload.size()) - state.payload_received;
+        if (want > 0)
+        {
+            int n = recv(client_socket, reinterpret_cast<char *>(dst), static_cast<int>(want), 0);
+            if (n == 0)
+            {
+                return false; // 对端关闭
+            }
+            if (n < 0)
+            {
+                int error = GET_SOCKET_ERROR;
+                if (error == SOCKET_EWOULDBLOCK)
+                {
+                    return true;
+                }
+                if (error == SOCKET_EINTR)
+                {
+                    continue;
+                }
+                LOG_ERROR("Recv error: " << error);
+                return false;
+            }
+            received_bytes += n;
+            if (is_header)
+            {
+                state.header_received += n;
+            }
+            else
+            {
+                state.payload_received += n;
+            }
+        }
+
+        if (is_header)
+        {
+            if (state.header_received < HEADER_SIZE)
+            {
+                continue;
+            }
+            if (state.header[0] != 0xAB || state.header[1] != 0xCD)
+            {
+                // 不是帧头，逐字节后移重新寻找魔数
+                memmove(state.header, state.header + 1, HEADER_SIZE - 1);
+                --state.header_received;
+                continue;
+            }
+            uint32_t payload_length = 0;
+            memcpy(&payload_length, state.header + 3, sizeof(payload_length));
+            payload_length = ntohl(payload_length);
+            uint8_t flag = state.header[7];
+            if (isSinkPayload(flag))
+            {
+                state.header_received = 0;
+                if (!binary_payload_sink(client_socket, payload_length))
+                {
+                    return false;
+                }
+                received_bytes += payload_length;
+                continue;
+            }
+            state.payload.resize(payload_length);
+            state.payload_received = 0;
+        }
+
+        if (state.payload_received < state.payload.size())
+        {
+            continue;
+        }
+        uint32_t payload_length = static_cast<uint32_t>(state.payload.size());
+        state.header_received = 0;
+        state.payload_received = 0;
+        deliver(state.header, std::move(state.payload), payload_length, state.header[7], callback, security_instance);
+        state.payload = std::vector<uint8_t>();
+    }
+    return true;
+}
+
+bool OuterMsgParser::isSinkPayload(uint8_t flag) const
+{
+    return binary_payload_sink && (flag & static_cast<uint8_t>(NetworkInterface::Flag::IS_BINARY)) &&
+           !(flag & static_cast<uint8_t>(NetworkInterface::Flag::IS_ENCRYPT)) &&
+           !(flag & static_cast<uint8_t>(NetworkInterface::Flag::IS_COMPRESS));
+}
+
+void OuterMsgParser::deliver(const uint8_t *header, std::vector<uint8_t> &&payload, uint32_t payload_length, uint8_t flag,
+                             const std::function<void(std::unique_ptr<NetworkInterface::UserMsg> parsed_msg)> &callback,
+                             const std::shared_ptr<SecurityInterface> &security_instance)
+{
+    if ((flag & static_cast<uint8_t>(NetworkInterface::Flag::IS_ENCRYPT)) && header[2] == NetworkInterface::aead_version)
+    {
+        deliverAead(header, payload, payload_length, callback, security_instance);
+        return;
+    }
+
+    auto parsed = parse(std::move(payload), payload_length, flag);
+    memcpy(&parsed->header, header, sizeof(parsed->header));
+    std::vector<uint8_t> result_vec;
+
+    if (flag & static_cast<uint8_t>(NetworkInterface::Flag::IS_ENCRYPT) &&
+        security_instance && security_instance->verifyAndDecrypt(parsed->data, security_instance->getTlsInfo().key.get(), parsed->iv, result_vec, parsed->sha256))
+    {
+        parsed->data.assign(result_vec.begin(), result_vec.end());
+    }
+    callback(std::move(parsed));
+}
+
+void OuterMsgParser::deliverAead(const uint8_t *header, const std::vector<uint8_t> &payload, uint32_t payload_length,
+                                 const std::function<void(std::unique_ptr<NetworkInterface::UserMsg> parsed_msg)> &callback,
+                                 const std::shared_ptr<SecurityInterface> &security_instance)
+{
+    constexpr size_t nonce_size = SecurityInterface::aead_nonce_size;
+    constexpr size_t tag_size = SecurityInterface::aead_tag_size;
+    if (!security_instance || payload_length < nonce_size + tag_size)
+    {
+        LOG_ERROR("Drop AES-GCM frame: " << (security_instance ? "payload too short" : "no key"));
+        return;
+    }
+    auto tls_info = security_instance->getTlsInfo();
+    if (!tls_info.key)
+    {
+        LOG_ERROR("Drop AES-GCM frame: no key");
+        return;
+    }
+
+    const uint8_t *nonce = payload.data();
+    const uint8_t *tag = nonce + nonce_size;
+    size_t cipher_len = payload_length - nonce_size - tag_size;
+    auto parsed = std::make_unique<NetworkInterface::UserMsg>();
+    memcpy(&parsed->header, header, sizeof(parsed->header));
+    parsed->data.resize(cipher_len);
+    // 认证失败的帧不交给上层
+    if (!security_instance->aeadOpen(tls_info.key.get(), nonce, header, sizeof(parsed->header),
+                                     tag + tag_size, cipher_len, parsed->data.data(), tag))
+    {
+        LOG_ERROR("Drop AES-GCM frame: authentication failed");
+        return;
+    }
+    parsed->iv.assign(nonce, nonce + nonce_size);
+    callback(std::move(parsed));
+}
+
 std::unique_ptr<NetworkInterface::UserMsg> OuterMsgParser::parse(std::vector<uint8_t> &&msg, const uint32_t length, const uint8_t flag)
 {
     NetworkInterface::UserMsg result;
@@ -0,0 +1,161 @@
+#include "driver/impl/SocketPoller.h"
+#include "common/DebugOutputer.h"
+
+#include <algorithm>
+#ifndef _WIN32
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
+
+#ifdef _WIN32
+SocketPoller::SocketPoller()
+{
+}
+
+SocketPoller::~SocketPoller()
+{
+}
+
+bool SocketPoller::isValid() const
+{
+    return true;
+}
+
+bool SocketPoller::add(UnifiedSocket socket)
+{
+    std::lock_guard<std::mutex> lock(sockets_mutex);
+    sockets.push_back(socket);
+    return true;
+}
+
+void SocketPoller::remove(UnifiedSocket socket)
+{
+    std::lock_guard<std::mutex> lock(sockets_mutex);
+    sockets.erase(std::remove(sockets.begin(), sockets.end(), socket), sockets.end());
+}
+
+int SocketPoller::wait(std::vector<UnifiedSocket> &ready, int timeout_ms)
+{
+    ready.clear();
+    std::vector<WSAPOLLFD> fds;
+    {
+        std::lock_guard<std::mutex> lock(sockets_mutex);
+        fds.resize(sockets.size());
+        for (size_t i = 0; i < sockets.size(); ++i)
+        {
+            fds[i].fd = sockets[i];
+            fds[i].events = POLLRDNORM;
+            fds[i].revents = 0;
+        }
+    }
+    if (timeout_ms < 0 || timeout_ms > poll_interval)
+    {
+        timeout_ms = poll_interval;
+    }
+    if (fds.empty())
+    {
+        Sleep(timeout_ms);
+        return 0;
+    }
+    int result = WSAPoll(fds.data(), static_cast<ULONG>(fds.size()), timeout_ms);
+    if (result == SOCKET_ERROR_VAL)
+    {
+        return -1;
+    }
+    for (const auto &fd : fds)
+    {
+        if (fd.revents != 0)
+        {
+            ready.push_back(fd.fd);
+        }
+    }
+    return static_cast<int>(ready.size());
+}
+
+void SocketPoller::wakeup()
+{
+    // WSAPoll无法被唤醒，wait最多阻塞poll_interval
+}
+#else
+SocketPoller::SocketPoller()
+{
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epoll_fd < 0 || event_fd < 0)
+    {
+        LOG_ERROR("Failed to create epoll: " << errno);
+        return;
+    }
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = event_fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, event_fd, &event);
+}
+
+SocketPoller::~SocketPoller()
+{
+    if (event_fd >= 0)
+    {
+        close(event_fd);
+    }
+    if (epoll_fd >= 0)
+    {
+        close(epoll_fd);
+    }
+}
+
+bool SocketPoller::isValid() const
+{
+    return epoll_fd >= 0 && event_fd >= 0;
+}
+
+bool SocketPoller::add(UnifiedSocket socket)
+{
+    epoll_event event{};
+    event.events = EPOLLIN | EPOLLRDHUP;
+    event.data.fd = socket;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, socket, &event) != 0)
+    {
+        LOG_ERROR("Failed to add socket " << socket << " to epoll: " << errno);
+        return false;
+    }
+    return true;
+}
+
+void SocketPoller::remove(UnifiedSocket socket)
+{
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, socket, nullptr);
+}
+
+int SocketPoller::wait(std::vector<UnifiedSocket> &ready, int timeout_ms)
+{
+    ready.clear();
+    epoll_event events[64];
+    int count = epoll_wait(epoll_fd, events, 64, timeout_ms);
+    if (count < 0)
+    {
+        return errno == EINTR ? 0 : -1;
+    }
+    for (int i = 0; i < count; ++i)
+    {
+        if (events[i].data.fd == event_fd)
+        {
+            uint64_t value = 0;
+            while (read(event_fd, &value, sizeof(value)) > 0)
+            {
+            }
+            continue;
+        }
+        ready.push_back(events[i].data.fd);
+    }
+    return static_cast<int>(ready.size());
+}
+
+void SocketPoller::wakeup()
+{
+    uint64_t value = 1;
+    // 只用于唤醒，计数器尚未被读走时写入失败也无妨
+    ssize_t ret = write(event_fd, &value, sizeof(value));
+    (void)ret;
+}
+#endif
@@ -200,6 +200,7 @@ void TcpDriver::sendMsg(const std::string &msg)
 
     size_t final_msg_length = ready_to_send_msg->data.size();
     size_t sended_length = 0;
+    std::lock_guard<std::mutex> lock(send_mutex);
 
     while (sended_length < final_msg_length)
     {
@@ -0,0 +1,42 @@
+#include "driver/impl/ZlibDriver.h"
+#include "common/DebugOutputer.h"
+
+#include <zlib.h>
+#include <cstring>
+
+bool ZlibDriver::compress(const uint8_t *src, size_t size, std::vector<uint8_t> &dst)
+{
+    uint32_t original_size = static_cast<uint32_t>(size);
+    uLongf compressed_size = compressBound(static_cast<uLong>(size));
+    dst.resize(sizeof(original_size) + compressed_size);
+    memcpy(dst.data(), &original_size, sizeof(original_size));
+    if (compress2(dst.data() + sizeof(original_size), &compressed_size, src, static_cast<uLong>(size), Z_BEST_SPEED) != Z_OK)
+    {
+        return false;
+    }
+    dst.resize(sizeof(original_size) + compressed_size);
+    return true;
+}
+
+bool ZlibDriver::decompress(const uint8_t *src, size_t size, std::vector<uint8_t> &dst, size_t max_size)
+{
+    uint32_t original_size = 0;
+    if (size < sizeof(original_size))
+    {
+        return false;
+    }
+    memcpy(&original_size, src, sizeof(original_size));
+    if (original_size > max_size)
+    {
+        LOG_ERROR("Decompressed size too large: " << original_size);
+        return false;
+    }
+    dst.resize(original_size);
+    uLongf output_size = original_size;
+    if (uncompress(dst.data(), &output_size, src + sizeof(original_size), static_cast<uLong>(size - sizeof(original_size))) != Z_OK ||
+        output_size != original_size)
+    {
+        return false;
+    }
+    return true;
+}
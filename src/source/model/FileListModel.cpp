@@ -8,6 +8,7 @@
 #include <QtCore/QUrl>
 #include <QtWidgets/QApplication>
 #include <QtGui/QClipboard>
+#include <algorithm>
 
 FileListModel::FileListModel(QObject *parent) : QAbstractListModel(parent)
 {
@@ -30,6 +31,23 @@ FileListModel::FileListModel(QObject *parent) : QAbstractListModel(parent)
                                           std::bind(&FileListModel::haveDownLoadRequest,
                                                     this,
                                                     std::placeholders::_1));
+    EventBusManager::instance().subscribe("/file/have_dedup_request",
+                                          std::bind(&FileListModel::haveDedupRequest,
+                                                    this,
+                                                    std::placeholders::_1));
+    EventBusManager::instance().subscribe("/file/have_resume_request",
+                                          std::bind(&FileListModel::haveResumeRequest,
+                                                    this,
+                                                    std::placeholders::_1,
+                                                    std::placeholders::_2,
+                                                    std::placeholders::_3));
+    EventBusManager::instance().subscribe("/file/have_delta_request",
+                                          std::bind(&FileListModel::haveDeltaRequest,
+                                                    this,
+                                                    std::placeholders::_1,
+                                                    std::placeholders::_2,
+                                                    std::placeholders::_3,
+                                                    std::placeholders::_4));
     EventBusManager::instance().subscribe("/file/upload_progress",
                                           std::bind(&FileListModel::onUploadFileProgress,
                                                     this,
@@ -44,6 +62,10 @@ FileListModel::FileListModel(QObject *parent) : QAbstractListModel(parent)
                                                     std::placeholders::_2,
                                                     std::placeholders::_3,
                                                     std::placeholders::_4));
+    EventBusManager::instance().subscribe("/file/download_failed",
+                                          std::bind(&FileListModel::onDownLoadFailed,
+                                                    this,
+                                                    std::placeholders::_1));
 }
 
 FileListModel::~FileListModel()
@@ -343,6 +365,21 @@ void FileListModel::downloadFile(int i)
     emit dataChanged(model_index, model_index, roles);
 }
 
+void FileListModel::setUploadRateLimit(qint64 bytes_per_second)
+{
+    EventBusManager::instance().publish("/file/set_global_rate_limit", static_cast<uint64_t>((std::max)(bytes_per_second, qint64(0))));
+}
+
+void FileListModel::setFileUploadRateLimit(int i, qint64 bytes_per_second)
+{
+    if (i < 0 || i >= file_list.size())
+    {
+        return;
+    }
+    EventBusManager::instance().publish("/file/set_transfer_rate_limit", uint32_t(file_list[i].id),
+                                        static_cast<uint64_t>((std::max)(bytes_per_second, qint64(0))));
+}
+
 void FileListModel::haveDownLoadRequest(std::vector<std::string> file_ids)
 {
     for (auto id : file_ids)
@@ -370,6 +407,80 @@ void FileListModel::haveDownLoadRequest(std::vector<std::string> file_ids)
     }
 }
 
+void FileListModel::haveDedupRequest(std::vector<std::string> file_ids)
+{
+    for (auto id : file_ids)
+    {
+        uint32_t target_id = std::stoul(id);
+        auto target_file = findFileInfoById(target_id);
+        // 文件失效
+        if (!FileSystemUtils::fileIsExist(target_file.second.source_path.toStdString()))
+        {
+            target_file.second.file_status = FileStatus::StatusError;
+            EventBusManager::instance().publish("/sync/send_expired_file", target_id);
+        }
+        else
+        {
+            target_file.second.file_status = FileStatus::StatusPending;
+            EventBusManager::instance().publish("/file/have_file_chunks_to_send", target_id, target_file.second.source_path.toStdString());
+        }
+
+        QModelIndex model_index = index(target_file.first, 0);
+        QVector<int> roles = {FileStatusRole};
+
+        emit dataChanged(model_index, model_index, roles);
+    }
+}
+
+void FileListModel::haveResumeRequest(std::string file_id, std::string total_size, std::string ranges)
+{
+    uint32_t target_id = std::stoul(file_id);
+    auto target_file = findFileInfoById(target_id);
+    // 文件失效
+    if (!FileSystemUtils::fileIsExist(target_file.second.source_path.toStdString()))
+    {
+        target_file.second.file_status = FileStatus::StatusError;
+        EventBusManager::instance().publish("/sync/send_expired_file", target_id);
+    }
+    else
+    {
+        target_file.second.file_status = FileStatus::StatusPending;
+        EventBusManager::instance().publish("/file/have_file_ranges_to_send", target_id,
+                                            target_file.second.source_path.toStdString(),
+                                            static_cast<uint64_t>(std::stoull(total_size)), ranges);
+    }
+
+    QModelIndex model_index = index(target_file.first, 0);
+    QVector<int> roles = {FileStatusRole};
+
+    emit dataChanged(model_index, model_index, roles);
+}
+
+void FileListModel::haveDeltaRequest(std::string file_id, std::string basis_size, std::string block_size, std::string blocks)
+{
+    uint32_t target_id = std::stoul(file_id);
+    auto target_file = findFileInfoById(target_id);
+    // 文件失效
+    if (!FileSystemUtils::fileIsExist(target_file.second.source_path.toStdString()))
+    {
+        target_file.second.file_status = FileStatus::StatusError;
+        EventBusManager::instance().publish("/sync/send_expired_file", target_id);
+    }
+    else
+    {
+        target_file.second.file_status = FileStatus::StatusPending;
+        EventBusManager::instance().publish("/file/have_file_delta_to_send", target_id,
+                                            target_file.second.source_path.toStdString(),
+                                            static_cast<uint64_t>(std::stoull(basis_size)),
+                                            static_cast<uint32_t>(std::stoul(block_size)), blocks);
+    }
+
+    QModelIndex model_index = index(target_file.first, 0);
+    QVector<int> roles = {FileStatusRole};
+
+    emit dataChanged(model_index, model_index, roles);
+}
+
 void FileListModel::onUploadFileProgress(uint32_t id, uint8_t progress, uint32_t speed, bool is_end)
 {
     auto target_file = findFileInfoById(id);
@@ -458,6 +569,19 @@ void FileListModel::onDownLoadProgress(uint32_t id, uint8_t progress, uint32_t s
     emit dataChanged(model_index, model_index, roles);
 }
 
+void FileListModel::onDownLoadFailed(uint32_t id)
+{
+    auto target_file = findFileInfoById(id);
+    target_file.second.file_status = FileStatus::StatusError;
+    target_file.second.speed = 0;
+    speed_history.remove(id);
+
+    QModelIndex model_index = index(target_file.first, 0);
+    QVector<int> roles = {FileStatusRole, FileSpeedRole};
+
+    emit dataChanged(model_index, model_index, roles);
+}
+
 void FileListModel::cleanTmpFiles()
 {
     QDir dir(QString::fromStdString(GlobalStatusManager::absolute_tmp_dir));